@@ -10,6 +10,15 @@ PetscReal a_lin(PetscReal u, PetscReal x, PetscReal y) {
     return 1.0;
 }
 
+// derivatives with respect to u, for the Newton Jacobian:
+PetscReal dadu_lin(PetscReal u, PetscReal x, PetscReal y) {
+    return 0.0;
+}
+
+PetscReal dfdu_lin(PetscReal u, PetscReal x, PetscReal y) {
+    return 0.0;
+}
+
 // manufactured from a_lin(), uexact_lin():
 PetscReal f_lin(PetscReal u, PetscReal x, PetscReal y) {
     return 2.0 * x + 3.0 * y * y;
@@ -39,6 +48,10 @@ PetscReal a_nonlin(PetscReal u, PetscReal x, PetscReal y) {
     return 1.0 + u * u;
 }
 
+PetscReal dadu_nonlin(PetscReal u, PetscReal x, PetscReal y) {
+    return 2.0 * u;
+}
+
 // manufactured from a_nonlin(), uexact_lin()
 PetscReal f_nonlin(PetscReal udrop, PetscReal x, PetscReal y) {
     const PetscReal y2 = y * y,
@@ -49,6 +62,7 @@ PetscReal f_nonlin(PetscReal udrop, PetscReal x, PetscReal y) {
            + (1.0 + u * u) * (2.0 * x + 3.0 * y2);
 }
 
+// dfdu_nonlin = dfdu_lin  (f_nonlin() does not depend on u)
 // uexact_nonlin = uexact_lin
 // gD_nonlin = gD_lin
 // gN_nonlin = gN_lin
@@ -95,6 +109,8 @@ PetscReal gD_square(PetscReal x, PetscReal y) {
 }
 
 // gN_fcn() = NULL in square case; want seg fault if called
+// dadu_square = dadu_lin
+// dfdu_square = dfdu_lin
 
 
 // -----------------------------------------------------------------------------
@@ -114,5 +130,34 @@ PetscReal gD_koch(PetscReal x, PetscReal y) {
     return 0.0;
 }
 
+// dadu_koch = dadu_lin
+// dfdu_koch = dfdu_lin
+
+
+// -----------------------------------------------------------------------------
+// BATCHED VERSIONS OF a() AND f(), FOR FormFunctionBatch()
+// v[i] = fcn(u[i],x[i],y[i]) for i=0,...,n-1; one call through a function
+// pointer per batch, and the scalar function is inlined into the loop
+
+#define BATCH(fcn) \
+void fcn ## _batch(PetscInt n, const PetscReal *u, const PetscReal *x, \
+                   const PetscReal *y, PetscReal *v) { \
+    PetscInt i; \
+    PetscPragmaSIMD \
+    for (i = 0; i < n; i++) \
+        v[i] = fcn(u[i],x[i],y[i]); \
+}
+
+BATCH(a_lin)
+BATCH(f_lin)
+BATCH(a_nonlin)
+BATCH(f_nonlin)
+BATCH(a_square)
+BATCH(f_square)
+BATCH(a_koch)
+BATCH(f_koch)
+
+#undef BATCH
+
 #endif
 
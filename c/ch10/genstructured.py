@@ -67,9 +67,8 @@ for j in range(args.M):
 if args.debug:
   print(bf)
 
-# create bogus negative Neumann boundary segment
-# FIXME this kluge caused by inability to check if binary file is empty; see FIXME in UMReadISs()
-ns = np.array([-1,-1],dtype=int)
+# no Neumann boundary segments; UMReadISs() accepts an empty IS
+ns = np.array([],dtype=int)
 
 # write ISs
 print('  writing element triple and boundary flags as PETSc IS to %s ...' % isname)
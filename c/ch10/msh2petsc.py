@@ -14,6 +14,9 @@
 #    $ make petscPyScripts
 #    $ gmsh -2 meshes/trap.geo
 #    $ ./msh2petsc.py meshes/trap.msh
+# alternatively, put everything in one packed file meshes/trap.umsh, which
+# unfem reads with option -un_packed (see UMReadPacked() in um.c):
+#    $ ./msh2petsc.py --packed meshes/trap.msh
 
 import numpy as np
 import sys
@@ -49,6 +52,23 @@ def get_mesh_format(filename):
                     break
         return gmshversion
 
+# packed single-file format read by UMReadPacked() in um.c: eight int64 header
+# values (magic,version,sizeof(int),sizeof(real),N,K,P,0) then arrays
+# xy[2N], e[3K], bf[N], ns[2P], all in native byte order
+UMSH_MAGIC = 0x48534d55
+def write_packed(filename,xy,e,bf,ns,int64):
+    itype = np.int64 if int64 else np.int32
+    N = len(bf)
+    K = len(e) // 3
+    P = len(ns) // 2
+    head = np.array([UMSH_MAGIC,1,np.dtype(itype).itemsize,8,N,K,P,0],
+                    dtype=np.int64)
+    with open(filename, 'wb') as f:
+        head.tofile(f)
+        np.asarray(xy,dtype=np.float64).tofile(f)
+        for v in [e,bf,ns]:
+            np.asarray(v,dtype=itype).tofile(f)
+
 # this is the same format for 2.2 and 4.1
 def read_physical_names(filename):
     PNread = False
@@ -88,11 +108,16 @@ Needs link to ${PETSC_DIR}/lib/petsc/bin/PetscBinaryIO.py.''')
     # required positional filename
     parser.add_argument('-v', default=False, action='store_true',
                         help='verbose output for debugging')
+    parser.add_argument('--packed', default=False, action='store_true',
+                        help='write single packed file with .umsh extension instead of .vec,.is')
+    parser.add_argument('--int64', default=False, action='store_true',
+                        help='use 64-bit integers in packed file (for PETSc --with-64-bit-indices)')
     parser.add_argument('inname', metavar='FILE',
                         help='input file name with .msh extension')
     args = parser.parse_args()
 
-    import PetscBinaryIO
+    if not args.packed:
+        import PetscBinaryIO
 
     if args.inname.split('.')[-1] == 'msh':
         outroot = '.'.join(args.inname.split('.')[:-1]) # strip .msh
@@ -100,6 +125,7 @@ Needs link to ${PETSC_DIR}/lib/petsc/bin/PetscBinaryIO.py.''')
         print('WARNING: expected .msh extension for input file')
     vecoutname = outroot + '.vec'
     isoutname = outroot + '.is'
+    packedoutname = outroot + '.umsh'
     gmshversion = get_mesh_format(args.inname)
     print('  input file %s in Gmsh format v%s' % (args.inname,gmshversion))
 
@@ -120,10 +146,11 @@ Needs link to ${PETSC_DIR}/lib/petsc/bin/PetscBinaryIO.py.''')
     dprint(args.v,'N=%d' % N)
     dprint(args.v,xy)
 
-    print('  writing N=%d node coordinates as PETSc Vec to %s ...' \
-          % (N,vecoutname))
-    petsc = PetscBinaryIO.PetscBinaryIO()
-    petsc.writeBinaryFile(vecoutname,[xy.view(PetscBinaryIO.Vec),])
+    if not args.packed:
+        print('  writing N=%d node coordinates as PETSc Vec to %s ...' \
+              % (N,vecoutname))
+        petsc = PetscBinaryIO.PetscBinaryIO()
+        petsc.writeBinaryFile(vecoutname,[xy.view(PetscBinaryIO.Vec),])
 
     print('  reading element tuples ...')
     if gmshversion == '2.2':
@@ -137,9 +164,14 @@ Needs link to ${PETSC_DIR}/lib/petsc/bin/PetscBinaryIO.py.''')
     dprint(args.v,bf)
     assert (len(ns) % 2 == 0), 'Neumann segment index list length not 2 P'
     P = len(ns) / 2
+    if args.packed:
+        print('  writing N=%d nodes, K=%d elements, and P=%d Neumann segments' \
+              % (N,K,P))
+        print('    as packed mesh to %s ...' % packedoutname)
+        write_packed(packedoutname,xy,e,bf,ns,args.int64)
+        sys.exit(0)
     if (P == 0):
-        print('WARNING: P=0 so writing a bogus negative-valued Neumann boundary segment')
-        ns = np.array([-1,-1],dtype=int)
+        ns = np.array([],dtype=int)   # empty IS; UMReadISs() sets ns = NULL
     dprint(args.v,ns)
     print('  writing K=%d elements, N=%d boundary flags, and P=%d Neumann segments' \
           % (K,N,P))
@@ -8,16 +8,24 @@
 # example:
 #   ./refinetraps.sh meshes/trap 5
 
+# if the meshes will only be read by "unfem -un_gmsh", which parses .msh files
+# directly, then skip the conversion by msh2petsc.py:
+#   ./refinetraps.sh meshes/trap 5 nopy
+
 NAME=$1
 MAXLEV=$2
+CONVERT=./msh2petsc.py
+if [[ "$3" == "nopy" ]]; then
+    CONVERT=true
+fi
 
 GMSH=gmsh
 #GMSH="gmsh -format msh22"   # legacy 2.2 format also allowed with msh2petsc.py
 
 ${GMSH} -2 ${NAME}.geo -o ${NAME}1.msh
-./msh2petsc.py ${NAME}1.msh
+${CONVERT} ${NAME}1.msh
 for (( Z=1; Z<$MAXLEV; Z++ )); do
     ${GMSH} -refine ${NAME}$Z.msh -o ${NAME}$((Z+1)).msh
-    ./msh2petsc.py $NAME$((Z+1)).msh
+    ${CONVERT} $NAME$((Z+1)).msh
 done
 
@@ -0,0 +1,22 @@
+#!/bin/bash
+set -e
+
+# microbenchmark of the scalar and batched (-un_batch) residual evaluations
+# in unfem, in elements per second, for each quadrature degree, for the
+# linear and nonlinear cases
+# generate meshes/trap1.{is,vec} first; refinement is in memory (-un_refine)
+# run as:
+#   ./unfem-batch.sh &> unfem-batch.txt
+# use PETSC_ARCH with --with-debugging=0, and compare builds with and without
+# vectorization, e.g. COPTFLAGS="-O3 -march=native" when configuring PETSc
+
+REFINE=6
+N=50
+
+for CASE in 0 1; do
+    for QD in 1 2 3 4 5; do
+        CMD="../unfem -un_case $CASE -un_mesh ../meshes/trap1 -un_refine $REFINE -un_quaddegree $QD -un_bench_residual $N -snes_max_it 1"
+        echo "COMMAND:  $CMD"
+        $CMD | grep "residual\|F_scalar"
+    done
+done
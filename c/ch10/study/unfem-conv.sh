@@ -2,7 +2,9 @@
 set -e
 
 # convergence and iterations for case 0,1,2 for unfem
-# generate meshes/trapN.{is,vec} for N=1,...,10 first
+# generate meshes/trapN.{is,vec} for N=1,...,10 first; alternatively replace
+# "-un_mesh ../meshes/trap$2" below by "-un_mesh ../meshes/trap1 -un_refine $(($2-1))"
+# which refines in memory, as "gmsh -refine" does for these polygonal domains
 # run as:
 #   ./unfem-conv.sh &> unfem-conv.txt
 # use PETSC_ARCH with --with-debugging=0 (for speed; time not measured)
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+
+# compare geometric multigrid (-un_mg on the -un_refine hierarchy) with GAMG
+# for case 0 of unfem; setup costs are in the PCSetUp line of -log_view
+# run as:
+#   cd c/ch10/
+#   make unfem                        # use PETSC_ARCH with --with-debugging=0
+#   make meshes/trap1.vec meshes/trap1.is
+#   cd study/
+#   ./unfem-mg.sh &> unfem-mg.txt
+
+function run() {
+    CMD="../unfem -un_case 0 -un_mesh ../meshes/trap1 -un_refine $1 $2 -snes_type ksponly -ksp_rtol 1.0e-10 -ksp_converged_reason -log_view"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD &> tmp.txt
+    grep "Linear solve" tmp.txt
+    grep "case 0 result" tmp.txt
+    grep "PCSetUp " tmp.txt
+    grep "KSPSolve " tmp.txt
+}
+
+for REF in 2 4 6 8 10; do
+    run $REF "-un_mg"
+    run $REF "-pc_type gamg"
+done
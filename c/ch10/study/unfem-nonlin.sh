@@ -2,10 +2,11 @@
 set -e
 
 # solver iterations and flops for case 1 of unfem using CG+AMG and one of
-# three nonlinear strategies:
+# four nonlinear strategies:
 #   Picard (analytical matrix) iteration
 #   -snes_fd_color
 #   -snes_mf_operator with Picard as preconditioner material
+#   Newton with analytical Jacobian (-un_jacobian newton)
 # (note: individual runs will show the very different residual norm histories)
 
 # run as:
@@ -47,4 +48,8 @@ for LEV in 3 4 5 6 7 8 9; do   # LEV=10 generates DIVERGED_ITS error on 4th SNES
 done
 echo
 
-
+echo "********** Newton with analytical Jacobian ***********"
+for LEV in 3 4 5 6 7 8 9 10 11; do
+    run $LEV "-un_jacobian newton -ksp_type gmres"
+done
+echo
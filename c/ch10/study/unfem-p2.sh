@@ -0,0 +1,28 @@
+#!/bin/bash
+set -e
+
+# error versus number of unknowns for P1 and P2 elements in unfem, case 0
+# (linear) and case 1 (nonlinear); at level L the P2 run has the same nodes,
+# thus the same number of unknowns, as the P1 run at level L+1
+# generate meshes/trap1.{is,vec} first; refinement is in memory (-un_refine)
+# run as:
+#   ./unfem-p2.sh &> unfem-p2.txt
+# use PETSC_ARCH with --with-debugging=0
+
+function runcase() {
+    CMD="../unfem -un_case $1 -un_mesh ../meshes/trap1 -un_refine $2 $3 -snes_rtol 1.0e-10 -ksp_rtol 1.0e-12"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD -log_view &> tmp.txt
+    grep "result" tmp.txt
+    grep "Memory:" tmp.txt | head -n 1
+}
+
+for CASE in 0 1; do
+    for LEV in 1 2 3 4 5 6 7; do
+        runcase $CASE $LEV "-un_order 1"
+    done
+    for LEV in 0 1 2 3 4 5 6; do
+        runcase $CASE $LEV "-un_order 2"
+    done
+done
@@ -0,0 +1,29 @@
+#!/bin/bash
+set -e
+
+# effect of node reordering (-un_reorder none|rcm|hilbert) on residual and
+# Jacobian evaluation time, and on ICC iterations, for case 1 of unfem; run as:
+#   cd c/ch10/
+#   make unfem                        # use PETSC_ARCH with --with-debugging=0
+#   ./refinetraps.sh meshes/trap 12   # generate meshes/trapN.{is,vec} for N=1,...,12
+#   cd study/
+#   ./unfem-reorder.sh &> unfem-reorder.txt
+# for cache misses run the same commands under "perf stat -e cache-misses"
+
+function run() {
+    CMD="../unfem -un_case 1 -un_mesh ../meshes/trap$1 -un_reorder $2 -pc_type icc -snes_rtol 1.0e-8 -ksp_rtol 1.0e-8 -snes_converged_reason -ksp_converged_reason -log_view"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD &> tmp.txt
+    grep "Linear solve" tmp.txt
+    grep "case 1 result" tmp.txt
+    grep "Residual eval  :" tmp.txt
+    grep "Jacobian eval  :" tmp.txt
+    grep "MatICCFactorSym" tmp.txt
+}
+
+for LEV in 11 12; do
+    for ORD in none rcm hilbert; do
+        run $LEV $ORD
+    done
+done
@@ -2,7 +2,8 @@
 set -e
 
 # solver time, flops, and run-time stage fractions for case 0 of unfem,
-# either CG+ICC or CG+GAMG;  run as:
+# either CG+ICC, CG+ICC with upper-triangle (MATSBAIJ) storage, or CG+GAMG;
+# run as:
 #   cd c/ch10/
 #   make unfem                        # use PETSC_ARCH with --with-debugging=0
 #   ./refinetraps.sh meshes/trap 12   # generate meshes/trapN.{is,vec} for N=1,...,12
@@ -24,6 +25,8 @@ function run() {
     grep "Read mesh      :" tmp.txt
     grep "Set-up         :" tmp.txt
     grep "Solver         :" tmp.txt
+    # matrix memory in bytes (creations, destructions, memory)
+    grep "^ *Matrix " tmp.txt
 }
 
 # case 0 (linear, homo neumann) with CG+ICC
@@ -31,6 +34,11 @@ for LEV in 1 2 3 4 5 6 7 8 9 10 11; do
     run $LEV "-pc_type icc"
 done
 
+# case 0 (linear, homo neumann) with CG+ICC, storing only the upper triangle
+for LEV in 1 2 3 4 5 6 7 8 9 10 11; do
+    run $LEV "-pc_type icc -un_sbaij"
+done
+
 # case 0 (linear, homo neumann) with CG+GAMG
 for LEV in 1 2 3 4 5 6 7 8 9 10 11 12; do
     run $LEV "-pc_type gamg"
@@ -0,0 +1,37 @@
+#!/bin/bash
+set -e
+
+# weak scaling of case 0 of unfem with CG+GAMG:  each refinement of the
+# trapezoid mesh multiplies the number of nodes by about four, so the process
+# count grows by four per level; run as:
+#   cd c/ch10/
+#   make unfem                        # use PETSC_ARCH with --with-debugging=0
+#   ./refinetraps.sh meshes/trap 12   # generate meshes/trapN.{is,vec} for N=1,...,12
+#   cd study/
+#   ./unfem-weak.sh &> unfem-weak.txt
+# elements are partitioned by MatPartitioning; add
+#   -mat_partitioning_type parmetis
+# if PETSc was configured with ParMETIS; the mesh set-up is replicated (see
+# UMDistribute() in um.h), so the per-process memory reported by -memory_view
+# grows with the global mesh, even though the work per process is constant
+
+function run() {
+    CMD="mpiexec -n $1 ../unfem -un_case 0 -un_mesh ../meshes/trap$2 $3 -snes_type ksponly -ksp_rtol 1.0e-10 -ksp_converged_reason -log_view -memory_view"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD &> tmp.txt
+    grep "Linear solve" tmp.txt
+    grep "result" tmp.txt
+    grep "Flop:           " tmp.txt
+    grep "Time (sec):     " tmp.txt
+    grep "Read mesh      :" tmp.txt
+    grep "Set-up         :" tmp.txt
+    grep "Solver         :" tmp.txt
+    grep "process memory" tmp.txt
+}
+
+LEV=9
+for NP in 1 4 16 64; do
+    run $NP $LEV "-pc_type gamg"
+    LEV=$((LEV+1))
+done
@@ -1,3 +1,8 @@
+#define _POSIX_C_SOURCE 200809L  // for mmap() and friends under -std=c99
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <petsc.h>
 #include "um.h"
 
@@ -5,10 +10,31 @@ PetscErrorCode UMInitialize(UM *mesh) {
     mesh->N = 0;
     mesh->K = 0;
     mesh->P = 0;
+    mesh->nen = 3;
+    mesh->nsn = 2;
     mesh->loc = NULL;
     mesh->e = NULL;
     mesh->bf = NULL;
     mesh->ns = NULL;
+    mesh->Nown = 0;
+    mesh->Kown = 0;
+    mesh->Nglobal = 0;
+    mesh->Kglobal = 0;
+    mesh->ltog = NULL;
+    mesh->gtol = NULL;
+    mesh->natural = NULL;
+    mesh->nq = 0;
+    mesh->absdetJ = NULL;
+    mesh->gpx = NULL;
+    mesh->gpy = NULL;
+    mesh->xq = NULL;
+    mesh->yq = NULL;
+    mesh->ncolors = 0;
+    mesh->colorptr = NULL;
+    mesh->colorel = NULL;
+    mesh->parent = NULL;
+    mesh->map = NULL;
+    mesh->maplen = 0;
     return 0;
 }
 
@@ -18,6 +44,20 @@ PetscErrorCode UMDestroy(UM *mesh) {
     ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
     ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
     ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingDestroy(&(mesh->ltog)); CHKERRQ(ierr);
+    ierr = VecScatterDestroy(&(mesh->gtol)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->natural)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->parent)); CHKERRQ(ierr);
+    ierr = PetscFree5(mesh->absdetJ,mesh->gpx,mesh->gpy,mesh->xq,mesh->yq); CHKERRQ(ierr);
+    mesh->nq = 0;
+    ierr = PetscFree(mesh->colorptr); CHKERRQ(ierr);
+    ierr = PetscFree(mesh->colorel); CHKERRQ(ierr);
+    mesh->ncolors = 0;
+    if (mesh->map) {  // after loc, e, bf, ns which may point into it
+        munmap(mesh->map,mesh->maplen);
+        mesh->map = NULL;
+        mesh->maplen = 0;
+    }
     return 0;
 }
 
@@ -43,8 +83,14 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d elements:\n",mesh->K); CHKERRQ(ierr);
         ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
         for (k = 0; k < mesh->K; k++) {
-            ierr = PetscPrintf(PETSC_COMM_WORLD,"    %3d : %3d %3d %3d\n",
+            if (mesh->nen == 6) {
+                ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d %3d %3d %3d %3d\n",
+                               k,ae[6*k+0],ae[6*k+1],ae[6*k+2],
+                               ae[6*k+3],ae[6*k+4],ae[6*k+5]); CHKERRQ(ierr);
+            } else {
+                ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d %3d\n",
                                k,ae[3*k+0],ae[3*k+1],ae[3*k+2]); CHKERRQ(ierr);
+            }
         }
         ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
     } else {
@@ -65,13 +111,19 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"%d Neumann boundary segments:\n",mesh->P); CHKERRQ(ierr);
         ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
         for (n = 0; n < mesh->P; n++) {
-            ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d\n",
+            if (mesh->nsn == 3) {
+                ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d %3d\n",
+                               n,ans[3*n+0],ans[3*n+1],ans[3*n+2]); CHKERRQ(ierr);
+            } else {
+                ierr = PetscViewerASCIISynchronizedPrintf(viewer,"    %3d : %3d %3d\n",
                                n,ans[2*n+0],ans[2*n+1]); CHKERRQ(ierr);
+            }
         }
         ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
     } else {
         ierr = PetscViewerASCIISynchronizedPrintf(viewer,"Neumann boundary segments empty or unallocated\n"); CHKERRQ(ierr);
     }
+    ierr = PetscViewerFlush(viewer); CHKERRQ(ierr);
     ierr = PetscViewerASCIIPopSynchronized(viewer); CHKERRQ(ierr);
     return 0;
 }
@@ -79,19 +131,210 @@ PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer) {
 
 PetscErrorCode UMViewSolutionBinary(UM *mesh, char *filename, Vec u) {
     PetscErrorCode ierr;
-    PetscInt       Nu;
+    PetscInt       Nu, rstart;
     PetscViewer viewer;
+    Vec         unat;
+    IS          isown;
+    VecScatter  ctx;
     ierr = VecGetSize(u,&Nu); CHKERRQ(ierr);
-    if (Nu != mesh->N) {
+    if (Nu != mesh->Nglobal) {
         SETERRQ2(PETSC_COMM_SELF,1,
-           "incompatible sizes of u (=%d) and number of nodes (=%d)\n",Nu,mesh->N);
+           "incompatible sizes of u (=%d) and number of nodes (=%d)\n",Nu,mesh->Nglobal);
     }
     ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&viewer); CHKERRQ(ierr);
-    ierr = VecView(u,viewer); CHKERRQ(ierr);
+    if (mesh->natural) {
+        // write in the node ordering of the mesh files
+        ierr = VecDuplicate(u,&unat); CHKERRQ(ierr);
+        ierr = VecGetOwnershipRange(u,&rstart,NULL); CHKERRQ(ierr);
+        ierr = ISCreateStride(PETSC_COMM_SELF,mesh->Nown,rstart,1,&isown); CHKERRQ(ierr);
+        ierr = VecScatterCreate(u,isown,unat,mesh->natural,&ctx); CHKERRQ(ierr);
+        ierr = VecScatterBegin(ctx,u,unat,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+        ierr = VecScatterEnd(ctx,u,unat,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+        ierr = VecView(unat,viewer); CHKERRQ(ierr);
+        VecScatterDestroy(&ctx);  ISDestroy(&isown);  VecDestroy(&unat);
+    } else {
+        ierr = VecView(u,viewer); CHKERRQ(ierr);
+    }
     ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
     return 0;
 }
 
+// points, offsets, and cell types are converted in chunks of this many
+#define VTUCHUNK 1024
+
+static PetscErrorCode VTUWrite(FILE *fp, const void *data, size_t size,
+                               size_t count) {
+    if (count > 0 && fwrite(data,size,count,fp) != count) {
+        SETERRQ(PETSC_COMM_SELF,2,"write to VTU file failed\n");
+    }
+    return 0;
+}
+
+// each block of VTU appended data starts with its byte count as a UInt64
+static PetscErrorCode VTUWriteCount(FILE *fp, size_t nbytes) {
+    PetscErrorCode ierr;
+    PetscInt64  n = (PetscInt64)nbytes;
+    ierr = VTUWrite(fp,&n,sizeof(n),1); CHKERRQ(ierr);
+    return 0;
+}
+
+/* VTU is the XML unstructured-grid format of VTK, read by ParaView and VisIt.
+The data arrays follow the XML header as raw binary in "appended" form, so the
+file is written in one pass through the stdio buffer, without base64 encoding
+and without copying the mesh arrays; only the point coordinates (2D to 3D),
+the offsets, and the cell types are converted, in chunks.  P2 meshes are
+written as VTK quadratic triangles, whose node order matches UM.  In parallel
+each process writes its owned elements, and all of its local nodes, to piece
+file root_r.vtu, and rank 0 writes root.pvtu which lists the pieces.      */
+PetscErrorCode UMViewSolutionVTU(UM *mesh, const char *root, Vec u) {
+    PetscErrorCode ierr;
+    PetscMPIInt     rank, size, r;
+    const int       one = 1;
+    const char      *byteorder = (*(const char*)&one == 1) ? "LittleEndian" : "BigEndian",
+                    *realtype = (sizeof(PetscReal) == 8) ? "Float64" : "Float32",
+                    *inttype = (sizeof(PetscInt) == 8) ? "Int64" : "Int32";
+    const char      *names[5] = {"u","bf","","connectivity","offsets"};
+    char            name[PETSC_MAX_PATH_LEN];
+    FILE            *fp;
+    Vec             uloc;
+    const PetscReal *au;
+    const PetscInt  *ae, *abf;
+    const Node      *aloc;
+    PetscInt        N = mesh->N, K = mesh->Kown, nen = mesh->nen, Nu, i, j, n,
+                    ioff[VTUCHUNK];
+    PetscReal       xyz[3*VTUCHUNK];
+    unsigned char   types[VTUCHUNK];
+    size_t          nbytes[6], off[6];
+
+    ierr = VecGetSize(u,&Nu); CHKERRQ(ierr);
+    if (Nu != mesh->Nglobal) {
+        SETERRQ2(PETSC_COMM_SELF,1,
+           "incompatible sizes of u (=%d) and number of nodes (=%d)\n",Nu,mesh->Nglobal);
+    }
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    ierr = UMCreateLocalVec(mesh,&uloc); CHKERRQ(ierr);
+    ierr = UMGlobalToLocal(mesh,u,uloc); CHKERRQ(ierr);
+
+    // appended blocks, in order:  u, bf, points, connectivity, offsets, types
+    nbytes[0] = N * sizeof(PetscReal);
+    nbytes[1] = N * sizeof(PetscInt);
+    nbytes[2] = 3 * N * sizeof(PetscReal);
+    nbytes[3] = nen * K * sizeof(PetscInt);
+    nbytes[4] = K * sizeof(PetscInt);
+    nbytes[5] = K;
+    off[0] = 0;
+    for (j = 1; j < 6; j++)
+        off[j] = off[j-1] + sizeof(PetscInt64) + nbytes[j-1];
+
+    if (size == 1) {
+        ierr = PetscSNPrintf(name,sizeof(name),"%s.vtu",root); CHKERRQ(ierr);
+    } else {
+        ierr = PetscSNPrintf(name,sizeof(name),"%s_%d.vtu",root,rank); CHKERRQ(ierr);
+    }
+    ierr = PetscFOpen(PETSC_COMM_SELF,name,"wb",&fp); CHKERRQ(ierr);
+    fprintf(fp,"<?xml version=\"1.0\"?>\n"
+               "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+               "  <UnstructuredGrid>\n"
+               "    <Piece NumberOfPoints=\"%d\" NumberOfCells=\"%d\">\n"
+               "      <PointData Scalars=\"u\">\n",byteorder,N,K);
+    for (j = 0; j < 2; j++)
+        fprintf(fp,"        <DataArray type=\"%s\" Name=\"%s\" format=\"appended\" offset=\"%zu\"/>\n",
+                   (j == 0) ? realtype : inttype,names[j],off[j]);
+    fprintf(fp,"      </PointData>\n"
+               "      <Points>\n"
+               "        <DataArray type=\"%s\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%zu\"/>\n"
+               "      </Points>\n"
+               "      <Cells>\n",realtype,off[2]);
+    for (j = 3; j < 5; j++)
+        fprintf(fp,"        <DataArray type=\"%s\" Name=\"%s\" format=\"appended\" offset=\"%zu\"/>\n",
+                   inttype,names[j],off[j]);
+    fprintf(fp,"        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"%zu\"/>\n"
+               "      </Cells>\n"
+               "    </Piece>\n"
+               "  </UnstructuredGrid>\n"
+               "  <AppendedData encoding=\"raw\">\n_",off[5]);
+
+    // u and bf straight from their arrays
+    ierr = VecGetArrayRead(uloc,&au); CHKERRQ(ierr);
+    ierr = VTUWriteCount(fp,nbytes[0]); CHKERRQ(ierr);
+    ierr = VTUWrite(fp,au,sizeof(PetscReal),N); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(uloc,&au); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VTUWriteCount(fp,nbytes[1]); CHKERRQ(ierr);
+    ierr = VTUWrite(fp,abf,sizeof(PetscInt),N); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    // points are 3D in VTK
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VTUWriteCount(fp,nbytes[2]); CHKERRQ(ierr);
+    for (i = 0; i < N; i += VTUCHUNK) {
+        n = PetscMin(VTUCHUNK,N-i);
+        for (j = 0; j < n; j++) {
+            xyz[3*j+0] = aloc[i+j].x;
+            xyz[3*j+1] = aloc[i+j].y;
+            xyz[3*j+2] = 0.0;
+        }
+        ierr = VTUWrite(fp,xyz,sizeof(PetscReal),3*n); CHKERRQ(ierr);
+    }
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+
+    // owned elements come first, so the connectivity is a prefix of e;
+    //   offsets are the end of each element in it; type 5 is VTK_TRIANGLE,
+    //   22 is VTK_QUADRATIC_TRIANGLE
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VTUWriteCount(fp,nbytes[3]); CHKERRQ(ierr);
+    ierr = VTUWrite(fp,ae,sizeof(PetscInt),nen*K); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VTUWriteCount(fp,nbytes[4]); CHKERRQ(ierr);
+    for (i = 0; i < K; i += VTUCHUNK) {
+        n = PetscMin(VTUCHUNK,K-i);
+        for (j = 0; j < n; j++)
+            ioff[j] = nen * (i + j + 1);
+        ierr = VTUWrite(fp,ioff,sizeof(PetscInt),n); CHKERRQ(ierr);
+    }
+    for (j = 0; j < VTUCHUNK; j++)
+        types[j] = (nen == 6) ? 22 : 5;
+    ierr = VTUWriteCount(fp,nbytes[5]); CHKERRQ(ierr);
+    for (i = 0; i < K; i += VTUCHUNK) {
+        ierr = VTUWrite(fp,types,1,PetscMin(VTUCHUNK,K-i)); CHKERRQ(ierr);
+    }
+    fprintf(fp,"\n  </AppendedData>\n"
+               "</VTKFile>\n");
+    ierr = PetscFClose(PETSC_COMM_SELF,fp); CHKERRQ(ierr);
+    VecDestroy(&uloc);
+
+    // parallel index file, written by rank 0
+    if (size > 1) {
+        ierr = PetscSNPrintf(name,sizeof(name),"%s.pvtu",root); CHKERRQ(ierr);
+        ierr = PetscFOpen(PETSC_COMM_WORLD,name,"w",&fp); CHKERRQ(ierr);
+        ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,
+               "<?xml version=\"1.0\"?>\n"
+               "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+               "  <PUnstructuredGrid GhostLevel=\"0\">\n"
+               "    <PPointData Scalars=\"u\">\n"
+               "      <PDataArray type=\"%s\" Name=\"u\"/>\n"
+               "      <PDataArray type=\"%s\" Name=\"bf\"/>\n"
+               "    </PPointData>\n"
+               "    <PPoints>\n"
+               "      <PDataArray type=\"%s\" NumberOfComponents=\"3\"/>\n"
+               "    </PPoints>\n",
+               byteorder,realtype,inttype,realtype); CHKERRQ(ierr);
+        for (r = 0; r < size; r++) {
+            // pieces are named relative to the directory of the .pvtu file
+            const char *base = strrchr(root,'/');
+            ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,
+                   "    <Piece Source=\"%s_%d.vtu\"/>\n",
+                   base ? base + 1 : root,r); CHKERRQ(ierr);
+        }
+        ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,
+               "  </PUnstructuredGrid>\n"
+               "</VTKFile>\n"); CHKERRQ(ierr);
+        ierr = PetscFClose(PETSC_COMM_WORLD,fp); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
 
 PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
     PetscErrorCode ierr;
@@ -100,9 +343,10 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
     if (mesh->N > 0) {
         SETERRQ(PETSC_COMM_SELF,1,"nodes already created?\n");
     }
-    ierr = VecCreate(PETSC_COMM_WORLD,&mesh->loc); CHKERRQ(ierr);
+    // every process reads the whole mesh; see UMDistribute()
+    ierr = VecCreate(PETSC_COMM_SELF,&mesh->loc); CHKERRQ(ierr);
     ierr = VecSetFromOptions(mesh->loc); CHKERRQ(ierr);
-    ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
+    ierr = PetscViewerBinaryOpen(PETSC_COMM_SELF,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
     ierr = VecLoad(mesh->loc,viewer); CHKERRQ(ierr);
     ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
     ierr = VecGetSize(mesh->loc,&twoN); CHKERRQ(ierr);
@@ -110,6 +354,8 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename) {
         SETERRQ1(PETSC_COMM_SELF,2,"node locations loaded from %s are not N pairs\n",filename);
     }
     mesh->N = twoN / 2;
+    mesh->Nown = mesh->N;
+    mesh->Nglobal = mesh->N;
     return 0;
 }
 
@@ -128,11 +374,11 @@ PetscErrorCode UMCheckElements(UM *mesh) {
     }
     ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
     for (k = 0; k < mesh->K; k++) {
-        for (m = 0; m < 3; m++) {
-            if ((ae[3*k+m] < 0) || (ae[3*k+m] >= mesh->N)) {
+        for (m = 0; m < mesh->nen; m++) {
+            if ((ae[mesh->nen*k+m] < 0) || (ae[mesh->nen*k+m] >= mesh->N)) {
                 SETERRQ3(PETSC_COMM_SELF,3,
                    "index e[%d]=%d invalid: not between 0 and N-1=%d\n",
-                   3*k+m,ae[3*k+m],mesh->N-1);
+                   mesh->nen*k+m,ae[mesh->nen*k+m],mesh->N-1);
             }
         }
         // FIXME: could add check for distinct indices
@@ -174,11 +420,11 @@ PetscErrorCode UMCheckBoundaryData(UM *mesh) {
     if (mesh->P > 0) {
         ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
         for (n = 0; n < mesh->P; n++) {
-            for (m = 0; m < 2; m++) {
-                if ((ans[2*n+m] < 0) || (ans[2*n+m] >= mesh->N)) {
+            for (m = 0; m < mesh->nsn; m++) {
+                if ((ans[mesh->nsn*n+m] < 0) || (ans[mesh->nsn*n+m] >= mesh->N)) {
                     SETERRQ3(PETSC_COMM_SELF,6,
                        "index ns[%d]=%d invalid: not between 0 and N-1=%d\n",
-                       2*n+m,ans[3*n+m],mesh->N-1);
+                       mesh->nsn*n+m,ans[mesh->nsn*n+m],mesh->N-1);
                 }
             }
         }
@@ -199,9 +445,9 @@ PetscErrorCode UMReadISs(UM *mesh, char *filename) {
         SETERRQ(PETSC_COMM_SELF,1,
                 "elements, boundary flags, Neumann boundary segments already created? ... stopping\n");
     }
-    ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
+    ierr = PetscViewerBinaryOpen(PETSC_COMM_SELF,filename,FILE_MODE_READ,&viewer); CHKERRQ(ierr);
     // create and load e
-    ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreate(PETSC_COMM_SELF,&(mesh->e)); CHKERRQ(ierr);
     ierr = ISLoad(mesh->e,viewer); CHKERRQ(ierr);
     ierr = ISGetSize(mesh->e,&(mesh->K)); CHKERRQ(ierr);
     if (mesh->K % 3 != 0) {
@@ -209,26 +455,33 @@ PetscErrorCode UMReadISs(UM *mesh, char *filename) {
                  "IS e loaded from %s is wrong size for list of element triples\n",filename);
     }
     mesh->K /= 3;
+    mesh->Kown = mesh->K;
+    mesh->Kglobal = mesh->K;
     // create and load bf
-    ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISCreate(PETSC_COMM_SELF,&(mesh->bf)); CHKERRQ(ierr);
     ierr = ISLoad(mesh->bf,viewer); CHKERRQ(ierr);
     ierr = ISGetSize(mesh->bf,&n_bf); CHKERRQ(ierr);
     if (n_bf != mesh->N) {
         SETERRQ1(PETSC_COMM_SELF,4,
                  "IS bf loaded from %s is wrong size for list of boundary flags\n",filename);
     }
-    // FIXME  seems there is no way to tell if file is empty at this point
-    // create and load ns last ... may *start with a negative value* in which case set P = 0
+    // create and load ns last; it is empty, or, in files from older
+    //   msh2petsc.py, *starts with a negative value*, if P = 0; the packed
+    //   format (UMReadPacked()) stores P explicitly
     const PetscInt *ans;
-    ierr = ISCreate(PETSC_COMM_WORLD,&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISCreate(PETSC_COMM_SELF,&(mesh->ns)); CHKERRQ(ierr);
     ierr = ISLoad(mesh->ns,viewer); CHKERRQ(ierr);
-    ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
-    if (ans[0] < 0) {
+    ierr = ISGetSize(mesh->ns,&(mesh->P)); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        if (ans[0] < 0)
+            mesh->P = 0;
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+    if (mesh->P == 0) {
         ISDestroy(&(mesh->ns));
         mesh->ns = NULL;
-        mesh->P = 0;
     } else {
-        ierr = ISGetSize(mesh->ns,&(mesh->P)); CHKERRQ(ierr);
         if (mesh->P % 2 != 0) {
             SETERRQ1(PETSC_COMM_SELF,4,
                      "IS s loaded from %s is wrong size for list of Neumann boundary segment pairs\n",filename);
@@ -244,6 +497,724 @@ PetscErrorCode UMReadISs(UM *mesh, char *filename) {
 }
 
 
+/* The packed format, in native byte order, is a header of eight 64-bit
+integers
+    magic = UMSH_MAGIC, version = 1, sizeof(PetscInt), sizeof(PetscReal),
+    N, K, P, 0
+followed by the arrays
+    loc[2N] (PetscReal), e[3K], bf[N], ns[2P] (PetscInt)
+with no padding.  P = 0 means no Neumann segments; there is no marker value.
+The mapping is private, so later in-place changes do not reach the file. */
+#define UMSH_MAGIC 0x48534d55  // "UMSH" in little-endian bytes
+PetscErrorCode UMReadPacked(UM *mesh, char *filename) {
+    PetscErrorCode ierr;
+    int          fd;
+    struct stat  st;
+    PetscInt64      *head;
+    char         *p;
+    size_t       need;
+    if ((mesh->N > 0) || (mesh->K > 0) || (mesh->loc != NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"nodes or elements already created?\n");
+    }
+    fd = open(filename,O_RDONLY);
+    if (fd < 0) {
+        SETERRQ1(PETSC_COMM_SELF,2,"unable to open packed mesh file %s\n",filename);
+    }
+    if ((fstat(fd,&st) != 0) || ((size_t)st.st_size < 8 * sizeof(PetscInt64))) {
+        close(fd);
+        SETERRQ1(PETSC_COMM_SELF,3,"file %s too short for packed mesh header\n",filename);
+    }
+    // every process maps the whole mesh; see UMDistribute()
+    mesh->maplen = (size_t)st.st_size;
+    mesh->map = mmap(NULL,mesh->maplen,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (mesh->map == MAP_FAILED) {
+        mesh->map = NULL;
+        mesh->maplen = 0;
+        SETERRQ1(PETSC_COMM_SELF,4,"mmap() failed on %s\n",filename);
+    }
+    head = (PetscInt64 *)mesh->map;
+    if ((head[0] != UMSH_MAGIC) || (head[1] != 1)) {
+        SETERRQ1(PETSC_COMM_SELF,5,"%s is not a version 1 packed mesh file (or has other byte order)\n",filename);
+    }
+    if ((head[2] != sizeof(PetscInt)) || (head[3] != sizeof(PetscReal))) {
+        SETERRQ2(PETSC_COMM_SELF,6,
+                 "%s has integer or real sizes not matching this PETSc (%d-byte PetscInt)\n",
+                 filename,(int)sizeof(PetscInt));
+    }
+    mesh->N = (PetscInt)head[4];
+    mesh->K = (PetscInt)head[5];
+    mesh->P = (PetscInt)head[6];
+    need = 8 * sizeof(PetscInt64) + 2 * mesh->N * sizeof(PetscReal)
+           + (3 * mesh->K + mesh->N + 2 * mesh->P) * sizeof(PetscInt);
+    if ((mesh->N <= 0) || (mesh->K <= 0) || (mesh->P < 0) || (need > mesh->maplen)) {
+        SETERRQ1(PETSC_COMM_SELF,7,"sizes in header of %s inconsistent with file length\n",filename);
+    }
+    p = (char *)mesh->map + 8 * sizeof(PetscInt64);
+    ierr = VecCreateSeqWithArray(PETSC_COMM_SELF,1,2*mesh->N,(PetscReal *)p,&(mesh->loc)); CHKERRQ(ierr);
+    p += 2 * mesh->N * sizeof(PetscReal);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,3*mesh->K,(PetscInt *)p,PETSC_USE_POINTER,&(mesh->e)); CHKERRQ(ierr);
+    p += 3 * mesh->K * sizeof(PetscInt);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->N,(PetscInt *)p,PETSC_USE_POINTER,&(mesh->bf)); CHKERRQ(ierr);
+    p += mesh->N * sizeof(PetscInt);
+    if (mesh->P > 0) {
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,2*mesh->P,(PetscInt *)p,PETSC_USE_POINTER,&(mesh->ns)); CHKERRQ(ierr);
+    }
+    mesh->Nown = mesh->N;
+    mesh->Nglobal = mesh->N;
+    mesh->Kown = mesh->K;
+    mesh->Kglobal = mesh->K;
+
+    ierr = UMCheckElements(mesh); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+    return 0;
+}
+
+
+/* Streaming reader for ASCII Gmsh files in format 4.1 or 2.2 (legacy), as
+generated from the .geo files in meshes/; compare meshes/format41.py and
+meshes/format22.py.  The file is read once, token by token with fscanf(), so
+only the mesh arrays are held in memory.  Boundary flags come from physical
+groups named "dirichlet" (bf=2) and "neumann" (bf=1; these segments also go in
+ns), with Dirichlet winning at a node on both.  In format 4.1 the group of a
+boundary segment is found through the curve entity of its block.  Triangles
+are elements regardless of their group.  Unknown sections are skipped.     */
+#define GMSHREAD(n,call,what) \
+    if ((call) != (n)) { \
+        SETERRQ2(PETSC_COMM_SELF,3,"error reading %s in %s\n",what,filename); }
+
+// flag (0,1,2) of the physical group or curve entity with tag, if listed
+static PetscInt GmshFlag(long tag, PetscInt n, const PetscInt *tags,
+                         const PetscInt *flags) {
+    PetscInt j;
+    for (j = 0; j < n; j++)
+        if (tags[j] == tag)
+            return flags[j];
+    return 0;
+}
+
+PetscErrorCode UMReadGmsh(UM *mesh, char *filename) {
+    PetscErrorCode ierr;
+    FILE       *fp;
+    char       word[256];
+    double     version = 0.0, x, y, z;
+    long       nphys = 0, ncurves = 0, npts, nsurf, nvol, nblocks, nent, nb,
+               nt, nn, dim, tag, etype, a, b, j, m, t, vtx[3];
+    PetscInt   *ptag = NULL, *pflag = NULL, *ctag = NULL, *cflag = NULL,
+               *ntag = NULL, *ae = NULL, *abf = NULL, *ans = NULL, flag, l;
+    PetscReal  *aloc = NULL;
+    PetscBool  isdir, isneu;
+
+    if ((mesh->N > 0) || (mesh->K > 0) || (mesh->loc != NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"nodes or elements already created?\n");
+    }
+    // every process reads the whole mesh; see UMDistribute()
+    ierr = PetscFOpen(PETSC_COMM_SELF,filename,"r",&fp); CHKERRQ(ierr);
+    while (fscanf(fp,"%255s",word) == 1) {
+        if (strcmp(word,"$MeshFormat") == 0) {
+            GMSHREAD(3,fscanf(fp,"%lf %ld %ld",&version,&t,&m),"$MeshFormat")
+            if ((version != 4.1 && version != 2.2) || (t != 0)) {
+                SETERRQ1(PETSC_COMM_SELF,2,
+                         "%s is not an ASCII Gmsh file in format 4.1 or 2.2\n",filename);
+            }
+        } else if (strcmp(word,"$PhysicalNames") == 0) {
+            GMSHREAD(1,fscanf(fp,"%ld",&nphys),"$PhysicalNames")
+            ierr = PetscMalloc2(nphys,&ptag,nphys,&pflag); CHKERRQ(ierr);
+            for (j = 0; j < nphys; j++) {
+                GMSHREAD(3,fscanf(fp,"%ld %ld %255s",&dim,&tag,word),"$PhysicalNames")
+                ierr = PetscStrcasecmp(word,"\"dirichlet\"",&isdir); CHKERRQ(ierr);
+                ierr = PetscStrcasecmp(word,"\"neumann\"",&isneu); CHKERRQ(ierr);
+                ptag[j] = tag;
+                pflag[j] = isdir ? 2 : (isneu ? 1 : 0);
+            }
+        } else if (strcmp(word,"$Entities") == 0) {
+            GMSHREAD(4,fscanf(fp,"%ld %ld %ld %ld",&npts,&ncurves,&nsurf,&nvol),"$Entities")
+            for (j = 0; j < npts; j++) {
+                GMSHREAD(5,fscanf(fp,"%ld %lf %lf %lf %ld",&tag,&x,&y,&z,&nt),"$Entities")
+                for (m = 0; m < nt; m++) {
+                    GMSHREAD(1,fscanf(fp,"%ld",&t),"$Entities")
+                }
+            }
+            // curves then surfaces and volumes have the same line format;
+            //   record the flag of each curve
+            ierr = PetscMalloc2(ncurves,&ctag,ncurves,&cflag); CHKERRQ(ierr);
+            for (j = 0; j < ncurves + nsurf + nvol; j++) {
+                GMSHREAD(8,fscanf(fp,"%ld %lf %lf %lf %lf %lf %lf %ld",
+                                  &tag,&x,&y,&z,&x,&y,&z,&nt),"$Entities")
+                flag = 0;
+                for (m = 0; m < nt; m++) {
+                    GMSHREAD(1,fscanf(fp,"%ld",&t),"$Entities")
+                    flag = PetscMax(flag,GmshFlag(t,nphys,ptag,pflag));
+                }
+                if (j < ncurves) {
+                    ctag[j] = tag;
+                    cflag[j] = flag;
+                }
+                GMSHREAD(1,fscanf(fp,"%ld",&nb),"$Entities")
+                for (m = 0; m < nb; m++) {
+                    GMSHREAD(1,fscanf(fp,"%ld",&t),"$Entities")
+                }
+            }
+        } else if (strcmp(word,"$Nodes") == 0) {
+            if (version > 3.0) {
+                GMSHREAD(4,fscanf(fp,"%ld %ld %ld %ld",&nblocks,&nent,&t,&m),"$Nodes")
+            } else {
+                nblocks = 1;
+                GMSHREAD(1,fscanf(fp,"%ld",&nent),"$Nodes")
+            }
+            mesh->N = nent;
+            ierr = VecCreateSeq(PETSC_COMM_SELF,2*mesh->N,&(mesh->loc)); CHKERRQ(ierr);
+            ierr = VecGetArray(mesh->loc,&aloc); CHKERRQ(ierr);
+            ierr = PetscMalloc1(mesh->N,&ntag); CHKERRQ(ierr);
+            for (b = 0; b < nblocks; b++) {
+                if (version > 3.0) {
+                    GMSHREAD(4,fscanf(fp,"%ld %ld %ld %ld",&dim,&tag,&t,&nb),"$Nodes")
+                    if (t != 0) {
+                        SETERRQ1(PETSC_COMM_SELF,4,"parametric nodes in %s not allowed\n",filename);
+                    }
+                    for (j = 0; j < nb; j++) {
+                        GMSHREAD(1,fscanf(fp,"%ld",&t),"$Nodes")
+                        ntag[j] = t;
+                    }
+                } else {
+                    nb = nent;
+                }
+                for (j = 0; j < nb; j++) {
+                    if (version > 3.0) {
+                        GMSHREAD(3,fscanf(fp,"%lf %lf %lf",&x,&y,&z),"$Nodes")
+                        t = ntag[j];
+                    } else {
+                        GMSHREAD(4,fscanf(fp,"%ld %lf %lf %lf",&t,&x,&y,&z),"$Nodes")
+                    }
+                    if ((t < 1) || (t > mesh->N)) {
+                        SETERRQ2(PETSC_COMM_SELF,5,
+                                 "node tag %ld in %s not in 1,...,N; noncontiguous tags not allowed\n",
+                                 t,filename);
+                    }
+                    aloc[2*(t-1)+0] = x;
+                    aloc[2*(t-1)+1] = y;
+                }
+            }
+            ierr = VecRestoreArray(mesh->loc,&aloc); CHKERRQ(ierr);
+            ierr = PetscFree(ntag); CHKERRQ(ierr);
+        } else if (strcmp(word,"$Elements") == 0) {
+            if (mesh->N == 0) {
+                SETERRQ1(PETSC_COMM_SELF,6,"$Elements before $Nodes in %s\n",filename);
+            }
+            if (version > 3.0) {
+                GMSHREAD(4,fscanf(fp,"%ld %ld %ld %ld",&nblocks,&nent,&t,&m),"$Elements")
+            } else {
+                nblocks = 1;
+                GMSHREAD(1,fscanf(fp,"%ld",&nent),"$Elements")
+            }
+            // nent bounds both the number of triangles and of segments
+            ierr = PetscMalloc2(3*nent,&ae,2*nent,&ans); CHKERRQ(ierr);
+            ierr = PetscCalloc1(mesh->N,&abf); CHKERRQ(ierr);
+            etype = 0;
+            flag = 0;
+            for (b = 0; b < nblocks; b++) {
+                if (version > 3.0) {
+                    GMSHREAD(4,fscanf(fp,"%ld %ld %ld %ld",&dim,&tag,&etype,&nb),"$Elements")
+                    flag = (etype == 1) ? GmshFlag(tag,ncurves,ctag,cflag) : 0;
+                } else {
+                    nb = nent;
+                }
+                for (j = 0; j < nb; j++) {
+                    if (version > 3.0) {
+                        GMSHREAD(1,fscanf(fp,"%ld",&t),"$Elements")
+                    } else {
+                        GMSHREAD(3,fscanf(fp,"%ld %ld %ld",&t,&etype,&nt),"$Elements")
+                        flag = 0;  // no tags means no physical group
+                        for (m = 0; m < nt; m++) {
+                            GMSHREAD(1,fscanf(fp,"%ld",&tag),"$Elements")
+                            if (m == 0)  // first tag is the physical group
+                                flag = (etype == 1) ? GmshFlag(tag,nphys,ptag,pflag) : 0;
+                        }
+                    }
+                    switch (etype) {
+                        case 1 :  nn = 2;  break;  // boundary segment
+                        case 2 :  nn = 3;  break;  // triangle
+                        case 15 : nn = 1;  break;  // point; ignored
+                        default :
+                            SETERRQ2(PETSC_COMM_SELF,7,
+                                     "Gmsh element type %ld in %s not allowed\n",etype,filename);
+                    }
+                    for (m = 0; m < nn; m++) {
+                        GMSHREAD(1,fscanf(fp,"%ld",&a),"$Elements")
+                        if ((a < 1) || (a > mesh->N)) {
+                            SETERRQ2(PETSC_COMM_SELF,8,"node tag %ld in %s out of range\n",a,filename);
+                        }
+                        vtx[m] = a - 1;
+                    }
+                    if (etype == 2) {
+                        for (l = 0; l < 3; l++)
+                            ae[3*mesh->K+l] = vtx[l];
+                        mesh->K++;
+                    } else if (etype == 1) {
+                        for (l = 0; l < 2; l++)
+                            abf[vtx[l]] = PetscMax(abf[vtx[l]],flag);
+                        if (flag == 1) {
+                            ans[2*mesh->P+0] = vtx[0];
+                            ans[2*mesh->P+1] = vtx[1];
+                            mesh->P++;
+                        }
+                    }
+                }
+            }
+        } else if ((word[0] == '$') && (strncmp(word,"$End",4) != 0)) {
+            // skip unknown section
+            while ((fscanf(fp,"%255s",word) == 1) && (strncmp(word,"$End",4) != 0))
+                ;
+        }
+    }
+    ierr = PetscFClose(PETSC_COMM_SELF,fp); CHKERRQ(ierr);
+    ierr = PetscFree2(ptag,pflag); CHKERRQ(ierr);
+    ierr = PetscFree2(ctag,cflag); CHKERRQ(ierr);
+    if ((mesh->N == 0) || (mesh->K == 0)) {
+        SETERRQ1(PETSC_COMM_SELF,9,"no nodes or no triangles read from %s\n",filename);
+    }
+
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,3*mesh->K,ae,PETSC_COPY_VALUES,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->N,abf,PETSC_OWN_POINTER,&(mesh->bf)); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,2*mesh->P,ans,PETSC_COPY_VALUES,&(mesh->ns)); CHKERRQ(ierr);
+    }
+    ierr = PetscFree2(ae,ans); CHKERRQ(ierr);
+    mesh->Nown = mesh->N;
+    mesh->Nglobal = mesh->N;
+    mesh->Kown = mesh->K;
+    mesh->Kglobal = mesh->K;
+
+    ierr = UMCheckElements(mesh); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+    return 0;
+}
+#undef GMSHREAD
+
+
+/* Edges are found with an open-addressing hash table keyed on the ordered
+node pair.  Each entry records the index of the new midpoint node and the
+number of triangles sharing the edge; an edge with one triangle is on the
+boundary.  A boundary edge which is a Neumann segment gives a midpoint with
+bf = 1, other boundary edges are Dirichlet (bf = 2), and interior edges give
+bf = 0.                                                                   */
+typedef struct {
+    PetscInt a, b,     // end nodes with a < b; a = -1 for empty slot
+             mid,      // index of midpoint node in fine mesh
+             count;    // number of triangles sharing edge
+} UMEdge;
+
+static PetscInt UMEdgeFind(UMEdge *table, PetscInt mask, PetscInt a, PetscInt b) {
+    PetscInt  tmp, j;
+    if (a > b) {
+        tmp = a;  a = b;  b = tmp;
+    }
+    j = (PetscInt)(((size_t)a * 73856093u ^ (size_t)b * 19349663u) & (size_t)mask);
+    while (table[j].a >= 0 && (table[j].a != a || table[j].b != b))
+        j = (j + 1) & mask;  // linear probing
+    if (table[j].a < 0) {
+        table[j].a = a;
+        table[j].b = b;
+    }
+    return j;
+}
+
+// nodes of the mesh which adds the edge midpoints to coarse:  fill the edge
+//   table and create loc, bf, and parent in fine; midpoints are numbered
+//   after the coarse nodes, in order of first appearance in the elements
+static PetscErrorCode UMMidpointNodes(UM *coarse, UM *fine, UMEdge **table,
+                                      PetscInt *mask) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf, *ans, *en;
+    const Node     *aloc;
+    UMEdge         *tab;
+    Node           *floc;
+    PetscInt       *fbf, *fpar, cap, N, n, k, l, j;
+
+    if ((coarse->K == 0) || (coarse->e == NULL) || (coarse->bf == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"coarse mesh not complete; read it first\n");
+    }
+    if (coarse->ltog || coarse->natural) {
+        SETERRQ(PETSC_COMM_SELF,2,"refine before calling UMReorder() or UMDistribute()\n");
+    }
+    if ((fine->N > 0) || (fine->K > 0) || (fine->loc != NULL)) {
+        SETERRQ(PETSC_COMM_SELF,3,"fine mesh must be empty; call UMInitialize() only\n");
+    }
+    if (coarse->nen != 3) {
+        SETERRQ(PETSC_COMM_SELF,4,"coarse mesh must have P1 elements\n");
+    }
+    // capacity is a power of two at least twice the number of edges
+    for (cap = 1; cap < 4 * coarse->K + 4; cap *= 2)
+        ;
+    *mask = cap - 1;
+    ierr = PetscMalloc1(cap,&tab); CHKERRQ(ierr);
+    for (j = 0; j < cap; j++) {
+        tab[j].a = -1;
+        tab[j].count = 0;
+    }
+
+    // find edges and number their midpoints after the coarse nodes
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    N = coarse->N;
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            j = UMEdgeFind(tab,*mask,en[l],en[(l+1)%3]);
+            if (tab[j].count++ == 0)
+                tab[j].mid = N++;
+        }
+    }
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    fine->N = N;
+
+    // nodes, parents, boundary flags
+    ierr = UMGetNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = VecCreateSeq(PETSC_COMM_SELF,2*fine->N,&(fine->loc)); CHKERRQ(ierr);
+    ierr = VecGetArray(fine->loc,(PetscReal **)&floc); CHKERRQ(ierr);
+    ierr = PetscMalloc2(fine->N,&fbf,2*fine->N,&fpar); CHKERRQ(ierr);
+    for (n = 0; n < coarse->N; n++) {
+        floc[n] = aloc[n];
+        fbf[n] = abf[n];
+        fpar[2*n+0] = n;
+        fpar[2*n+1] = n;
+    }
+    for (j = 0; j < cap; j++) {
+        if (tab[j].a < 0)
+            continue;
+        n = tab[j].mid;
+        floc[n].x = 0.5 * (aloc[tab[j].a].x + aloc[tab[j].b].x);
+        floc[n].y = 0.5 * (aloc[tab[j].a].y + aloc[tab[j].b].y);
+        fbf[n] = (tab[j].count == 1) ? 2 : 0;  // Neumann fixed below
+        fpar[2*n+0] = tab[j].a;
+        fpar[2*n+1] = tab[j].b;
+    }
+    ierr = VecRestoreArray(fine->loc,(PetscReal **)&floc); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    if (coarse->P > 0) {
+        ierr = ISGetIndices(coarse->ns,&ans); CHKERRQ(ierr);
+        for (k = 0; k < coarse->P; k++)
+            fbf[tab[UMEdgeFind(tab,*mask,ans[2*k+0],ans[2*k+1])].mid] = 1;
+        ierr = ISRestoreIndices(coarse->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,fine->N,fbf,PETSC_COPY_VALUES,&(fine->bf)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,2*fine->N,fpar,PETSC_COPY_VALUES,&(fine->parent)); CHKERRQ(ierr);
+    ierr = PetscFree2(fbf,fpar); CHKERRQ(ierr);
+    *table = tab;
+    return 0;
+}
+
+PetscErrorCode UMRefineUniform(UM *coarse, UM *fine) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *ans, *en;
+    UMEdge         *table;
+    PetscInt       *fe, *fns, mask, n, k, l, j, m[3];
+
+    ierr = UMMidpointNodes(coarse,fine,&table,&mask); CHKERRQ(ierr);
+    fine->K = 4 * coarse->K;
+    fine->P = 2 * coarse->P;
+
+    // split Neumann segments
+    if (coarse->P > 0) {
+        ierr = ISGetIndices(coarse->ns,&ans); CHKERRQ(ierr);
+        ierr = PetscMalloc1(2*fine->P,&fns); CHKERRQ(ierr);
+        for (k = 0; k < coarse->P; k++) {
+            j = UMEdgeFind(table,mask,ans[2*k+0],ans[2*k+1]);
+            n = table[j].mid;
+            fns[4*k+0] = ans[2*k+0];
+            fns[4*k+1] = n;
+            fns[4*k+2] = n;
+            fns[4*k+3] = ans[2*k+1];
+        }
+        ierr = ISRestoreIndices(coarse->ns,&ans); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,2*fine->P,fns,PETSC_OWN_POINTER,&(fine->ns)); CHKERRQ(ierr);
+    }
+
+    // split triangles; children keep the orientation of the parent
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = PetscMalloc1(3*fine->K,&fe); CHKERRQ(ierr);
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++)  // m[l] is midpoint of edge en[l],en[l+1]
+            m[l] = table[UMEdgeFind(table,mask,en[l],en[(l+1)%3])].mid;
+        fe[12*k+0] = en[0];  fe[12*k+1]  = m[0];   fe[12*k+2]  = m[2];
+        fe[12*k+3] = m[0];   fe[12*k+4]  = en[1];  fe[12*k+5]  = m[1];
+        fe[12*k+6] = m[2];   fe[12*k+7]  = m[1];   fe[12*k+8]  = en[2];
+        fe[12*k+9] = m[0];   fe[12*k+10] = m[1];   fe[12*k+11] = m[2];
+    }
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree(table); CHKERRQ(ierr);
+
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,3*fine->K,fe,PETSC_OWN_POINTER,&(fine->e)); CHKERRQ(ierr);
+    fine->Nown = fine->N;
+    fine->Nglobal = fine->N;
+    fine->Kown = fine->K;
+    fine->Kglobal = fine->K;
+    ierr = UMCheckElements(fine); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(fine); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMElevateP2(UM *p1, UM *p2) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *ans, *en;
+    UMEdge         *table;
+    PetscInt       *fe, *fns, mask, k, l;
+
+    ierr = UMMidpointNodes(p1,p2,&table,&mask); CHKERRQ(ierr);
+    p2->K = p1->K;
+    p2->P = p1->P;
+    p2->nen = 6;
+    p2->nsn = 3;
+
+    // Neumann segments get their midpoint
+    if (p1->P > 0) {
+        ierr = ISGetIndices(p1->ns,&ans); CHKERRQ(ierr);
+        ierr = PetscMalloc1(3*p2->P,&fns); CHKERRQ(ierr);
+        for (k = 0; k < p1->P; k++) {
+            fns[3*k+0] = ans[2*k+0];
+            fns[3*k+1] = ans[2*k+1];
+            fns[3*k+2] = table[UMEdgeFind(table,mask,ans[2*k+0],ans[2*k+1])].mid;
+        }
+        ierr = ISRestoreIndices(p1->ns,&ans); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,3*p2->P,fns,PETSC_OWN_POINTER,&(p2->ns)); CHKERRQ(ierr);
+    }
+
+    // elements get their three edge midpoints after the vertices
+    ierr = ISGetIndices(p1->e,&ae); CHKERRQ(ierr);
+    ierr = PetscMalloc1(6*p2->K,&fe); CHKERRQ(ierr);
+    for (k = 0; k < p1->K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            fe[6*k+l] = en[l];
+            fe[6*k+3+l] = table[UMEdgeFind(table,mask,en[l],en[(l+1)%3])].mid;
+        }
+    }
+    ierr = ISRestoreIndices(p1->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree(table); CHKERRQ(ierr);
+
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,6*p2->K,fe,PETSC_OWN_POINTER,&(p2->e)); CHKERRQ(ierr);
+    p2->Nown = p2->N;
+    p2->Nglobal = p2->N;
+    p2->Kown = p2->K;
+    p2->Kglobal = p2->K;
+    ierr = UMCheckElements(p2); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(p2); CHKERRQ(ierr);
+    return 0;
+}
+
+
+// edge table for a P1 mesh, with mid = -1 (no midpoint) and count set
+static PetscErrorCode UMEdgeTable(UM *mesh, const PetscInt *ae, PetscInt cap,
+                                  UMEdge **table) {
+    PetscErrorCode ierr;
+    PetscInt       k, l, j;
+    ierr = PetscMalloc1(cap,table); CHKERRQ(ierr);
+    for (j = 0; j < cap; j++) {
+        (*table)[j].a = -1;
+        (*table)[j].mid = -1;
+        (*table)[j].count = 0;
+    }
+    for (k = 0; k < mesh->K; k++)
+        for (l = 0; l < 3; l++)
+            (*table)[UMEdgeFind(*table,cap-1,ae[3*k+l],ae[3*k+(l+1)%3])].count++;
+    return 0;
+}
+
+PetscErrorCode UMEdgeNeighbors(UM *mesh, PetscInt **nbr) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *ans;
+    UMEdge         *table;
+    PetscInt       cap, mask, k, l, j, s, p;
+
+    if (mesh->nen != 3) {
+        SETERRQ(PETSC_COMM_SELF,1,"edge neighbors only for P1 elements\n");
+    }
+    for (cap = 1; cap < 4 * mesh->K + 4; cap *= 2)
+        ;
+    mask = cap - 1;
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMEdgeTable(mesh,ae,cap,&table); CHKERRQ(ierr);
+    ierr = PetscMalloc1(3*mesh->K,nbr); CHKERRQ(ierr);
+    // mid records the first slot 3k+l which has the edge
+    for (k = 0; k < mesh->K; k++) {
+        for (l = 0; l < 3; l++) {
+            s = 3*k+l;
+            j = UMEdgeFind(table,mask,ae[s],ae[3*k+(l+1)%3]);
+            if (table[j].mid < 0) {
+                table[j].mid = s;
+                (*nbr)[s] = -1;
+            } else {
+                (*nbr)[s] = table[j].mid;
+                (*nbr)[table[j].mid] = s;
+            }
+        }
+    }
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        for (p = 0; p < mesh->P; p++) {
+            j = UMEdgeFind(table,mask,ans[2*p+0],ans[2*p+1]);
+            if (table[j].count == 1)
+                (*nbr)[table[j].mid] = -2 - p;
+        }
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree(table); CHKERRQ(ierr);
+    return 0;
+}
+
+// newest vertex bisection of triangle a,b,c with refinement edge a,b:
+//   the children c,a,m and b,c,m have refinement edges opposite the new
+//   vertex m; at depth 2 the refinement edge is new so it is not split
+static void UMBisect(UMEdge *table, PetscInt mask, PetscInt a, PetscInt b,
+                     PetscInt c, PetscInt depth, PetscInt *fe, PetscInt *K) {
+    PetscInt  m = -1;
+    if (depth < 2)
+        m = table[UMEdgeFind(table,mask,a,b)].mid;
+    if (m < 0) {
+        fe[3*(*K)+0] = a;  fe[3*(*K)+1] = b;  fe[3*(*K)+2] = c;
+        (*K)++;
+        return;
+    }
+    UMBisect(table,mask,c,a,m,depth+1,fe,K);
+    UMBisect(table,mask,b,c,m,depth+1,fe,K);
+}
+
+/* Each marked element has all three edges split, and each element with a
+split edge then also has its refinement edge split, repeating until no
+change (the closure).  The split edges get midpoints numbered after the
+coarse nodes, and each element is bisected recursively, so it becomes one,
+two, three, or four children, and the fine mesh has no hanging nodes.
+Boundary flags and Neumann segments follow as in UMMidpointNodes().      */
+PetscErrorCode UMRefineMarked(UM *coarse, const PetscBool *marked, UM *fine) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf, *ans, *en;
+    const Node     *aloc;
+    UMEdge         *table;
+    Node           *floc;
+    PetscInt       *fe, *fbf, *fns, cap, mask, N, n, k, l, j, p;
+    PetscBool      changed;
+
+    if ((coarse->K == 0) || (coarse->e == NULL) || (coarse->bf == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"coarse mesh not complete; read it first\n");
+    }
+    if ((coarse->K != coarse->Kglobal) || (coarse->N != coarse->Nglobal)) {
+        SETERRQ(PETSC_COMM_SELF,2,"coarse mesh must be whole on this process\n");
+    }
+    if ((fine->N > 0) || (fine->K > 0) || (fine->loc != NULL)) {
+        SETERRQ(PETSC_COMM_SELF,3,"fine mesh must be empty; call UMInitialize() only\n");
+    }
+    if (coarse->nen != 3) {
+        SETERRQ(PETSC_COMM_SELF,4,"coarse mesh must have P1 elements\n");
+    }
+    // new edges from bisection are never looked up, so this is enough room
+    for (cap = 1; cap < 4 * coarse->K + 4; cap *= 2)
+        ;
+    mask = cap - 1;
+    ierr = ISGetIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = UMEdgeTable(coarse,ae,cap,&table); CHKERRQ(ierr);
+
+    // split edges of marked elements, then the closure; mid = -2 means
+    //   split but not yet numbered
+    for (k = 0; k < coarse->K; k++) {
+        if (marked[k]) {
+            for (l = 0; l < 3; l++)
+                table[UMEdgeFind(table,mask,ae[3*k+l],ae[3*k+(l+1)%3])].mid = -2;
+        }
+    }
+    do {
+        changed = PETSC_FALSE;
+        for (k = 0; k < coarse->K; k++) {
+            en = ae + 3*k;
+            j = UMEdgeFind(table,mask,en[0],en[1]);
+            if (table[j].mid == -2)
+                continue;
+            for (l = 1; l < 3; l++) {
+                if (table[UMEdgeFind(table,mask,en[l],en[(l+1)%3])].mid == -2) {
+                    table[j].mid = -2;
+                    changed = PETSC_TRUE;
+                    break;
+                }
+            }
+        }
+    } while (changed);
+    N = coarse->N;
+    for (k = 0; k < coarse->K; k++) {
+        for (l = 0; l < 3; l++) {
+            j = UMEdgeFind(table,mask,ae[3*k+l],ae[3*k+(l+1)%3]);
+            if (table[j].mid == -2)
+                table[j].mid = N++;
+        }
+    }
+    fine->N = N;
+
+    // nodes and boundary flags
+    ierr = UMGetNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = VecCreateSeq(PETSC_COMM_SELF,2*fine->N,&(fine->loc)); CHKERRQ(ierr);
+    ierr = VecGetArray(fine->loc,(PetscReal **)&floc); CHKERRQ(ierr);
+    ierr = PetscMalloc1(fine->N,&fbf); CHKERRQ(ierr);
+    for (n = 0; n < coarse->N; n++) {
+        floc[n] = aloc[n];
+        fbf[n] = abf[n];
+    }
+    for (j = 0; j < cap; j++) {
+        if (table[j].a < 0 || table[j].mid < 0)
+            continue;
+        n = table[j].mid;
+        floc[n].x = 0.5 * (aloc[table[j].a].x + aloc[table[j].b].x);
+        floc[n].y = 0.5 * (aloc[table[j].a].y + aloc[table[j].b].y);
+        fbf[n] = (table[j].count == 1) ? 2 : 0;  // Neumann fixed below
+    }
+    ierr = VecRestoreArray(fine->loc,(PetscReal **)&floc); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(coarse->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(coarse,&aloc); CHKERRQ(ierr);
+
+    // Neumann segments, split where the edge is
+    fine->P = 0;
+    if (coarse->P > 0) {
+        ierr = ISGetIndices(coarse->ns,&ans); CHKERRQ(ierr);
+        ierr = PetscMalloc1(4*coarse->P,&fns); CHKERRQ(ierr);
+        for (p = 0; p < coarse->P; p++) {
+            n = table[UMEdgeFind(table,mask,ans[2*p+0],ans[2*p+1])].mid;
+            if (n >= 0) {
+                fbf[n] = 1;
+                fns[2*fine->P+0] = ans[2*p+0];  fns[2*fine->P+1] = n;
+                fns[2*fine->P+2] = n;           fns[2*fine->P+3] = ans[2*p+1];
+                fine->P += 2;
+            } else {
+                fns[2*fine->P+0] = ans[2*p+0];  fns[2*fine->P+1] = ans[2*p+1];
+                fine->P += 1;
+            }
+        }
+        ierr = ISRestoreIndices(coarse->ns,&ans); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,2*fine->P,fns,PETSC_OWN_POINTER,&(fine->ns)); CHKERRQ(ierr);
+    }
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,fine->N,fbf,PETSC_OWN_POINTER,&(fine->bf)); CHKERRQ(ierr);
+
+    // bisect triangles; children keep the orientation of the parent
+    ierr = PetscMalloc1(12*coarse->K,&fe); CHKERRQ(ierr);
+    fine->K = 0;
+    for (k = 0; k < coarse->K; k++) {
+        en = ae + 3*k;
+        UMBisect(table,mask,en[0],en[1],en[2],0,fe,&(fine->K));
+    }
+    ierr = ISRestoreIndices(coarse->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree(table); CHKERRQ(ierr);
+
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,3*fine->K,fe,PETSC_COPY_VALUES,&(fine->e)); CHKERRQ(ierr);
+    ierr = PetscFree(fe); CHKERRQ(ierr);
+    fine->Nown = fine->N;
+    fine->Nglobal = fine->N;
+    fine->Kown = fine->K;
+    fine->Kglobal = fine->K;
+    ierr = UMCheckElements(fine); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(fine); CHKERRQ(ierr);
+    return 0;
+}
+
 PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
                        PetscReal *maxa, PetscReal *meana) {
     PetscErrorCode ierr;
@@ -251,7 +1222,8 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     const Node     *aloc;
     PetscInt       k;
     PetscReal      x[3], y[3], ax, ay, bx, by, cx, cy, h, a,
-                   Maxh = 0.0, Maxa = 0.0, Sumh = 0.0, Suma = 0.0;
+                   Maxh = 0.0, Maxa = 0.0, Sumh = 0.0, Suma = 0.0,
+                   lmax[2], gmax[2], lsum[2], gsum[2];
     if ((mesh->K == 0) || (mesh->e == NULL)) {
         SETERRQ(PETSC_COMM_SELF,1,
                 "number of elements unknown; call UMReadElements() first\n");
@@ -262,13 +1234,13 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     }
     ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
     ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
-    for (k = 0; k < mesh->K; k++) {
-        x[0] = aloc[ae[3*k]].x;
-        y[0] = aloc[ae[3*k]].y;
-        x[1] = aloc[ae[3*k+1]].x;
-        y[1] = aloc[ae[3*k+1]].y;
-        x[2] = aloc[ae[3*k+2]].x;
-        y[2] = aloc[ae[3*k+2]].y;
+    for (k = 0; k < mesh->Kown; k++) {
+        x[0] = aloc[ae[mesh->nen*k]].x;
+        y[0] = aloc[ae[mesh->nen*k]].y;
+        x[1] = aloc[ae[mesh->nen*k+1]].x;
+        y[1] = aloc[ae[mesh->nen*k+1]].y;
+        x[2] = aloc[ae[mesh->nen*k+2]].x;
+        y[2] = aloc[ae[mesh->nen*k+2]].y;
         ax = x[1] - x[0];
         ay = y[1] - y[0];
         bx = x[2] - x[0];
@@ -285,10 +1257,220 @@ PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
     }
     ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
     ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
-    if (maxh)  *maxh = Maxh;
-    if (maxa)  *maxa = Maxa;
-    if (meanh)  *meanh = Sumh / mesh->K;
-    if (meana)  *meana = Suma / mesh->K;
+    lmax[0] = Maxh;  lmax[1] = Maxa;
+    lsum[0] = Sumh;  lsum[1] = Suma;
+    ierr = MPI_Allreduce(lmax,gmax,2,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(lsum,gsum,2,MPIU_REAL,MPIU_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    if (maxh)  *maxh = gmax[0];
+    if (maxa)  *maxa = gmax[1];
+    if (meanh)  *meanh = gsum[0] / mesh->Kglobal;
+    if (meana)  *meana = gsum[1] / mesh->Kglobal;
+    return 0;
+}
+
+// upper ends of the aspect ratio bins in UMQuality.aspect[]; the last bin is
+//   open-ended
+static const PetscReal aspectbinend[UM_ASPECT_BINS-1] = {1.5, 2.0, 3.0, 5.0, 10.0};
+
+/* Elements are visited in one threaded pass which computes each element's
+diameter (longest side) into a scratch array, and reduces the angle and aspect
+ratio statistics over owned elements.  A serial pass over the element-node
+incidences then finds, for each owned vertex, the number of incident elements
+and the smallest and largest incident diameters.  After UMDistribute() the
+local elements include every element touching an owned node, so the vertex
+statistics need no communication other than the final reductions.  Only the
+vertices e[nen*k+0,1,2] are used, so P2 meshes are also allowed.          */
+PetscErrorCode UMQualityStats(UM *mesh, PetscInt threads, UMQuality *qs) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf;
+    const Node     *aloc;
+    PetscInt       K = mesh->K, k, l, i, b, v, nvert = 0,
+                   *count, aspect[UM_ASPECT_BINS], valence[UM_VALENCE_BINS],
+                   lhist[UM_ASPECT_BINS+UM_VALENCE_BINS+1],
+                   ghist[UM_ASPECT_BINS+UM_VALENCE_BINS+1];
+    PetscReal      *diam, *hmin, *hmax, ex[3], ey[3], len[3], c, cmax, cmin,
+                   per, area, ar, ratio,
+                   mincos = 1.0, maxcos = -1.0, maxar = 0.0, summin = 0.0,
+                   sumar = 0.0, maxgr = 1.0, sumgr = 0.0,
+                   lmax[4], gmax[4], lsum[3], gsum[3];
+
+    if ((K == 0) || (mesh->e == NULL) || (mesh->N == 0) || (mesh->bf == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,
+                "mesh not complete; call UMReadNodes() and UMReadISs() first\n");
+    }
+    for (b = 0; b < UM_ASPECT_BINS; b++)
+        aspect[b] = 0;
+    for (b = 0; b < UM_VALENCE_BINS; b++)
+        valence[b] = 0;
+    ierr = PetscMalloc4(K,&diam,mesh->N,&hmin,mesh->N,&hmax,mesh->N,&count); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    // angles and aspect ratio:  side l runs from vertex l to vertex (l+1)%3,
+    //   and the angle at vertex l is between sides l and (l+2)%3; the aspect
+    //   ratio (longest side)/(2 sqrt(3) inradius) is 1 for an equilateral
+    //   triangle
+#if !defined(_OPENMP)
+    (void)threads;
+#endif
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(threads) private(l,b,ex,ey,len,c,cmax,cmin,per,area,ar) reduction(min:mincos) reduction(max:maxcos,maxar) reduction(+:summin,sumar,aspect[:UM_ASPECT_BINS])
+#endif
+    for (k = 0; k < K; k++) {
+        const PetscInt *en = ae + mesh->nen * k;
+        per = 0.0;
+        diam[k] = 0.0;
+        for (l = 0; l < 3; l++) {
+            ex[l] = aloc[en[(l+1)%3]].x - aloc[en[l]].x;
+            ey[l] = aloc[en[(l+1)%3]].y - aloc[en[l]].y;
+            len[l] = PetscSqrtReal(ex[l] * ex[l] + ey[l] * ey[l]);
+            per += len[l];
+            diam[k] = PetscMax(diam[k],len[l]);
+        }
+        if (k >= mesh->Kown)
+            continue;
+        cmax = -1.0;  cmin = 1.0;
+        for (l = 0; l < 3; l++) {
+            c = - (ex[l] * ex[(l+2)%3] + ey[l] * ey[(l+2)%3])
+                / (len[l] * len[(l+2)%3]);
+            cmax = PetscMax(cmax,c);
+            cmin = PetscMin(cmin,c);
+        }
+        // largest cosine is smallest angle
+        maxcos = PetscMax(maxcos,cmax);
+        mincos = PetscMin(mincos,cmin);
+        summin += PetscAcosReal(PetscMin(cmax,1.0));
+        area = 0.5 * PetscAbsReal(ex[0] * ey[2] - ey[0] * ex[2]);
+        ar = diam[k] * per / (4.0 * PetscSqrtReal(3.0) * area);
+        maxar = PetscMax(maxar,ar);
+        sumar += ar;
+        b = 0;
+        while (b < UM_ASPECT_BINS-1 && ar >= aspectbinend[b])
+            b++;
+        aspect[b]++;
+    }
+
+    // vertex valence (number of neighboring vertices) and size gradation
+    for (i = 0; i < mesh->N; i++) {
+        count[i] = 0;
+        hmin[i] = PETSC_MAX_REAL;
+        hmax[i] = 0.0;
+    }
+    for (k = 0; k < K; k++) {
+        for (l = 0; l < 3; l++) {
+            i = ae[mesh->nen * k + l];
+            count[i]++;
+            hmin[i] = PetscMin(hmin[i],diam[k]);
+            hmax[i] = PetscMax(hmax[i],diam[k]);
+        }
+    }
+    for (i = 0; i < mesh->Nown; i++) {
+        if (count[i] == 0)  // a P2 midpoint
+            continue;
+        nvert++;
+        // a boundary vertex has one more neighbor than incident elements
+        v = count[i] + ((abf[i] > 0) ? 1 : 0);
+        valence[PetscMin(v,UM_VALENCE_BINS-1)]++;
+        ratio = hmax[i] / hmin[i];
+        maxgr = PetscMax(maxgr,ratio);
+        sumgr += ratio;
+    }
+
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    PetscFree4(diam,hmin,hmax,count);
+
+    // reductions over processes; the min is a max of the negative
+    lmax[0] = maxcos;  lmax[1] = - mincos;  lmax[2] = maxar;  lmax[3] = maxgr;
+    lsum[0] = summin;  lsum[1] = sumar;  lsum[2] = sumgr;
+    for (b = 0; b < UM_ASPECT_BINS; b++)
+        lhist[b] = aspect[b];
+    for (b = 0; b < UM_VALENCE_BINS; b++)
+        lhist[UM_ASPECT_BINS+b] = valence[b];
+    lhist[UM_ASPECT_BINS+UM_VALENCE_BINS] = nvert;
+    ierr = MPI_Allreduce(lmax,gmax,4,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(lsum,gsum,3,MPIU_REAL,MPIU_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    ierr = MPI_Allreduce(lhist,ghist,UM_ASPECT_BINS+UM_VALENCE_BINS+1,MPIU_INT,
+                         MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    qs->Nglobal = mesh->Nglobal;
+    qs->Kglobal = mesh->Kglobal;
+    qs->minangle = PetscAcosReal(PetscMin(gmax[0],1.0)) * 180.0 / PETSC_PI;
+    qs->maxangle = PetscAcosReal(PetscMax(-gmax[1],-1.0)) * 180.0 / PETSC_PI;
+    qs->meanminangle = gsum[0] / mesh->Kglobal * 180.0 / PETSC_PI;
+    qs->maxaspect = gmax[2];
+    qs->meanaspect = gsum[1] / mesh->Kglobal;
+    qs->maxgradation = gmax[3];
+    qs->meangradation = gsum[2] / ghist[UM_ASPECT_BINS+UM_VALENCE_BINS];
+    for (b = 0; b < UM_ASPECT_BINS; b++)
+        qs->aspect[b] = ghist[b];
+    qs->minvalence = -1;
+    qs->maxvalence = -1;
+    for (b = 0; b < UM_VALENCE_BINS; b++) {
+        qs->valence[b] = ghist[UM_ASPECT_BINS+b];
+        if (qs->valence[b] > 0) {
+            if (qs->minvalence < 0)
+                qs->minvalence = b;
+            qs->maxvalence = b;
+        }
+    }
+    return 0;
+}
+
+PetscErrorCode UMQualityView(UMQuality *qs, PetscViewer viewer, PetscBool csv) {
+    PetscErrorCode ierr;
+    PetscInt  b;
+    if (csv) {
+        ierr = PetscViewerASCIIPrintf(viewer,
+                   "N,K,min_angle,max_angle,mean_min_angle,max_aspect,mean_aspect,"
+                   "max_gradation,mean_gradation"); CHKERRQ(ierr);
+        for (b = 0; b < UM_ASPECT_BINS; b++) {
+            ierr = PetscViewerASCIIPrintf(viewer,",aspect_%d",b); CHKERRQ(ierr);
+        }
+        for (b = 0; b < UM_VALENCE_BINS; b++) {
+            ierr = PetscViewerASCIIPrintf(viewer,",valence_%d",b); CHKERRQ(ierr);
+        }
+        ierr = PetscViewerASCIIPrintf(viewer,"\n%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f",
+                   qs->Nglobal,qs->Kglobal,qs->minangle,qs->maxangle,
+                   qs->meanminangle,qs->maxaspect,qs->meanaspect,
+                   qs->maxgradation,qs->meangradation); CHKERRQ(ierr);
+        for (b = 0; b < UM_ASPECT_BINS; b++) {
+            ierr = PetscViewerASCIIPrintf(viewer,",%d",qs->aspect[b]); CHKERRQ(ierr);
+        }
+        for (b = 0; b < UM_VALENCE_BINS; b++) {
+            ierr = PetscViewerASCIIPrintf(viewer,",%d",qs->valence[b]); CHKERRQ(ierr);
+        }
+        ierr = PetscViewerASCIIPrintf(viewer,"\n"); CHKERRQ(ierr);
+        return 0;
+    }
+    ierr = PetscViewerASCIIPrintf(viewer,
+               "mesh quality for N=%d nodes, K=%d elements:\n",
+               qs->Nglobal,qs->Kglobal); CHKERRQ(ierr);
+    ierr = PetscViewerASCIIPrintf(viewer,
+               "  angles:        min %.2f, max %.2f, mean of element minimum %.2f (degrees)\n",
+               qs->minangle,qs->maxangle,qs->meanminangle); CHKERRQ(ierr);
+    ierr = PetscViewerASCIIPrintf(viewer,
+               "  aspect ratio:  max %.3f, mean %.3f\n",
+               qs->maxaspect,qs->meanaspect); CHKERRQ(ierr);
+    ierr = PetscViewerASCIIPrintf(viewer,"    [1,%g): %d",
+               aspectbinend[0],qs->aspect[0]); CHKERRQ(ierr);
+    for (b = 1; b < UM_ASPECT_BINS-1; b++) {
+        ierr = PetscViewerASCIIPrintf(viewer,",  [%g,%g): %d",
+                   aspectbinend[b-1],aspectbinend[b],qs->aspect[b]); CHKERRQ(ierr);
+    }
+    ierr = PetscViewerASCIIPrintf(viewer,",  >= %g: %d\n",
+               aspectbinend[UM_ASPECT_BINS-2],qs->aspect[UM_ASPECT_BINS-1]); CHKERRQ(ierr);
+    ierr = PetscViewerASCIIPrintf(viewer,
+               "  gradation:     max %.3f, mean %.3f\n",
+               qs->maxgradation,qs->meangradation); CHKERRQ(ierr);
+    ierr = PetscViewerASCIIPrintf(viewer,
+               "  valence:       min %d, max %d%s\n   ",qs->minvalence,qs->maxvalence,
+               (qs->maxvalence == UM_VALENCE_BINS-1) ? " or more" : ""); CHKERRQ(ierr);
+    for (b = PetscMax(qs->minvalence,0); b <= qs->maxvalence; b++) {
+        ierr = PetscViewerASCIIPrintf(viewer," %d: %d",b,qs->valence[b]); CHKERRQ(ierr);
+    }
+    ierr = PetscViewerASCIIPrintf(viewer,"\n"); CHKERRQ(ierr);
     return 0;
 }
 
@@ -311,3 +1493,734 @@ PetscErrorCode UMRestoreNodeCoordArrayRead(UM *mesh, const Node **xy) {
     return 0;
 }
 
+
+
+// distance along the Hilbert curve filling an n x n grid (n a power of two)
+//   of the integer point (x,y); see en.wikipedia.org/wiki/Hilbert_curve
+static PetscInt HilbertIndex(PetscInt n, PetscInt x, PetscInt y) {
+    PetscInt rx, ry, s, t, d = 0;
+    for (s = n/2; s > 0; s /= 2) {
+        rx = (x & s) > 0;
+        ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {   // rotate quadrant
+            if (rx == 1) {
+                x = n-1 - x;
+                y = n-1 - y;
+            }
+            t = x;  x = y;  y = t;
+        }
+    }
+    return d;
+}
+
+// perm[new] = old for nodes, by RCM on the node adjacency graph
+static PetscErrorCode UMOrderingRCM(UM *mesh, const PetscInt *ae, PetscInt *perm) {
+    PetscErrorCode ierr;
+    Mat            A;
+    IS             rperm, cperm;
+    const PetscInt *arperm;
+    PetscInt       *nnz, nen = mesh->nen, n, k;
+    PetscReal      v[36];
+    // as in PreallocateAndSetNonzeros(), 1 + incident triangles suffices
+    //   for interior nodes, and boundary nodes need one more; P2 nodes have
+    //   at most 4 more neighbors per incident triangle
+    ierr = PetscMalloc1(mesh->N,&nnz); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++)
+        nnz[n] = 2;
+    for (k = 0; k < nen*mesh->K; k++)
+        nnz[ae[k]] += nen - 2;
+    ierr = MatCreateSeqAIJ(PETSC_COMM_SELF,mesh->N,mesh->N,0,nnz,&A); CHKERRQ(ierr);
+    ierr = PetscFree(nnz); CHKERRQ(ierr);
+    for (k = 0; k < 36; k++)
+        v[k] = 0.0;
+    for (k = 0; k < mesh->K; k++) {
+        ierr = MatSetValues(A,nen,ae+nen*k,nen,ae+nen*k,v,INSERT_VALUES); CHKERRQ(ierr);
+    }
+    ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatGetOrdering(A,MATORDERINGRCM,&rperm,&cperm); CHKERRQ(ierr);
+    ierr = ISGetIndices(rperm,&arperm); CHKERRQ(ierr);
+    ierr = PetscArraycpy(perm,arperm,mesh->N); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(rperm,&arperm); CHKERRQ(ierr);
+    ISDestroy(&rperm);  ISDestroy(&cperm);  MatDestroy(&A);
+    return 0;
+}
+
+// perm[new] = old for nodes, by Hilbert index on a 2^15 x 2^15 grid
+//   covering the bounding box
+static PetscErrorCode UMOrderingHilbert(UM *mesh, const Node *aloc, PetscInt *perm) {
+    PetscErrorCode ierr;
+    const PetscInt M = 32768;
+    PetscInt       *key, n;
+    PetscReal      xmin = PETSC_MAX_REAL, xmax = -PETSC_MAX_REAL,
+                   ymin = PETSC_MAX_REAL, ymax = -PETSC_MAX_REAL, L;
+    for (n = 0; n < mesh->N; n++) {
+        xmin = PetscMin(xmin,aloc[n].x);  xmax = PetscMax(xmax,aloc[n].x);
+        ymin = PetscMin(ymin,aloc[n].y);  ymax = PetscMax(ymax,aloc[n].y);
+    }
+    L = PetscMax(xmax - xmin, ymax - ymin);
+    if (L <= 0.0)
+        L = 1.0;
+    ierr = PetscMalloc1(mesh->N,&key); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++) {
+        key[n] = HilbertIndex(M,
+                     PetscMin(M-1,(PetscInt)((M-1) * (aloc[n].x - xmin) / L)),
+                     PetscMin(M-1,(PetscInt)((M-1) * (aloc[n].y - ymin) / L)));
+        perm[n] = n;
+    }
+    ierr = PetscSortIntWithPermutation(mesh->N,key,perm); CHKERRQ(ierr);
+    ierr = PetscFree(key); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMReorder(UM *mesh, UMReorderType type) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *abf, *ans, *anat = NULL;
+    const Node     *aloc;
+    PetscInt       *perm, *iperm, *emin, *eperm, *newe, *newbf, *newns,
+                   *newnat, nen = mesh->nen, n, k, l;
+    Node           *newloc;
+    Vec            loc;
+
+    if (type == REORDER_NONE)
+        return 0;
+    if ((mesh->K == 0) || (mesh->e == NULL) || (mesh->bf == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,
+                "mesh not complete; call UMReadNodes() and UMReadISs() first\n");
+    }
+    if (mesh->ltog) {
+        SETERRQ(PETSC_COMM_SELF,2,"reorder before calling UMDistribute()\n");
+    }
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = PetscMalloc2(mesh->N,&perm,mesh->N,&iperm); CHKERRQ(ierr);
+    switch (type) {
+        case REORDER_RCM :
+            ierr = UMOrderingRCM(mesh,ae,perm); CHKERRQ(ierr);
+            break;
+        case REORDER_HILBERT :
+            ierr = UMOrderingHilbert(mesh,aloc,perm); CHKERRQ(ierr);
+            break;
+        default :
+            SETERRQ(PETSC_COMM_SELF,3,"unknown UMReorderType\n");
+    }
+    for (n = 0; n < mesh->N; n++)
+        iperm[perm[n]] = n;
+
+    // permute nodal fields
+    if (mesh->natural) {
+        ierr = ISGetIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    }
+    ierr = VecCreateSeq(PETSC_COMM_SELF,2*mesh->N,&loc); CHKERRQ(ierr);
+    ierr = VecGetArray(loc,(PetscReal **)&newloc); CHKERRQ(ierr);
+    ierr = PetscMalloc2(mesh->N,&newbf,mesh->N,&newnat); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++) {
+        newloc[n] = aloc[perm[n]];
+        newbf[n] = abf[perm[n]];
+        newnat[n] = (anat) ? anat[perm[n]] : perm[n];
+    }
+    ierr = VecRestoreArray(loc,(PetscReal **)&newloc); CHKERRQ(ierr);
+    if (anat) {
+        ierr = ISRestoreIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    }
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    // renumber element nodes, then sort elements by their lowest node
+    ierr = PetscMalloc3(mesh->K,&emin,mesh->K,&eperm,nen*mesh->K,&newe); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        emin[k] = iperm[ae[nen*k]];
+        for (l = 1; l < nen; l++)
+            emin[k] = PetscMin(emin[k],iperm[ae[nen*k+l]]);
+        eperm[k] = k;
+    }
+    ierr = PetscSortIntWithPermutation(mesh->K,emin,eperm); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++)
+        for (l = 0; l < nen; l++)
+            newe[nen*k+l] = iperm[ae[nen*eperm[k]+l]];
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // renumber Neumann segments
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        ierr = PetscMalloc1(mesh->nsn*mesh->P,&newns); CHKERRQ(ierr);
+        for (k = 0; k < mesh->nsn*mesh->P; k++)
+            newns[k] = iperm[ans[k]];
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->nsn*mesh->P,newns,PETSC_OWN_POINTER,&(mesh->ns)); CHKERRQ(ierr);
+    }
+
+    ierr = VecDestroy(&(mesh->loc)); CHKERRQ(ierr);
+    mesh->loc = loc;
+    ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,nen*mesh->K,newe,PETSC_COPY_VALUES,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->N,newbf,PETSC_COPY_VALUES,&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->natural)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,mesh->N,newnat,PETSC_COPY_VALUES,&(mesh->natural)); CHKERRQ(ierr);
+    ierr = PetscFree3(emin,eperm,newe); CHKERRQ(ierr);
+    ierr = PetscFree2(newbf,newnat); CHKERRQ(ierr);
+    ierr = PetscFree2(perm,iperm); CHKERRQ(ierr);
+    return 0;
+}
+
+
+// node-to-element incidence in CSR form:  elements which touch node n are
+//   nel[nptr[n]], ..., nel[nptr[n+1]-1]
+static PetscErrorCode UMNodeElementIncidence(UM *mesh, const PetscInt *ae,
+                                             PetscInt **nptr, PetscInt **nel) {
+    PetscErrorCode ierr;
+    PetscInt       nen = mesh->nen, n, k, l, *cnt;
+    ierr = PetscCalloc1(mesh->N+1,nptr); CHKERRQ(ierr);
+    for (k = 0; k < nen*mesh->K; k++)
+        (*nptr)[ae[k]+1]++;
+    for (n = 0; n < mesh->N; n++)
+        (*nptr)[n+1] += (*nptr)[n];
+    ierr = PetscMalloc1(nen*mesh->K,nel); CHKERRQ(ierr);
+    ierr = PetscCalloc1(mesh->N,&cnt); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        for (l = 0; l < nen; l++) {
+            n = ae[nen*k+l];
+            (*nel)[(*nptr)[n] + cnt[n]++] = k;
+        }
+    }
+    ierr = PetscFree(cnt); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Each process starts with the whole mesh.  The element dual graph (elements
+are adjacent if they share an edge) is built in row blocks and handed to
+MatPartitioning, so -mat_partitioning_type parmetis etc. apply.  A node is
+owned by the lowest-rank process among its incident elements.  Each process
+then keeps its owned elements, followed by every other element which touches
+one of its owned nodes, so that residual and matrix rows for owned nodes can
+be computed without any off-process contributions.                       */
+// local index of the node with global number g:  owned nodes come first in
+//   global order, then the ghosts, whose sorted global numbers are ghosts[];
+//   -1 if g is not local
+static PetscErrorCode UMGlobalToLocalIndex(PetscInt g, PetscInt gstart,
+        PetscInt Nown, PetscInt nghost, const PetscInt *ghosts, PetscInt *j) {
+    PetscErrorCode ierr;
+    if (g >= gstart && g < gstart + Nown) {
+        *j = g - gstart;
+    } else {
+        ierr = PetscFindInt(g,nghost,ghosts,j); CHKERRQ(ierr);
+        if (*j >= 0)
+            *j += Nown;
+    }
+    return 0;
+}
+
+PetscErrorCode UMDistribute(UM *mesh) {
+    PetscErrorCode ierr;
+    PetscMPIInt    rank, size;
+    const PetscInt *ae, *abf, *ans, *anat = NULL, *apart;
+    const Node     *aloc;
+    PetscInt       *part, *gnum, *rowners, *lnodes, *lelems, *le, *lbf, *lns,
+                   *lnat, *cand, *candn,
+                   nen = mesh->nen, nsn = mesh->nsn, n, k, l, m, j, r,
+                   kstart, kend, ncand, nghost, gstart, Nown, Nloc, Kown,
+                   Kloc, Ploc;
+    Node           *lloc;
+    Vec            gtmp, ltmp;
+    IS             is;
+
+    if ((mesh->K == 0) || (mesh->e == NULL) || (mesh->bf == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,
+                "mesh not complete; call UMReadNodes() and UMReadISs() first\n");
+    }
+    if (mesh->ltog) {
+        SETERRQ(PETSC_COMM_SELF,2,"mesh already distributed\n");
+    }
+    ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank); CHKERRQ(ierr);
+    ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    // partition elements; the node-element incidence is needed only to
+    //   build the element adjacency, and is freed right after
+    ierr = PetscCalloc1(mesh->K,&part); CHKERRQ(ierr);
+    if (size > 1) {
+        MatPartitioning  mpart;
+        Mat              adj;
+        PetscInt         *ia, *ja, *buf, *nptr, *nel, nnz = 0;
+        ierr = UMNodeElementIncidence(mesh,ae,&nptr,&nel); CHKERRQ(ierr);
+        kstart = (mesh->K * rank) / size;
+        kend = (mesh->K * (rank+1)) / size;
+        ierr = PetscMalloc1(kend-kstart+1,&ia); CHKERRQ(ierr);
+        ierr = PetscMalloc1(3*(kend-kstart),&ja); CHKERRQ(ierr);
+        ierr = PetscMalloc1(3*mesh->K,&buf); CHKERRQ(ierr);
+        ia[0] = 0;
+        for (k = kstart; k < kend; k++) {
+            // neighbors share two vertices, so appear twice in the merged
+            //   lists over vertices
+            ncand = 0;
+            for (l = 0; l < 3; l++) {
+                n = ae[nen*k+l];
+                for (j = nptr[n]; j < nptr[n+1]; j++)
+                    if (nel[j] != k)
+                        buf[ncand++] = nel[j];
+            }
+            ierr = PetscSortInt(ncand,buf); CHKERRQ(ierr);
+            for (j = 1; j < ncand; j++)
+                if ((buf[j] == buf[j-1]) && (nnz == ia[k-kstart] || ja[nnz-1] != buf[j]))
+                    ja[nnz++] = buf[j];
+            ia[k-kstart+1] = nnz;
+        }
+        ierr = PetscFree(buf); CHKERRQ(ierr);
+        ierr = PetscFree(nptr); CHKERRQ(ierr);
+        ierr = PetscFree(nel); CHKERRQ(ierr);
+        // adj takes ownership of ia, ja
+        ierr = MatCreateMPIAdj(PETSC_COMM_WORLD,kend-kstart,mesh->K,ia,ja,NULL,&adj); CHKERRQ(ierr);
+        ierr = MatPartitioningCreate(PETSC_COMM_WORLD,&mpart); CHKERRQ(ierr);
+        ierr = MatPartitioningSetAdjacency(mpart,adj); CHKERRQ(ierr);
+        ierr = MatPartitioningSetFromOptions(mpart); CHKERRQ(ierr);
+        ierr = MatPartitioningApply(mpart,&is); CHKERRQ(ierr);
+        ierr = MatPartitioningDestroy(&mpart); CHKERRQ(ierr);
+        ierr = MatDestroy(&adj); CHKERRQ(ierr);
+        {
+            IS  isall;
+            ierr = ISAllGather(is,&isall); CHKERRQ(ierr);
+            ierr = ISGetIndices(isall,&apart); CHKERRQ(ierr);
+            ierr = PetscArraycpy(part,apart,mesh->K); CHKERRQ(ierr);
+            ierr = ISRestoreIndices(isall,&apart); CHKERRQ(ierr);
+            ierr = ISDestroy(&isall); CHKERRQ(ierr);
+        }
+        ierr = ISDestroy(&is); CHKERRQ(ierr);
+    }
+
+    // node owners (lowest rank among its elements) and new global
+    //   numbering: contiguous blocks by rank, original order within each
+    //   block; gnum[] holds the owner until it is overwritten by the global
+    //   number, and afterwards the owner is rank iff gnum[n] is in
+    //   [gstart,gstart+Nown)
+    ierr = PetscMalloc1(mesh->N,&gnum); CHKERRQ(ierr);
+    ierr = PetscCalloc1(size+1,&rowners); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++)
+        gnum[n] = size;
+    for (k = 0; k < mesh->K; k++)
+        for (l = 0; l < nen; l++)
+            gnum[ae[nen*k+l]] = PetscMin(gnum[ae[nen*k+l]],part[k]);
+    for (n = 0; n < mesh->N; n++) {
+        if (gnum[n] == size)   // node in no element
+            gnum[n] = 0;
+        rowners[gnum[n]+1]++;
+    }
+    for (r = 0; r < size; r++)
+        rowners[r+1] += rowners[r];
+    for (n = 0; n < mesh->N; n++)
+        gnum[n] = rowners[gnum[n]]++;
+    for (r = size; r > 0; r--)      // restore rowners[r] = start of block r
+        rowners[r] = rowners[r-1];
+    rowners[0] = 0;
+    gstart = rowners[rank];
+    Nown = rowners[rank+1] - gstart;
+
+    // local elements: owned, then ghost elements touching an owned node;
+    //   count them first so that lelems[] has local size
+    Kown = 0;
+    Kloc = 0;
+    for (k = 0; k < mesh->K; k++) {
+        if (part[k] == rank) {
+            Kown++;
+            Kloc++;
+        } else {
+            for (l = 0; l < nen; l++) {
+                n = ae[nen*k+l];
+                if (gnum[n] >= gstart && gnum[n] < gstart + Nown) {
+                    Kloc++;
+                    break;
+                }
+            }
+        }
+    }
+    ierr = PetscMalloc1(Kloc,&lelems); CHKERRQ(ierr);
+    j = 0;
+    m = Kown;
+    for (k = 0; k < mesh->K; k++) {
+        if (part[k] == rank) {
+            lelems[j++] = k;
+        } else {
+            for (l = 0; l < nen; l++) {
+                n = ae[nen*k+l];
+                if (gnum[n] >= gstart && gnum[n] < gstart + Nown) {
+                    lelems[m++] = k;
+                    break;
+                }
+            }
+        }
+    }
+
+    // ghosts: sorted global numbers cand[0,...,nghost-1] of the not-owned
+    //   nodes of local elements, with their nodes in candn[]
+    ierr = PetscMalloc2(nen*Kloc,&cand,nen*Kloc,&candn); CHKERRQ(ierr);
+    ncand = 0;
+    for (j = 0; j < Kloc; j++) {
+        for (l = 0; l < nen; l++) {
+            n = ae[nen*lelems[j]+l];
+            if (gnum[n] < gstart || gnum[n] >= gstart + Nown) {
+                cand[ncand] = gnum[n];
+                candn[ncand++] = n;
+            }
+        }
+    }
+    ierr = PetscSortIntWithArray(ncand,cand,candn); CHKERRQ(ierr);
+    nghost = 0;
+    for (j = 0; j < ncand; j++) {
+        if (j == 0 || cand[j] != cand[j-1]) {
+            cand[nghost] = cand[j];
+            candn[nghost++] = candn[j];
+        }
+    }
+
+    // local nodes: owned in global order, then ghosts in global order
+    Nloc = Nown + nghost;
+    ierr = PetscMalloc1(Nloc,&lnodes); CHKERRQ(ierr);
+    j = 0;
+    for (n = 0; n < mesh->N; n++)
+        if (gnum[n] >= gstart && gnum[n] < gstart + Nown)
+            lnodes[j++] = n;
+    for (j = 0; j < nghost; j++)
+        lnodes[Nown+j] = candn[j];
+
+    // build local arrays
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    if (mesh->natural) {
+        ierr = ISGetIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    }
+    ierr = PetscMalloc4(Nloc,&lloc,nen*Kloc,&le,Nloc,&lbf,Nown,&lnat); CHKERRQ(ierr);
+    for (j = 0; j < Nloc; j++) {
+        n = lnodes[j];
+        lloc[j] = aloc[n];
+        lbf[j] = abf[n];
+        if (j < Nown)
+            lnat[j] = (anat) ? anat[n] : n;
+        lnodes[j] = gnum[n];   // reuse as local-to-global map
+    }
+    for (j = 0; j < Kloc; j++) {
+        for (l = 0; l < nen; l++) {
+            ierr = UMGlobalToLocalIndex(gnum[ae[nen*lelems[j]+l]],gstart,Nown,
+                                        nghost,cand,&(le[nen*j+l])); CHKERRQ(ierr);
+        }
+    }
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    if (anat) {
+        ierr = ISRestoreIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    }
+    // Neumann segments with an owned node; all its nodes are then local
+    Ploc = 0;
+    ierr = PetscMalloc1(nsn*mesh->P+1,&lns); CHKERRQ(ierr);
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        for (j = 0; j < mesh->P; j++) {
+            for (m = 0; m < nsn; m++) {
+                n = ans[nsn*j+m];
+                if (gnum[n] >= gstart && gnum[n] < gstart + Nown)
+                    break;
+            }
+            if (m < nsn) {
+                for (m = 0; m < nsn; m++) {
+                    ierr = UMGlobalToLocalIndex(gnum[ans[nsn*j+m]],gstart,Nown,
+                               nghost,cand,&(lns[nsn*Ploc+m])); CHKERRQ(ierr);
+                }
+                Ploc++;
+            }
+        }
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+    ierr = PetscFree2(cand,candn); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // replace the whole-mesh objects by local ones
+    ierr = VecDestroy(&(mesh->loc)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->bf)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->ns)); CHKERRQ(ierr);
+    ierr = ISDestroy(&(mesh->natural)); CHKERRQ(ierr);
+    mesh->Nglobal = mesh->N;
+    mesh->Kglobal = mesh->K;
+    mesh->N = Nloc;
+    mesh->Nown = Nown;
+    mesh->K = Kloc;
+    mesh->Kown = Kown;
+    mesh->P = Ploc;
+    ierr = VecCreateSeq(PETSC_COMM_SELF,2*Nloc,&(mesh->loc)); CHKERRQ(ierr);
+    {
+        PetscReal *aa;
+        ierr = VecGetArray(mesh->loc,&aa); CHKERRQ(ierr);
+        ierr = PetscArraycpy(aa,(PetscReal*)lloc,2*Nloc); CHKERRQ(ierr);
+        ierr = VecRestoreArray(mesh->loc,&aa); CHKERRQ(ierr);
+    }
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,nen*Kloc,le,PETSC_COPY_VALUES,&(mesh->e)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,Nloc,lbf,PETSC_COPY_VALUES,&(mesh->bf)); CHKERRQ(ierr);
+    if (Ploc > 0) {
+        ierr = ISCreateGeneral(PETSC_COMM_SELF,nsn*Ploc,lns,PETSC_COPY_VALUES,&(mesh->ns)); CHKERRQ(ierr);
+    }
+    // global indices of the natural ordering
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,Nown,lnat,PETSC_COPY_VALUES,&(mesh->natural)); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingCreate(PETSC_COMM_SELF,1,Nloc,lnodes,PETSC_COPY_VALUES,&(mesh->ltog)); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_SELF,Nloc,lnodes,PETSC_COPY_VALUES,&is); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(mesh,&gtmp); CHKERRQ(ierr);
+    ierr = UMCreateLocalVec(mesh,&ltmp); CHKERRQ(ierr);
+    ierr = VecScatterCreate(gtmp,is,ltmp,NULL,&(mesh->gtol)); CHKERRQ(ierr);
+    VecDestroy(&gtmp);  VecDestroy(&ltmp);  ISDestroy(&is);
+
+    ierr = PetscFree4(lloc,le,lbf,lnat); CHKERRQ(ierr);
+    ierr = PetscFree(lns); CHKERRQ(ierr);
+    ierr = PetscFree(lnodes); CHKERRQ(ierr);
+    ierr = PetscFree(lelems); CHKERRQ(ierr);
+    ierr = PetscFree(gnum); CHKERRQ(ierr);
+    ierr = PetscFree(rowners); CHKERRQ(ierr);
+    ierr = PetscFree(part); CHKERRQ(ierr);
+
+    ierr = UMCheckElements(mesh); CHKERRQ(ierr);
+    ierr = UMCheckBoundaryData(mesh); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMCreateGlobalVec(UM *mesh, Vec *g) {
+    PetscErrorCode ierr;
+    ierr = VecCreate(PETSC_COMM_WORLD,g); CHKERRQ(ierr);
+    ierr = VecSetSizes(*g,mesh->Nown,mesh->Nglobal); CHKERRQ(ierr);
+    ierr = VecSetFromOptions(*g); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMCreateLocalVec(UM *mesh, Vec *loc) {
+    PetscErrorCode ierr;
+    ierr = VecCreateSeq(PETSC_COMM_SELF,mesh->N,loc); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMGlobalToLocal(UM *mesh, Vec g, Vec loc) {
+    PetscErrorCode ierr;
+    if (!mesh->gtol) {
+        SETERRQ(PETSC_COMM_SELF,1,"scatter not created; call UMDistribute() first\n");
+    }
+    ierr = VecScatterBegin(mesh->gtol,g,loc,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = VecScatterEnd(mesh->gtol,g,loc,INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMSetUpGeometry(UM *mesh, PetscInt nq,
+                               const PetscReal *xi, const PetscReal *eta) {
+    PetscErrorCode ierr;
+    const PetscInt *ae, *en;
+    const Node     *aloc;
+    const PetscReal dchi[3][2] = {{-1.0,-1.0},{ 1.0, 0.0},{ 0.0, 1.0}};
+    PetscInt       K = mesh->K, k, l, r;
+    PetscReal      dx1, dx2, dy1, dy2, detJ;
+
+    if ((mesh->K == 0) || (mesh->e == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"no elements; call UMReadISs() first\n");
+    }
+    ierr = PetscFree5(mesh->absdetJ,mesh->gpx,mesh->gpy,mesh->xq,mesh->yq); CHKERRQ(ierr);
+    ierr = PetscMalloc5(K,&(mesh->absdetJ),3*K,&(mesh->gpx),3*K,&(mesh->gpy),
+                        nq*K,&(mesh->xq),nq*K,&(mesh->yq)); CHKERRQ(ierr);
+    mesh->nq = nq;
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        en = ae + mesh->nen*k;  // vertices are first
+        dx1 = aloc[en[1]].x - aloc[en[0]].x;
+        dx2 = aloc[en[2]].x - aloc[en[0]].x;
+        dy1 = aloc[en[1]].y - aloc[en[0]].y;
+        dy2 = aloc[en[2]].y - aloc[en[0]].y;
+        detJ = dx1 * dy2 - dx2 * dy1;
+        mesh->absdetJ[k] = PetscAbsReal(detJ);
+        for (l = 0; l < 3; l++) {
+            mesh->gpx[l*K+k] = ( dy2 * dchi[l][0] - dy1 * dchi[l][1]) / detJ;
+            mesh->gpy[l*K+k] = (-dx2 * dchi[l][0] + dx1 * dchi[l][1]) / detJ;
+        }
+        for (r = 0; r < nq; r++) {
+            mesh->xq[r*K+k] = aloc[en[0]].x + dx1 * xi[r] + dx2 * eta[r];
+            mesh->yq[r*K+k] = aloc[en[0]].y + dy1 * xi[r] + dy2 * eta[r];
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Greedy coloring in element order: element k gets the lowest color not
+used by an already-colored element sharing a node with it.  Elements which
+share a node number at most nen*(maxdeg-1) where maxdeg is the largest number
+of elements incident on a node, so at most nen*maxdeg-2 colors are used.
+Within each color the elements stay in increasing order.               */
+PetscErrorCode UMColorElements(UM *mesh) {
+    PetscErrorCode ierr;
+    const PetscInt *ae;
+    PetscInt       *nptr, *nel, *color, *mark, *cnt, maxdeg = 0, n, k, kk,
+                   l, j, c;
+
+    if ((mesh->K == 0) || (mesh->e == NULL)) {
+        SETERRQ(PETSC_COMM_SELF,1,"no elements; call UMReadISs() first\n");
+    }
+    ierr = PetscFree(mesh->colorptr); CHKERRQ(ierr);
+    ierr = PetscFree(mesh->colorel); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = UMNodeElementIncidence(mesh,ae,&nptr,&nel); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++)
+        maxdeg = PetscMax(maxdeg,nptr[n+1]-nptr[n]);
+    ierr = PetscMalloc2(mesh->K,&color,mesh->nen*maxdeg,&mark); CHKERRQ(ierr);
+    for (c = 0; c < mesh->nen*maxdeg; c++)
+        mark[c] = -1;
+    mesh->ncolors = 0;
+    for (k = 0; k < mesh->K; k++) {
+        for (l = 0; l < mesh->nen; l++) {
+            n = ae[mesh->nen*k+l];
+            for (j = nptr[n]; j < nptr[n+1]; j++) {
+                kk = nel[j];
+                if (kk < k)
+                    mark[color[kk]] = k;
+            }
+        }
+        c = 0;
+        while (mark[c] == k)
+            c++;
+        color[k] = c;
+        mesh->ncolors = PetscMax(mesh->ncolors,c+1);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = PetscFree(nptr); CHKERRQ(ierr);
+    ierr = PetscFree(nel); CHKERRQ(ierr);
+
+    // sort elements by color, stably
+    ierr = PetscCalloc1(mesh->ncolors+1,&(mesh->colorptr)); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->K,&(mesh->colorel)); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++)
+        mesh->colorptr[color[k]+1]++;
+    for (c = 0; c < mesh->ncolors; c++)
+        mesh->colorptr[c+1] += mesh->colorptr[c];
+    ierr = PetscCalloc1(mesh->ncolors,&cnt); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        c = color[k];
+        mesh->colorel[mesh->colorptr[c] + cnt[c]++] = k;
+    }
+    ierr = PetscFree(cnt); CHKERRQ(ierr);
+    ierr = PetscFree2(color,mark); CHKERRQ(ierr);
+    return 0;
+}
+
+// first global index of the owned nodes, which are numbered contiguously
+static PetscErrorCode UMOwnershipStart(UM *mesh, PetscInt *rstart) {
+    PetscErrorCode ierr;
+    PetscInt       rend;
+    ierr = MPI_Scan(&(mesh->Nown),&rend,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    *rstart = rend - mesh->Nown;
+    return 0;
+}
+
+// application ordering between natural (mesh-file) and global node indices;
+//   AOCreateBasicIS() takes its communicator from the first IS, and
+//   mesh->natural is on PETSC_COMM_SELF, so the owned natural indices are
+//   copied into an IS on PETSC_COMM_WORLD
+static PetscErrorCode UMCreateAO(UM *mesh, AO *ao) {
+    PetscErrorCode ierr;
+    const PetscInt *anat;
+    PetscInt       rstart;
+    IS             isnatural, isglobal;
+    if (!mesh->ltog || !mesh->natural) {
+        SETERRQ(PETSC_COMM_SELF,1,"call UMDistribute() first\n");
+    }
+    ierr = ISGetIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,mesh->Nown,anat,PETSC_COPY_VALUES,&isnatural); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->natural,&anat); CHKERRQ(ierr);
+    ierr = UMOwnershipStart(mesh,&rstart); CHKERRQ(ierr);
+    ierr = ISCreateStride(PETSC_COMM_WORLD,mesh->Nown,rstart,1,&isglobal); CHKERRQ(ierr);
+    ierr = AOCreateBasicIS(isnatural,isglobal,ao); CHKERRQ(ierr);
+    ierr = ISDestroy(&isnatural); CHKERRQ(ierr);
+    ierr = ISDestroy(&isglobal); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Row i of the interpolation, for an owned fine node which is not Dirichlet,
+has weight 1/2 for each of its two parents in the coarse mesh, so weight 1 if
+it is a coarse node.  Parents are neighbors of node i in the fine mesh, thus
+local (owned or ghost), so their boundary flags are at hand.             */
+PetscErrorCode UMCreateInterpolation(UM *coarse, UM *fine, Mat *P) {
+    PetscErrorCode ierr;
+    const PetscInt *anat, *apar, *abf;
+    PetscInt       *pc, *pf, i, s, row, rstart;
+    AO             aoc, aof;
+
+    if (!fine->parent) {
+        SETERRQ(PETSC_COMM_SELF,1,"fine mesh must come from UMRefineUniform()\n");
+    }
+    ierr = ISGetIndices(fine->natural,&anat); CHKERRQ(ierr);
+    ierr = ISGetIndices(fine->parent,&apar); CHKERRQ(ierr);
+    ierr = PetscMalloc2(2*fine->Nown,&pc,2*fine->Nown,&pf); CHKERRQ(ierr);
+    for (i = 0; i < fine->Nown; i++) {
+        for (s = 0; s < 2; s++) {
+            pc[2*i+s] = apar[2*anat[i]+s];  // natural; same index in both meshes
+            pf[2*i+s] = pc[2*i+s];
+        }
+    }
+    ierr = ISRestoreIndices(fine->parent,&apar); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(fine->natural,&anat); CHKERRQ(ierr);
+    // parents as coarse global indices, and as fine local indices
+    ierr = UMCreateAO(coarse,&aoc); CHKERRQ(ierr);
+    ierr = AOApplicationToPetsc(aoc,2*fine->Nown,pc); CHKERRQ(ierr);
+    ierr = AODestroy(&aoc); CHKERRQ(ierr);
+    ierr = UMCreateAO(fine,&aof); CHKERRQ(ierr);
+    ierr = AOApplicationToPetsc(aof,2*fine->Nown,pf); CHKERRQ(ierr);
+    ierr = AODestroy(&aof); CHKERRQ(ierr);
+    ierr = ISGlobalToLocalMappingApply(fine->ltog,IS_GTOLM_MASK,2*fine->Nown,pf,NULL,pf); CHKERRQ(ierr);
+
+    ierr = MatCreate(PETSC_COMM_WORLD,P); CHKERRQ(ierr);
+    ierr = MatSetSizes(*P,fine->Nown,coarse->Nown,fine->Nglobal,coarse->Nglobal); CHKERRQ(ierr);
+    ierr = MatSetType(*P,MATAIJ); CHKERRQ(ierr);
+    ierr = MatSeqAIJSetPreallocation(*P,2,NULL); CHKERRQ(ierr);
+    ierr = MatMPIAIJSetPreallocation(*P,2,NULL,2,NULL); CHKERRQ(ierr);
+    ierr = MatGetOwnershipRange(*P,&rstart,NULL); CHKERRQ(ierr);
+    ierr = ISGetIndices(fine->bf,&abf); CHKERRQ(ierr);
+    for (i = 0; i < fine->Nown; i++) {
+        if (abf[i] == 2)
+            continue;
+        row = rstart + i;
+        for (s = 0; s < 2; s++) {
+            if (pf[2*i+s] < 0) {
+                SETERRQ(PETSC_COMM_SELF,2,"parent node not local; meshes not nested?\n");
+            }
+            if (abf[pf[2*i+s]] != 2) {
+                ierr = MatSetValue(*P,row,pc[2*i+s],0.5,ADD_VALUES); CHKERRQ(ierr);
+            }
+        }
+    }
+    ierr = ISRestoreIndices(fine->bf,&abf); CHKERRQ(ierr);
+    ierr = MatAssemblyBegin(*P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(*P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = PetscFree2(pc,pf); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode UMCreateInjection(UM *coarse, UM *fine, VecScatter *inject) {
+    PetscErrorCode ierr;
+    const PetscInt *anat;
+    PetscInt       *idx, j, rstart;
+    AO             aof;
+    IS             isfine, iscoarse;
+    Vec            vf, vc;
+
+    // coarse node with natural index c is fine node with natural index c
+    ierr = ISGetIndices(coarse->natural,&anat); CHKERRQ(ierr);
+    ierr = PetscMalloc1(coarse->Nown,&idx); CHKERRQ(ierr);
+    for (j = 0; j < coarse->Nown; j++)
+        idx[j] = anat[j];
+    ierr = ISRestoreIndices(coarse->natural,&anat); CHKERRQ(ierr);
+    ierr = UMCreateAO(fine,&aof); CHKERRQ(ierr);
+    ierr = AOApplicationToPetsc(aof,coarse->Nown,idx); CHKERRQ(ierr);
+    ierr = AODestroy(&aof); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,coarse->Nown,idx,PETSC_OWN_POINTER,&isfine); CHKERRQ(ierr);
+    ierr = UMOwnershipStart(coarse,&rstart); CHKERRQ(ierr);
+    ierr = ISCreateStride(PETSC_COMM_WORLD,coarse->Nown,rstart,1,&iscoarse); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(fine,&vf); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(coarse,&vc); CHKERRQ(ierr);
+    ierr = VecScatterCreate(vf,isfine,vc,iscoarse,inject); CHKERRQ(ierr);
+    VecDestroy(&vf);  VecDestroy(&vc);  ISDestroy(&isfine);  ISDestroy(&iscoarse);
+    return 0;
+}
@@ -9,22 +9,85 @@ typedef struct {
 
 // data type for an Unstructured Mesh
 typedef struct {
-    PetscInt N,     // number of nodes
-             K,     // number of elements
+    PetscInt N,     // number of nodes; after UMDistribute() these are the
+                    //     nodes on this process, owned first then ghosts
+             K,     // number of elements; after UMDistribute() these are
+                    //     the elements on this process, owned first then
+                    //     the ghost elements which touch an owned node
              P;     // number of Neumann boundary segments; may be 0
     Vec      loc;   // nodal locations; length N, dof=2 Vec
-    IS       e,     // element triples; length 3K
-                    //     values e[3*k+0],e[3*k+1],e[3*k+2]
-                    //     are indices into node-based Vecs
+    PetscInt nen,   // nodes per element: 3, or 6 after UMElevateP2()
+             nsn;   // nodes per Neumann segment: 2, or 3 after UMElevateP2()
+    IS       e,     // element triples; length nen*K
+                    //     values e[nen*k+0],e[nen*k+1],e[nen*k+2]
+                    //     are indices into node-based Vecs; if nen == 6
+                    //     then e[nen*k+3+l] is the midpoint of the edge
+                    //     from e[nen*k+l] to e[nen*k+(l+1)%3]
              bf,    // flag for boundary nodes; length N
                     //     if bf[i] > 0  then node i is on boundary
                     //     if bf[i] == 2 then node i is Dirichlet
-             ns;    // Neumann boundary segment pairs; length 2P;
-                    //     may be a null ptr; values s[2*p+0],s[2*p+1]
-                    //     are indices into node-based Vecs
+             ns;    // Neumann boundary segment pairs; length nsn*P;
+                    //     may be a null ptr; values s[nsn*p+0],s[nsn*p+1]
+                    //     are indices into node-based Vecs; if nsn == 3
+                    //     then s[nsn*p+2] is the midpoint
+    // parallel layout; before UMDistribute() the process holds the whole
+    //     mesh and Nown = Nglobal = N, Kown = Kglobal = K
+    PetscInt Nown,     // number of owned nodes (local indices 0,...,Nown-1)
+             Kown,     // number of owned elements (local 0,...,Kown-1)
+             Nglobal,  // number of nodes on all processes
+             Kglobal;  // number of elements on all processes
+    ISLocalToGlobalMapping ltog;  // local node index to global index
+    VecScatter gtol;   // global (owned) Vec to local (owned+ghost) Vec
+    IS       natural;  // index in the mesh files of each owned node; may be
+                       //     a null ptr if the numbering is unchanged
+    // element geometry cache from UMSetUpGeometry(); arrays are indexed
+    //     structure-of-arrays style over the K local elements
+    PetscInt  nq;      // quadrature points per element; 0 if no cache
+    PetscReal *absdetJ,  // |det J| of element k at absdetJ[k]; length K
+              *gpx,    // gradient of hat function for local node l on
+              *gpy,    //     element k is (gpx[l*K+k],gpy[l*K+k]); length 3K
+              *xq,     // coordinates of quadrature point r on element k
+              *yq;     //     are (xq[r*K+k],yq[r*K+k]); length nq*K
+    // element coloring from UMColorElements(); elements of color c, which
+    //     share no node, are colorel[colorptr[c]],...,colorel[colorptr[c+1]-1]
+    PetscInt  ncolors, // 0 if no coloring
+              *colorptr,  // length ncolors+1
+              *colorel;   // length K
+    // from UMRefineUniform() or UMElevateP2(); node i of this mesh is the
+    //     midpoint of coarse nodes parent[2*i+0], parent[2*i+1] (equal if
+    //     node i is a coarse node); length 2N; uses the numbering before
+    //     UMReorder() and UMDistribute() on either mesh, i.e. natural
+    //     numbering
+    IS        parent;
+    // file mapping from UMReadPacked(); Vec loc and ISs e,bf,ns as read
+    //     point into it
+    void      *map;
+    size_t    maplen;
 } UM;
 //ENDSTRUCT
 
+// node orderings for UMReorder()
+typedef enum {REORDER_NONE, REORDER_RCM, REORDER_HILBERT} UMReorderType;
+
+// mesh quality statistics from UMQualityStats(); angles are in degrees;
+//   aspect[b] counts elements with aspect ratio in bin b, with bins [1,1.5),
+//   [1.5,2), [2,3), [3,5), [5,10), and [10,infinity); valence[v] counts
+//   vertices with v neighboring vertices, with the last bin also counting
+//   larger valences; the gradation at a vertex is the ratio of the largest
+//   to the smallest diameter of the elements touching it
+#define UM_ASPECT_BINS  6
+#define UM_VALENCE_BINS 13
+typedef struct {
+    PetscInt  Nglobal, Kglobal;
+    PetscReal minangle, maxangle,
+              meanminangle,     // mean over elements of smallest angle
+              maxaspect, meanaspect,
+              maxgradation, meangradation;
+    PetscInt  aspect[UM_ASPECT_BINS],
+              valence[UM_VALENCE_BINS],
+              minvalence, maxvalence;
+} UMQuality;
+
 // methods below are listed in typical call order
 
 //STARTDECLARE
@@ -38,15 +101,110 @@ PetscErrorCode UMReadNodes(UM *mesh, char *filename);
 //   and boundary flags into them; call UMReadNodes() first
 PetscErrorCode UMReadISs(UM *mesh, char *filename);
 
+// alternative to UMReadNodes() and UMReadISs():  memory-map a single packed
+//   file written by "msh2petsc.py --packed" and wrap its arrays, without
+//   copying, as loc, e, bf, ns; see um.c for the format
+PetscErrorCode UMReadPacked(UM *mesh, char *filename);
+
+// alternative to UMReadNodes() and UMReadISs():  read an ASCII Gmsh .msh
+//   file, format 4.1 or 2.2, in one pass; Dirichlet and Neumann boundary
+//   parts are the physical groups named "dirichlet" and "neumann"
+PetscErrorCode UMReadGmsh(UM *mesh, char *filename);
+
+// uniform refinement:  split each triangle into four by connecting edge
+//   midpoints; the coarse nodes keep their indices and the midpoints follow;
+//   boundary flags and Neumann segments are inherited; fine must be freshly
+//   initialized; call before UMReorder() and UMDistribute() on coarse
+PetscErrorCode UMRefineUniform(UM *coarse, UM *fine);
+
+// P2 elements:  add a node at each edge midpoint, numbered after the P1
+//   nodes exactly as in UMRefineUniform(), and list the three midpoints of
+//   each element after its vertices (nen = 6) and the midpoint of each
+//   Neumann segment after its ends (nsn = 3); p2 must be freshly
+//   initialized; call before UMReorder() and UMDistribute() on p1
+PetscErrorCode UMElevateP2(UM *p1, UM *p2);
+
+// local refinement by newest vertex bisection:  the refinement edge of
+//   element k is e[3k+0],e[3k+1], and each child lists its vertices so
+//   that its refinement edge is opposite the new vertex; each element with
+//   marked[k] true is split into four, and neighbors are bisected as needed
+//   for a conforming mesh; coarse nodes keep their indices and midpoints
+//   follow; the coarse mesh must be P1 and whole on this process (e.g. in
+//   serial, also after UMDistribute()); fine must be freshly initialized
+PetscErrorCode UMRefineMarked(UM *coarse, const PetscBool *marked, UM *fine);
+
+// for the edge from e[3k+l] to e[3k+(l+1)%3], nbr[3k+l] is the slot 3k'+l'
+//   of the same edge in the neighboring element k', or -1 on the boundary,
+//   or -2-p if the edge is Neumann segment p; P1 only; on a distributed
+//   mesh the outer edges of ghost elements look like boundary edges;
+//   allocates nbr, of length 3K, which the caller frees
+PetscErrorCode UMEdgeNeighbors(UM *mesh, PetscInt **nbr);
+
+// renumber nodes by reverse Cuthill-McKee (on the node adjacency graph) or
+//   by position along a Hilbert curve, then sort elements by their lowest
+//   node; permutes loc, e, bf, ns consistently and records the mesh-file
+//   ordering in natural; call after UMReadISs() and before UMDistribute()
+PetscErrorCode UMReorder(UM *mesh, UMReorderType type);
+
+// partition elements (via MatPartitioning on the element dual graph) and
+//   keep only the owned elements plus the ghost elements touching owned
+//   nodes; nodes are renumbered so each process owns a contiguous block;
+//   call after UMReadISs() and before creating Vecs or Mats
+// NOTE: the set-up is replicated, not distributed; every process must hold
+//   the whole (refined) mesh on entry, and UMDistribute() keeps two work
+//   arrays of global size on every process, the gathered element partition
+//   and the global node numbering, plus the node-element incidence while
+//   partitioning on more than one process; the other work arrays, and the
+//   arrays kept afterwards, are O(N + K) for the local mesh
+PetscErrorCode UMDistribute(UM *mesh);
+
+// create a global Vec (owned nodes) or a local Vec (owned and ghost nodes);
+//   call UMDistribute() first
+PetscErrorCode UMCreateGlobalVec(UM *mesh, Vec *g);
+PetscErrorCode UMCreateLocalVec(UM *mesh, Vec *loc);
+
+// fill the local Vec, including ghost nodes, from the global Vec
+PetscErrorCode UMGlobalToLocal(UM *mesh, Vec g, Vec loc);
+
+// compute and store the element geometry (|det J|, hat function gradients,
+//   and physical coordinates of the nq quadrature points with reference
+//   coordinates xi[r],eta[r]) for all local elements; call after
+//   UMDistribute(); calling again replaces the cache
+PetscErrorCode UMSetUpGeometry(UM *mesh, PetscInt nq,
+                               const PetscReal *xi, const PetscReal *eta);
+
+// greedy coloring of the local elements so that no two elements of the
+//   same color share a node; call after UMDistribute()
+PetscErrorCode UMColorElements(UM *mesh);
+
+// transfers between a uniformly refined pair (fine from UMRefineUniform()
+//   on coarse), after UMDistribute() on both:  the P1 interpolation Mat from
+//   coarse to fine global Vecs, with zero rows for Dirichlet fine nodes and
+//   zero columns for Dirichlet coarse nodes, and the injection scatter from
+//   fine to coarse global Vecs (coarse nodes are also fine nodes)
+PetscErrorCode UMCreateInterpolation(UM *coarse, UM *fine, Mat *P);
+PetscErrorCode UMCreateInjection(UM *coarse, UM *fine, VecScatter *inject);
+
 // view all fields in UM to the viewer
 PetscErrorCode UMViewASCII(UM *mesh, PetscViewer viewer);
 PetscErrorCode UMViewSolutionBinary(UM *mesh, char *filename, Vec u);
 
+// write mesh (nodes, elements, boundary flags) and solution u in one VTK
+//   XML file root.vtu, with raw binary data, for ParaView or VisIt; in
+//   parallel write one piece root_r.vtu per process plus root.pvtu; u is a
+//   global Vec and the mesh must be distributed
+PetscErrorCode UMViewSolutionVTU(UM *mesh, const char *root, Vec u);
+
 // compute statistics for mesh:  maxh,meanh are for triangle side
-//   lengths; maxa,meana are for areas
+//   lengths; maxa,meana are for areas; over owned elements on all processes
 PetscErrorCode UMStats(UM *mesh, PetscReal *maxh, PetscReal *meanh,
                        PetscReal *maxa, PetscReal *meana);
 
+// compute quality statistics over all processes, using up to threads (>= 1) OpenMP
+//   threads; view them as text, or as a CSV header line plus a data line
+PetscErrorCode UMQualityStats(UM *mesh, PetscInt threads, UMQuality *qs);
+PetscErrorCode UMQualityView(UMQuality *qs, PetscViewer viewer, PetscBool csv);
+
 // access to a length-N array of structs for nodal coordinates
 PetscErrorCode UMGetNodeCoordArrayRead(UM *mesh, const Node **xy);
 PetscErrorCode UMRestoreNodeCoordArrayRead(UM *mesh, const Node **xy);
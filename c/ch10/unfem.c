@@ -14,16 +14,56 @@ static char help[] =
 #include "cases.h"
 
 //STARTCTX
-typedef struct {
+typedef struct _unfemCtx {
     UM        *mesh;
+    Vec       uloc;     // local (owned+ghost) copy of iterate
+    PetscReal *acoef;   // integral of a(u,x,y) over each local element
+    PetscReal *gD;      // g_D at each local node; zero at non-Dirichlet nodes
+    PetscBool matfree;  // Picard matrix is a MATSHELL; see PicardMult()
+    PetscBool batch;    // batched element kernels; see FormFunctionBatch()
+    PetscBool sbaij;    // Picard matrix stores upper triangle; see CreatePicardMatrix()
+    // element-to-nonzero map for an AIJ Picard matrix (-un_reuse); see
+    //   SetUpElementToNonzero()
+    PetscInt  *e2nz,    // value-array position of entry (l,m) of element k
+              *diagnz,  // value-array position of diagonal entry of owned node;
+                        //   -1 if the node is not a row
+              nzdiag,   // number of nonzeros in diagonal block
+              nzoff;    //   ... and in off-diagonal block (parallel only)
     PetscInt  solncase,
-              quaddegree;
+              quaddegree,
+              threads;
     PetscReal (*a_fcn)(PetscReal, PetscReal, PetscReal);
     PetscReal (*f_fcn)(PetscReal, PetscReal, PetscReal);
+    PetscReal (*dadu_fcn)(PetscReal, PetscReal, PetscReal);
+    PetscReal (*dfdu_fcn)(PetscReal, PetscReal, PetscReal);
     PetscReal (*gD_fcn)(PetscReal, PetscReal);
     PetscReal (*gN_fcn)(PetscReal, PetscReal);
     PetscReal (*uexact_fcn)(PetscReal, PetscReal);
-    PetscLogStage readstage, setupstage, solverstage, resstage, jacstage;  //STRIP
+    // batched a(), f() for FormFunctionBatch(); see cases.h
+    void (*a_batch)(PetscInt, const PetscReal*, const PetscReal*,
+                    const PetscReal*, PetscReal*);
+    void (*f_batch)(PetscInt, const PetscReal*, const PetscReal*,
+                    const PetscReal*, PetscReal*);
+    // geometric multigrid (-un_mg); the coarser levels l=0,...,mglevels-2
+    //   each have a ctx (for mesh, uloc, acoef, gD), a Picard matrix, an
+    //   iterate, and an injection from level l+1
+    PetscInt  mglevels;
+    struct _unfemCtx *mgctx;
+    Mat        *mgA;
+    Vec        *mgu;
+    VecScatter *mginject;
+    // Dirichlet elimination (-un_eliminate_dirichlet); SNES sees only the
+    //   owned free (non-Dirichlet) nodes in isfree, the residual function
+    //   below is applied to ufull, which holds g_D at the Dirichlet nodes,
+    //   and the Jacobian is assembled through freeltog, which maps local
+    //   nodes to the global free numbering, and Dirichlet nodes to -1
+    IS         isfree;
+    VecScatter free2full;
+    Vec        ufull, Ffull;
+    ISLocalToGlobalMapping freeltog;
+    PetscErrorCode (*fullfunction)(SNES, Vec, Vec, void*);
+    PetscErrorCode (*fulljacobian)(SNES, Vec, Mat, Mat, void*);
+    PetscLogStage readstage, adaptstage, setupstage, solverstage, resstage, jacstage;  //STRIP
 } unfemCtx;
 //ENDCTX
 
@@ -45,40 +85,99 @@ PetscReal eval(const PetscReal v[3], PetscReal xi, PetscReal eta) {
 }
 //ENDFEM
 
+// P2 basis on the reference element:  vertex nodes L=0,1,2 then the edge
+//   midpoint nodes L=3,4,5, where node L is the midpoint of the edge from
+//   vertex L-3 to vertex (L-2)%3, in terms of the P1 basis z[] = chi()
+PetscReal chi2(PetscInt L, PetscReal xi, PetscReal eta) {
+    const PetscReal z[3] = {1.0 - xi - eta, xi, eta};
+    if (L < 3)
+        return z[L] * (2.0 * z[L] - 1.0);
+    else
+        return 4.0 * z[L-3] * z[(L-2)%3];
+}
+
+// coefficients c[] so that grad chi2(L) = sum_i c[i] grad chi(i); the
+//   gradients of chi() are the same as for P1, and are cached in UM
+void dchi2(PetscInt L, PetscReal xi, PetscReal eta, PetscReal c[3]) {
+    const PetscReal z[3] = {1.0 - xi - eta, xi, eta};
+    c[0] = 0.0;  c[1] = 0.0;  c[2] = 0.0;
+    if (L < 3) {
+        c[L] = 4.0 * z[L] - 1.0;
+    } else {
+        c[L-3] = 4.0 * z[(L-2)%3];
+        c[(L-2)%3] = 4.0 * z[L-3];
+    }
+}
+
+typedef enum {JACOBIAN_PICARD, JACOBIAN_NEWTON} JacobianType;
+static const char* JacobianTypes[] = {"picard","newton",
+                                      "JacobianType", "", NULL};
+
+static const char* UMReorderTypes[] = {"none","rcm","hilbert",
+                                       "UMReorderType", "", NULL};
+
 extern PetscErrorCode FillExact(Vec, unfemCtx*);
+extern PetscErrorCode SetUpDirichlet(unfemCtx*);
 extern PetscErrorCode FormFunction(SNES, Vec, Vec, void*);
+extern PetscErrorCode FormFunctionP2(SNES, Vec, Vec, void*);
+extern PetscErrorCode FormFunctionBatch(SNES, Vec, Vec, void*);
+extern PetscErrorCode BenchResidual(unfemCtx*, Vec, Vec, PetscInt);
 extern PetscErrorCode FormPicard(SNES, Vec, Mat, Mat, void*);
-extern PetscErrorCode PreallocateAndSetNonzeros(Mat, unfemCtx*);
+extern PetscErrorCode FormNewtonJacobian(SNES, Vec, Mat, Mat, void*);
+extern PetscErrorCode PicardMult(Mat, Vec, Vec);
+extern PetscErrorCode PicardGetDiagonal(Mat, Vec);
+extern PetscErrorCode PreallocateAndSetNonzeros(Mat, ISLocalToGlobalMapping, unfemCtx*);
+extern PetscErrorCode SetUpMesh(UM*, UMReorderType, unfemCtx*);
+extern PetscErrorCode CreatePicardMatrix(unfemCtx*, ISLocalToGlobalMapping, PetscBool, PetscBool, Mat*);
+extern PetscErrorCode SetUpElementToNonzero(unfemCtx*, Mat);
+extern PetscErrorCode SetUpMultigrid(PC, UM*, PetscBool, unfemCtx*);
+extern PetscErrorCode SetUpEliminateDirichlet(Vec, unfemCtx*, Vec*);
+extern PetscErrorCode FormFunctionReduced(SNES, Vec, Vec, void*);
+extern PetscErrorCode FormJacobianReduced(SNES, Vec, Mat, Mat, void*);
+extern PetscErrorCode ErrorIndicators(unfemCtx*, Vec, PetscReal*);
+extern PetscErrorCode AdaptMesh(UM*, unfemCtx*, PetscInt, PetscReal, PetscReal, PetscBool*);
 
 int main(int argc,char **argv) {
     PetscErrorCode ierr;
     PetscMPIInt size;
     PetscBool   viewmesh = PETSC_FALSE,
                 viewsoln = PETSC_FALSE,
+                viewvtu = PETSC_FALSE,
+                eliminate = PETSC_FALSE,
+                adapted = PETSC_FALSE,
+                gmsh = PETSC_FALSE,
+                mg = PETSC_FALSE,
                 noprealloc = PETSC_FALSE,
+                packed = PETSC_FALSE,
+                quadset = PETSC_FALSE,
+                quality = PETSC_FALSE,
+                qualitycsv = PETSC_FALSE,
+                reuse = PETSC_FALSE,
                 savepintbinary = PETSC_FALSE,
                 savepintmatlab = PETSC_FALSE;
     char        root[256] = "", nodesname[256], issname[256], solnname[256],
-                pintname[256] = "";
-    PetscInt    savepintlevel = -1, levels;
-    UM          mesh;
+                packedname[256], gmshname[256], pintname[256] = "",
+                csvname[256] = "";
+    PetscInt    savepintlevel = -1, levels, refine = 0, order = 1, bench = 0,
+                adapt = 0, j;
+    UMReorderType reorder = REORDER_NONE;
+    JacobianType jac = JACOBIAN_PICARD;
+    UM          mesh, *coarse = NULL;
     unfemCtx    user;
     SNES        snes;
     KSP         ksp;
     PC          pc;
     PCType      pctype;
     Mat         A;
-    Vec         r, u, uexact;
-    PetscReal   err, h_max;
+    Vec         r, u, uexact, ufree = NULL, rfree = NULL;
+    PetscReal   err, h_max, adapttheta = 0.5, adapttol = 0.0;
 
     ierr = PetscInitialize(&argc,&argv,NULL,help); if (ierr) return ierr;
 
     ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size); CHKERRQ(ierr);
-    if (size != 1) {
-        SETERRQ(PETSC_COMM_SELF,1,"unfem only works on one MPI process");
-    }
 
     ierr = PetscLogStageRegister("Read mesh      ", &user.readstage); CHKERRQ(ierr);  //STRIP
+    ierr = PetscLogStageRegister("Adapt mesh     ", &user.adaptstage); CHKERRQ(ierr);  //STRIP
     ierr = PetscLogStageRegister("Set-up         ", &user.setupstage); CHKERRQ(ierr);  //STRIP
     ierr = PetscLogStageRegister("Solver         ", &user.solverstage); CHKERRQ(ierr);  //STRIP
     ierr = PetscLogStageRegister("Residual eval  ", &user.resstage); CHKERRQ(ierr);  //STRIP
@@ -86,10 +185,34 @@ int main(int argc,char **argv) {
 
     user.quaddegree = 1;
     user.solncase = 0;
+    user.threads = 1;
+    user.mglevels = 1;
+    user.matfree = PETSC_FALSE;
+    user.batch = PETSC_FALSE;
+    user.sbaij = PETSC_FALSE;
+    user.e2nz = NULL;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD, "un_", "options for unfem", ""); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-adapt",
+           "before the final solve, this many steps of solve, estimate, mark, and refine (serial P1 only)",
+           "unfem.c",adapt,&adapt,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsReal("-adapt_theta",
+           "Dorfler marking parameter:  refine elements carrying this fraction of the squared error estimate",
+           "unfem.c",adapttheta,&adapttheta,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsReal("-adapt_tol",
+           "stop adapting once the error estimate is below this value; 0 for a fixed number of steps",
+           "unfem.c",adapttol,&adapttol,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-batch",
+           "evaluate the residual on batches of elements in SIMD-friendly layout (P1 only)",
+           "unfem.c",user.batch,&(user.batch),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-bench_residual",
+           "before solving, time this many residual evaluations, scalar and batched, and report elements/s",
+           "unfem.c",bench,&bench,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-case",
            "exact solution cases: 0=linear, 1=nonlinear, 2=nonhomoNeumann, 3=chapter3, 4=koch",
            "unfem.c",user.solncase,&(user.solncase),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-eliminate_dirichlet",
+           "remove Dirichlet nodes from the system; SNES and KSP see only the free nodes",
+           "unfem.c",eliminate,&eliminate,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsString("-gamg_save_pint_binary",
            "filename under which to save interpolation operator (Mat) in PETSc binary format",
            "unfem.c",pintname,pintname,sizeof(pintname),&savepintbinary); CHKERRQ(ierr);
@@ -99,23 +222,74 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsInt("-gamg_save_pint_level",
            "saved interpolation operator is between L-1 and L where this option sets L; defaults to finest levels",
            "unfem.c",savepintlevel,&savepintlevel,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-gmsh",
+           "read mesh directly from ASCII Gmsh file with .msh extension",
+           "unfem.c",gmsh,&gmsh,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsEnum("-jacobian",
+           "Jacobian:  Picard matrix (a(u) frozen) or true Newton Jacobian",
+           "unfem.c",JacobianTypes,(PetscEnum)jac,(PetscEnum*)&jac,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-matfree",
+           "apply the Picard matrix without assembling it (MATSHELL); default PC is then Jacobi",
+           "unfem.c",user.matfree,&(user.matfree),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsString("-mesh",
-           "file name root of mesh stored in PETSc binary with .vec,.is extensions",
+           "file name root of mesh stored in PETSc binary with .vec,.is extensions, or packed with .umsh extension, or Gmsh .msh",
            "unfem.c",root,root,sizeof(root),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-mg",
+           "use geometric multigrid (PCMG) on the hierarchy from -un_refine",
+           "unfem.c",mg,&mg,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-noprealloc",
            "do not perform preallocation before matrix assembly",
            "unfem.c",noprealloc,&noprealloc,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-order",
+           "polynomial degree of elements: 1 (P1) or 2 (P2)",
+           "unfem.c",order,&order,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-packed",
+           "read mesh from single packed file with .umsh extension (see msh2petsc.py --packed)",
+           "unfem.c",packed,&packed,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsInt("-quaddegree",
-           "quadrature degree (1,2,3)",
-           "unfem.c",user.quaddegree,&(user.quaddegree),NULL); CHKERRQ(ierr);
+           "quadrature degree (1,2,3,4,5); default is 1 for P1 and 4 for P2",
+           "unfem.c",user.quaddegree,&(user.quaddegree),&quadset); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-quality",
+           "report mesh quality: angles, aspect ratios, valences, and size gradation",
+           "unfem.c",quality,&quality,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsString("-quality_csv",
+           "write mesh quality statistics to this file as CSV (header line and one data line)",
+           "unfem.c",csvname,csvname,sizeof(csvname),&qualitycsv); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-refine",
+           "number of uniform refinements (each triangle into four) of the mesh read from file",
+           "unfem.c",refine,&refine,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsEnum("-reorder",
+           "renumber nodes for locality before distributing the mesh",
+           "unfem.c",UMReorderTypes,(PetscEnum)reorder,(PetscEnum*)&reorder,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-reuse",
+           "assemble the Picard matrix through a precomputed element-to-nonzero map, and reuse GAMG interpolation",
+           "unfem.c",reuse,&reuse,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-sbaij",
+           "assemble only the upper triangle of the Picard matrix, as MATSBAIJ; in parallel use -sub_pc_type icc",
+           "unfem.c",user.sbaij,&(user.sbaij),NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-threads",
+           "number of OpenMP threads in residual and Picard matrix evaluation",
+           "unfem.c",user.threads,&(user.threads),NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-view_mesh",
            "view loaded mesh (nodes and elements) at stdout",
            "unfem.c",viewmesh,&viewmesh,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsBool("-view_solution",
            "view solution u(x,y) to binary file; uses root name of mesh plus .soln\nsee petsc2tricontour.py to view graphically",
            "unfem.c",viewsoln,&viewsoln,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-view_vtu",
+           "write mesh and solution to VTK XML file for ParaView; uses root name of mesh plus .vtu (or .pvtu in parallel)",
+           "unfem.c",viewvtu,&viewvtu,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsEnd(); CHKERRQ(ierr);
 
+#if !defined(_OPENMP)
+    if (user.threads > 1) {
+        SETERRQ(PETSC_COMM_SELF,8,"option -un_threads requires building with OpenMP; see makefile");
+    }
+#endif
+    if (user.threads < 1) {
+        SETERRQ(PETSC_COMM_SELF,23,"option -un_threads requires a positive number of threads");
+    }
+
     // determine filenames
     if (strlen(root) == 0) {
         SETERRQ(PETSC_COMM_SELF,2,"no mesh name root given; rerun with '-un_mesh foo'");
@@ -124,19 +298,66 @@ int main(int argc,char **argv) {
     strncat(nodesname, ".vec", 5);
     strcpy(issname, root);
     strncat(issname, ".is", 4);
+    strcpy(packedname, root);
+    strncat(packedname, ".umsh", 6);
+    strcpy(gmshname, root);
+    strncat(gmshname, ".msh", 5);
+    if (mg && refine < 1) {
+        SETERRQ(PETSC_COMM_SELF,10,"option -un_mg requires -un_refine N with N > 0");
+    }
+    if (jac == JACOBIAN_NEWTON && (mg || user.matfree)) {
+        SETERRQ(PETSC_COMM_SELF,11,"-un_jacobian newton cannot be combined with -un_mg or -un_matfree");
+    }
+    if (gmsh && packed) {
+        SETERRQ(PETSC_COMM_SELF,9,"only one of -un_gmsh OR -un_packed is allowed");
+    }
+    if ((order < 1) || (order > 2)) {
+        SETERRQ(PETSC_COMM_SELF,12,"element order must be 1 or 2");
+    }
+    if (order == 2 && (mg || user.matfree || jac == JACOBIAN_NEWTON)) {
+        SETERRQ(PETSC_COMM_SELF,13,"-un_order 2 cannot be combined with -un_mg, -un_matfree, or -un_jacobian newton");
+    }
+    if (order == 2 && (user.batch || bench > 0)) {
+        SETERRQ(PETSC_COMM_SELF,14,"-un_batch and -un_bench_residual are for P1 elements only");
+    }
+    if (eliminate && (mg || user.matfree || noprealloc)) {
+        SETERRQ(PETSC_COMM_SELF,15,"-un_eliminate_dirichlet cannot be combined with -un_mg, -un_matfree, or -un_noprealloc");
+    }
+    if (user.sbaij && (mg || user.matfree || jac == JACOBIAN_NEWTON)) {
+        SETERRQ(PETSC_COMM_SELF,16,"-un_sbaij cannot be combined with -un_mg, -un_matfree, or -un_jacobian newton");
+    }
+    if (reuse && (user.matfree || noprealloc || user.sbaij || jac == JACOBIAN_NEWTON)) {
+        SETERRQ(PETSC_COMM_SELF,17,"-un_reuse cannot be combined with -un_matfree, -un_noprealloc, -un_sbaij, or -un_jacobian newton");
+    }
+    if (adapt > 0 && (size > 1 || order == 2 || mg)) {
+        SETERRQ(PETSC_COMM_SELF,20,"-un_adapt requires a serial run with P1 elements and no -un_mg");
+    }
+    if (adapttheta <= 0.0 || adapttheta > 1.0) {
+        SETERRQ(PETSC_COMM_SELF,21,"-un_adapt_theta must be in (0,1]");
+    }
+    if (order == 2 && !quadset) {
+        user.quaddegree = 4;  // exact for grad . grad terms with a quadratic a
+    }
 
     // set source/boundary functions and exact solution
     user.a_fcn = &a_lin;
     user.f_fcn = &f_lin;
+    user.dadu_fcn = &dadu_lin;
+    user.dfdu_fcn = &dfdu_lin;
     user.uexact_fcn = &uexact_lin;
     user.gD_fcn = &gD_lin;
     user.gN_fcn = &gN_lin;
+    user.a_batch = &a_lin_batch;
+    user.f_batch = &f_lin_batch;
     switch (user.solncase) {
         case 0 :
             break;
         case 1 :
             user.a_fcn = &a_nonlin;
             user.f_fcn = &f_nonlin;
+            user.dadu_fcn = &dadu_nonlin;
+            user.a_batch = &a_nonlin_batch;
+            user.f_batch = &f_nonlin_batch;
             break;
         case 2 :
             user.gN_fcn = &gN_linneu;
@@ -144,6 +365,8 @@ int main(int argc,char **argv) {
         case 3 :
             user.a_fcn = &a_square;
             user.f_fcn = &f_square;
+            user.a_batch = &a_square_batch;
+            user.f_batch = &f_square_batch;
             user.uexact_fcn = &uexact_square;
             user.gD_fcn = &gD_square;
             user.gN_fcn = NULL;  // seg fault if ever called
@@ -151,6 +374,8 @@ int main(int argc,char **argv) {
         case 4 :
             user.a_fcn = &a_koch;
             user.f_fcn = &f_koch;
+            user.a_batch = &a_koch_batch;
+            user.f_batch = &f_koch_batch;
             user.uexact_fcn = NULL;  // seg fault if ever called
             user.gD_fcn = &gD_koch;
             user.gN_fcn = NULL;  // seg fault if ever called
@@ -162,10 +387,66 @@ int main(int argc,char **argv) {
     PetscLogStagePush(user.readstage);
     // read mesh object of type UM
     ierr = UMInitialize(&mesh); CHKERRQ(ierr);
-    ierr = UMReadNodes(&mesh,nodesname); CHKERRQ(ierr);
-    ierr = UMReadISs(&mesh,issname); CHKERRQ(ierr);
+    if (packed) {
+        ierr = UMReadPacked(&mesh,packedname); CHKERRQ(ierr);
+    } else if (gmsh) {
+        ierr = UMReadGmsh(&mesh,gmshname); CHKERRQ(ierr);
+    } else {
+        ierr = UMReadNodes(&mesh,nodesname); CHKERRQ(ierr);
+        ierr = UMReadISs(&mesh,issname); CHKERRQ(ierr);
+    }
+    if (mg) {
+        ierr = PetscMalloc1(refine,&coarse); CHKERRQ(ierr);
+        user.mglevels = refine + 1;
+    }
+    for (j = 0; j < refine; j++) {
+        UM  fine;
+        ierr = UMInitialize(&fine); CHKERRQ(ierr);
+        ierr = UMRefineUniform(&mesh,&fine); CHKERRQ(ierr);
+        if (mg) {
+            coarse[j] = mesh;  // keep level j for multigrid
+        } else {
+            ierr = UMDestroy(&mesh); CHKERRQ(ierr);
+        }
+        mesh = fine;
+    }
+    if (order == 2) {
+        UM  p2;
+        ierr = UMInitialize(&p2); CHKERRQ(ierr);
+        ierr = UMElevateP2(&mesh,&p2); CHKERRQ(ierr);
+        ierr = UMDestroy(&mesh); CHKERRQ(ierr);
+        mesh = p2;
+    }
+    if ((user.quaddegree < 1) || (user.quaddegree > 5)) {
+        SETERRQ(PETSC_COMM_SELF,7,"quadrature degree must be 1, 2, 3, 4, or 5");
+    }
+    PetscLogStagePush(user.adaptstage);  //STRIP
+    for (j = 0; j < adapt && !adapted; j++) {
+        ierr = AdaptMesh(&mesh,&user,j,adapttheta,adapttol,&adapted); CHKERRQ(ierr);
+    }
+    PetscLogStagePop();  //STRIP
+    ierr = SetUpMesh(&mesh,reorder,&user); CHKERRQ(ierr);
+    for (j = 0; j < user.mglevels - 1; j++) {
+        ierr = SetUpMesh(&(coarse[j]),reorder,&user); CHKERRQ(ierr);
+    }
     ierr = UMStats(&mesh, &h_max, NULL, NULL, NULL); CHKERRQ(ierr);
+    if (quality || qualitycsv) {
+        UMQuality   qs;
+        PetscViewer viewer;
+        ierr = UMQualityStats(&mesh,user.threads,&qs); CHKERRQ(ierr);
+        if (quality) {
+            ierr = PetscViewerASCIIGetStdout(PETSC_COMM_WORLD,&viewer); CHKERRQ(ierr);
+            ierr = UMQualityView(&qs,viewer,PETSC_FALSE); CHKERRQ(ierr);
+        }
+        if (qualitycsv) {
+            ierr = PetscViewerASCIIOpen(PETSC_COMM_WORLD,csvname,&viewer); CHKERRQ(ierr);
+            ierr = UMQualityView(&qs,viewer,PETSC_TRUE); CHKERRQ(ierr);
+            ierr = PetscViewerDestroy(&viewer); CHKERRQ(ierr);
+        }
+    }
+    ierr = PetscMalloc1(mesh.K,&(user.acoef)); CHKERRQ(ierr);
     user.mesh = &mesh;
+    ierr = SetUpDirichlet(&user); CHKERRQ(ierr);
     PetscLogStagePop();
 
     if (viewmesh) {
@@ -177,46 +458,101 @@ int main(int argc,char **argv) {
     PetscLogStagePush(user.setupstage);
 //STARTMAININITIAL
     // configure Vecs
-    ierr = VecCreate(PETSC_COMM_WORLD,&r); CHKERRQ(ierr);
-    ierr = VecSetSizes(r,PETSC_DECIDE,mesh.N); CHKERRQ(ierr);
-    ierr = VecSetFromOptions(r); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(&mesh,&r); CHKERRQ(ierr);
     ierr = VecDuplicate(r,&u); CHKERRQ(ierr);
     ierr = VecSet(u,0.0); CHKERRQ(ierr);
+    ierr = UMCreateLocalVec(&mesh,&(user.uloc)); CHKERRQ(ierr);
 
     // configure SNES: reset default KSP and PC
     ierr = SNESCreate(PETSC_COMM_WORLD,&snes); CHKERRQ(ierr);
-    ierr = SNESSetFunction(snes,r,FormFunction,&user); CHKERRQ(ierr);
+    if (order == 2)
+        user.fullfunction = FormFunctionP2;
+    else
+        user.fullfunction = user.batch ? FormFunctionBatch : FormFunction;
     ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
-    ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
     ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
-    ierr = PCSetType(pc,PCICC); CHKERRQ(ierr);
+    if (jac == JACOBIAN_NEWTON) {
+        // the Newton Jacobian is not symmetric
+        ierr = KSPSetType(ksp,KSPGMRES); CHKERRQ(ierr);
+        ierr = PCSetType(pc,(size == 1) ? PCILU : PCBJACOBI); CHKERRQ(ierr);
+    } else {
+        ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+        // ICC is serial only; block Jacobi uses ILU(0) blocks, symmetric here
+        ierr = PCSetType(pc,(size == 1) ? PCICC : PCBJACOBI); CHKERRQ(ierr);
+    }
 
-    // setup matrix for Picard iteration, including preallocation
-    ierr = MatCreate(PETSC_COMM_WORLD,&A); CHKERRQ(ierr);
-    ierr = MatSetSizes(A,PETSC_DECIDE,PETSC_DECIDE,mesh.N,mesh.N); CHKERRQ(ierr);
-    ierr = MatSetFromOptions(A); CHKERRQ(ierr);
-    ierr = MatSetOption(A,MAT_SYMMETRIC,PETSC_TRUE); CHKERRQ(ierr);
-    // Preallocation and setting the nonzero (sparsity) pattern is
-    //   recommended; setting the pattern allows finite difference
-    //   approximation of the Jacobian using coloring.  Option
-    //   -un_noprealloc reveals the poor performance otherwise.
-    if (noprealloc) {
-        ierr = MatSetUp(A); CHKERRQ(ierr);
+    // setup matrix for Picard iteration, including preallocation, or a
+    //   shell; the only assembled matrices are then on coarser levels (-un_mg)
+    if (user.matfree) {
+        ierr = MatCreateShell(PETSC_COMM_WORLD,mesh.Nown,mesh.Nown,
+                              PETSC_DETERMINE,PETSC_DETERMINE,&user,&A); CHKERRQ(ierr);
+        ierr = MatShellSetOperation(A,MATOP_MULT,(void(*)(void))PicardMult); CHKERRQ(ierr);
+        ierr = MatShellSetOperation(A,MATOP_GET_DIAGONAL,(void(*)(void))PicardGetDiagonal); CHKERRQ(ierr);
+        ierr = MatSetOption(A,MAT_SYMMETRIC,PETSC_TRUE); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCJACOBI); CHKERRQ(ierr);
     } else {
-        ierr = PreallocateAndSetNonzeros(A,&user); CHKERRQ(ierr);
+        // with -un_eliminate_dirichlet, A has only the free rows and columns
+        if (eliminate) {
+            ierr = SetUpEliminateDirichlet(u,&user,&ufree); CHKERRQ(ierr);
+        }
+        ierr = CreatePicardMatrix(&user,(eliminate) ? user.freeltog : mesh.ltog,
+                                  noprealloc,(jac == JACOBIAN_PICARD),&A); CHKERRQ(ierr);
+        if (reuse) {
+            ierr = SetUpElementToNonzero(&user,A); CHKERRQ(ierr);
+        }
     }
-    // The following call-back is ignored under option -snes_fd or
+    // The following Jacobian call-back is ignored under option -snes_fd or
     //   -snes_fd_color.
-    ierr = SNESSetJacobian(snes,A,A,FormPicard,&user); CHKERRQ(ierr);
+    user.fulljacobian = (jac == JACOBIAN_NEWTON) ? FormNewtonJacobian : FormPicard;
+    if (eliminate) {
+        ierr = VecDuplicate(ufree,&rfree); CHKERRQ(ierr);
+        ierr = SNESSetFunction(snes,rfree,FormFunctionReduced,&user); CHKERRQ(ierr);
+        ierr = SNESSetJacobian(snes,A,A,FormJacobianReduced,&user); CHKERRQ(ierr);
+    } else {
+        ierr = SNESSetFunction(snes,r,user.fullfunction,&user); CHKERRQ(ierr);
+        ierr = SNESSetJacobian(snes,A,A,user.fulljacobian,&user); CHKERRQ(ierr);
+    }
+    if (mg) {
+        ierr = SetUpMultigrid(pc,coarse,noprealloc,&user); CHKERRQ(ierr);
+    }
     ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
+    if (reuse) {
+        // no effect unless PC is GAMG
+        ierr = PCGAMGSetReuseInterpolation(pc,PETSC_TRUE); CHKERRQ(ierr);
+    }
     PetscLogStagePop();  //STRIP
 
+    if (bench > 0) {
+        ierr = BenchResidual(&user,u,r,bench); CHKERRQ(ierr);
+    }
+
     // solve
     PetscLogStagePush(user.solverstage);  //STRIP
-    ierr = SNESSolve(snes,NULL,u);CHKERRQ(ierr);
+    if (eliminate) {
+        ierr = SNESSolve(snes,NULL,ufree);CHKERRQ(ierr);
+    } else {
+        ierr = SNESSolve(snes,NULL,u);CHKERRQ(ierr);
+    }
 //ENDMAININITIAL
     PetscLogStagePop();
 
+    // fill the free nodes of u; its Dirichlet nodes already hold g_D
+    if (eliminate) {
+        ierr = VecScatterBegin(user.free2full,ufree,u,
+                               INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+        ierr = VecScatterEnd(user.free2full,ufree,u,
+                             INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    }
+
+    // save mesh and solution for ParaView if requested; before u is
+    //   overwritten by the error below
+    if (viewvtu) {
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "writing mesh and solution in VTU format to %s.%s ...\n",
+                   root,(size == 1) ? "vtu" : "pvtu"); CHKERRQ(ierr);
+        ierr = UMViewSolutionVTU(&mesh,root,u); CHKERRQ(ierr);
+    }
+
     // report if PC is GAMG
     ierr = PCGetType(pc,&pctype); CHKERRQ(ierr);
     if (strcmp(pctype,"gamg") == 0) {
@@ -258,6 +594,19 @@ int main(int argc,char **argv) {
         ierr = MatView(pint,viewer); CHKERRQ(ierr);
     }
 
+    // report the error estimate on the final adapted mesh
+    if (adapt > 0) {
+        PetscReal  *eta2, eta = 0.0;
+        ierr = PetscMalloc1(mesh.K,&eta2); CHKERRQ(ierr);
+        ierr = ErrorIndicators(&user,u,eta2); CHKERRQ(ierr);
+        for (j = 0; j < mesh.K; j++)
+            eta += eta2[j];
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "  error estimate %.3e on K=%d elements\n",
+                   PetscSqrtReal(eta),mesh.Kglobal); CHKERRQ(ierr);
+        PetscFree(eta2);
+    }
+
     // if exact solution available, report numerical error
     if (user.uexact_fcn) {
         ierr = VecDuplicate(r,&uexact); CHKERRQ(ierr);
@@ -266,12 +615,12 @@ int main(int argc,char **argv) {
         ierr = VecNorm(u,NORM_INFINITY,&err); CHKERRQ(ierr);
         ierr = PetscPrintf(PETSC_COMM_WORLD,
                    "case %d result for N=%d nodes with h = %.3e: |u-u_ex|_inf = %.2e\n",
-                   user.solncase,mesh.N,h_max,err); CHKERRQ(ierr);
+                   user.solncase,mesh.Nglobal,h_max,err); CHKERRQ(ierr);
         VecDestroy(&uexact);
     } else {
         ierr = PetscPrintf(PETSC_COMM_WORLD,
                    "case %d result for N=%d nodes with h = %.3e ... done\n",
-                   user.solncase,mesh.N,h_max); CHKERRQ(ierr);
+                   user.solncase,mesh.Nglobal,h_max); CHKERRQ(ierr);
     }
 
     // save solution in PETSc binary if requested
@@ -284,11 +633,482 @@ int main(int argc,char **argv) {
     }
 
     // clean-up
-    VecDestroy(&u);  VecDestroy(&r);
+    VecDestroy(&u);  VecDestroy(&r);  VecDestroy(&(user.uloc));
     MatDestroy(&A);  SNESDestroy(&snes);  UMDestroy(&mesh);
+    PetscFree(user.acoef);  PetscFree(user.gD);
+    if (reuse) {
+        PetscFree2(user.e2nz,user.diagnz);
+    }
+    for (j = 0; j < user.mglevels - 1; j++) {
+        VecDestroy(&(user.mgctx[j].uloc));  PetscFree(user.mgctx[j].acoef);
+        PetscFree(user.mgctx[j].gD);
+        if (reuse) {
+            PetscFree2(user.mgctx[j].e2nz,user.mgctx[j].diagnz);
+        }
+        MatDestroy(&(user.mgA[j]));  VecDestroy(&(user.mgu[j]));
+        VecScatterDestroy(&(user.mginject[j]));  UMDestroy(&(coarse[j]));
+    }
+    if (mg) {
+        PetscFree4(user.mgctx,user.mgA,user.mgu,user.mginject);
+        PetscFree(coarse);
+    }
+    if (eliminate) {
+        VecDestroy(&ufree);  VecDestroy(&rfree);
+        VecDestroy(&(user.ufull));  VecDestroy(&(user.Ffull));
+        ISDestroy(&(user.isfree));  VecScatterDestroy(&(user.free2full));
+        ISLocalToGlobalMappingDestroy(&(user.freeltog));
+    }
     return PetscFinalize();
 }
 
+// reorder, distribute, and cache geometry (and coloring) for one mesh
+PetscErrorCode SetUpMesh(UM *mesh, UMReorderType reorder, unfemCtx *user) {
+    PetscErrorCode ierr;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    ierr = UMReorder(mesh,reorder); CHKERRQ(ierr);
+    ierr = UMDistribute(mesh); CHKERRQ(ierr);
+    ierr = UMSetUpGeometry(mesh,q.n,q.xi,q.eta); CHKERRQ(ierr);
+    if (user->threads > 1) {
+        ierr = UMColorElements(mesh); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+// number of owned nodes which ltog does not map to -1, i.e. the owned rows of
+//   the Picard matrix, and the global index of the first
+static PetscErrorCode PicardOwnedRows(UM *mesh, ISLocalToGlobalMapping ltog,
+                                      PetscInt *nrows, PetscInt *rstart) {
+    PetscErrorCode ierr;
+    const PetscInt *gidx;
+    PetscInt       n, rend;
+    ierr = ISLocalToGlobalMappingGetIndices(ltog,&gidx); CHKERRQ(ierr);
+    *nrows = 0;
+    for (n = 0; n < mesh->Nown; n++) {
+        if (gidx[n] >= 0)
+            (*nrows)++;
+    }
+    ierr = ISLocalToGlobalMappingRestoreIndices(ltog,&gidx); CHKERRQ(ierr);
+    ierr = MPI_Scan(nrows,&rend,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD); CHKERRQ(ierr);
+    *rstart = rend - *nrows;
+    return 0;
+}
+
+// Preallocation and setting the nonzero (sparsity) pattern is recommended;
+//   setting the pattern allows finite difference approximation of the
+//   Jacobian using coloring.  Option -un_noprealloc reveals the poor
+//   performance otherwise.  The Newton Jacobian has the same pattern but is
+//   not symmetric.  With -un_sbaij (or -mat_type sbaij) only the upper
+//   triangle is stored; the assembly routines still insert whole element
+//   matrices and PETSc drops the lower-triangular entries.  The rows and
+//   columns are the owned nodes which ltog does not map to -1, so with
+//   ltog = user->freeltog the assembly routines drop the Dirichlet rows and
+//   columns in MatSetValuesLocal() and fill the reduced matrix directly.
+PetscErrorCode CreatePicardMatrix(unfemCtx *user, ISLocalToGlobalMapping ltog,
+                                  PetscBool noprealloc, PetscBool symmetric,
+                                  Mat *A) {
+    PetscErrorCode ierr;
+    PetscBool      sbaij;
+    PetscInt       nrows, rstart;
+    ierr = PicardOwnedRows(user->mesh,ltog,&nrows,&rstart); CHKERRQ(ierr);
+    ierr = MatCreate(PETSC_COMM_WORLD,A); CHKERRQ(ierr);
+    ierr = MatSetSizes(*A,nrows,nrows,PETSC_DETERMINE,PETSC_DETERMINE); CHKERRQ(ierr);
+    if (symmetric && user->sbaij) {
+        ierr = MatSetType(*A,MATSBAIJ); CHKERRQ(ierr);
+    }
+    ierr = MatSetFromOptions(*A); CHKERRQ(ierr);
+    // -mat_type sbaij would silently keep only the upper triangle of the
+    //   nonsymmetric Newton Jacobian
+    ierr = PetscObjectTypeCompareAny((PetscObject)(*A),&sbaij,
+               MATSBAIJ,MATSEQSBAIJ,MATMPISBAIJ,""); CHKERRQ(ierr);
+    if (sbaij && !symmetric) {
+        SETERRQ(PETSC_COMM_SELF,22,"SBAIJ storage requires a symmetric matrix; not available with -un_jacobian newton");
+    }
+    ierr = MatSetOption(*A,MAT_SYMMETRIC,symmetric); CHKERRQ(ierr);
+    if (noprealloc) {
+        ierr = MatSetUp(*A); CHKERRQ(ierr);
+        if (sbaij) {
+            ierr = MatSetOption(*A,MAT_IGNORE_LOWER_TRIANGULAR,PETSC_TRUE); CHKERRQ(ierr);
+        }
+        ierr = MatSetLocalToGlobalMapping(*A,ltog,ltog); CHKERRQ(ierr);
+    } else {
+        ierr = PreallocateAndSetNonzeros(*A,ltog,user); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+/* With option -un_reuse, the assembly routines write element matrices
+directly into the value arrays of an AIJ Picard matrix, without searching
+the rows in MatSetValuesLocal().  The map holds, for each entry (l,m) of the
+nen x nen matrix of element k, its position in the value array of the
+diagonal block, or nzdiag plus its position in the value array of the
+off-diagonal block (parallel only), or -1 if the entry is dropped (Dirichlet
+row or column, or a ghost row).  Rows and columns are located through the
+local-to-global map of P, so this also works for the reduced matrix of
+-un_eliminate_dirichlet, which has no Dirichlet rows.  The sparsity pattern
+is never changed, so the preconditioner sees the same nonzero pattern at
+each Picard iteration and ICC keeps its symbolic factorization.         */
+PetscErrorCode SetUpElementToNonzero(unfemCtx *user, Mat P) {
+    PetscErrorCode ierr;
+    UM              *mesh = user->mesh;
+    const PetscInt  *ae, *abf, *en, *gidx, *ia, *ja, *ib = NULL, *jb = NULL,
+                    *garray = NULL, nen = mesh->nen;
+    PetscInt        n, k, l, m, c, r, loc, nrows, rstart, cstart, cend,
+                    ngarray = 0;
+    Mat             Ad, Ao = NULL;
+    ISLocalToGlobalMapping ltog;
+    PetscBool       seq, mpi, done;
+
+    ierr = PetscObjectTypeCompare((PetscObject)P,MATSEQAIJ,&seq); CHKERRQ(ierr);
+    ierr = PetscObjectTypeCompare((PetscObject)P,MATMPIAIJ,&mpi); CHKERRQ(ierr);
+    if (!seq && !mpi) {
+        SETERRQ(PETSC_COMM_SELF,18,"-un_reuse requires a Picard matrix of type MATSEQAIJ or MATMPIAIJ");
+    }
+    if (mpi) {
+        ierr = MatMPIAIJGetSeqAIJ(P,&Ad,&Ao,&garray); CHKERRQ(ierr);
+        ierr = MatGetSize(Ao,NULL,&ngarray); CHKERRQ(ierr);
+        ierr = MatGetRowIJ(Ao,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ib,&jb,&done); CHKERRQ(ierr);
+    } else {
+        Ad = P;
+    }
+    ierr = MatGetRowIJ(Ad,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ia,&ja,&done); CHKERRQ(ierr);
+    ierr = MatGetOwnershipRange(P,&rstart,NULL); CHKERRQ(ierr);
+    ierr = MatGetOwnershipRangeColumn(P,&cstart,&cend); CHKERRQ(ierr);
+    user->nzdiag = ia[nrows];
+    user->nzoff = (Ao) ? ib[nrows] : 0;
+
+    ierr = MatGetLocalToGlobalMapping(P,&ltog,NULL); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingGetIndices(ltog,&gidx); CHKERRQ(ierr);
+    ierr = PetscMalloc2(nen*nen*mesh->K,&(user->e2nz),
+                        mesh->Nown,&(user->diagnz)); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        user->diagnz[n] = -1;  // row not in P
+        if (gidx[n] >= 0) {
+            r = gidx[n] - rstart;
+            ierr = PetscFindInt(gidx[n]-cstart,ia[r+1]-ia[r],ja+ia[r],&loc); CHKERRQ(ierr);
+            user->diagnz[n] = ia[r] + loc;
+        }
+    }
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + nen*k;
+        for (l = 0; l < nen; l++) {
+            for (m = 0; m < nen; m++) {
+                n = en[l];
+                loc = -1;
+                if (abf[n] != 2 && n < mesh->Nown && abf[en[m]] != 2) {
+                    r = gidx[n] - rstart;
+                    c = gidx[en[m]];
+                    if (c >= cstart && c < cend) {
+                        ierr = PetscFindInt(c-cstart,ia[r+1]-ia[r],ja+ia[r],&loc); CHKERRQ(ierr);
+                        if (loc >= 0)
+                            loc += ia[r];
+                    } else {
+                        ierr = PetscFindInt(c,ngarray,garray,&c); CHKERRQ(ierr);
+                        if (c >= 0) {
+                            ierr = PetscFindInt(c,ib[r+1]-ib[r],jb+ib[r],&loc); CHKERRQ(ierr);
+                        }
+                        if (loc >= 0)
+                            loc += user->nzdiag + ib[r];
+                    }
+                    if (loc < 0) {
+                        SETERRQ(PETSC_COMM_SELF,19,"element entry is not in the sparsity pattern");
+                    }
+                }
+                user->e2nz[nen*nen*k+nen*l+m] = loc;
+            }
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingRestoreIndices(ltog,&gidx); CHKERRQ(ierr);
+    ierr = MatRestoreRowIJ(Ad,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ia,&ja,&done); CHKERRQ(ierr);
+    if (Ao) {
+        ierr = MatRestoreRowIJ(Ao,0,PETSC_FALSE,PETSC_FALSE,&nrows,&ib,&jb,&done); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+// value arrays of the diagonal and off-diagonal blocks of an AIJ Picard
+//   matrix; *ao is NULL in serial
+static PetscErrorCode PicardGetArrays(Mat P, PetscScalar **ad, PetscScalar **ao) {
+    PetscErrorCode ierr;
+    Mat            Ad, Ao;
+    PetscBool      mpi;
+    ierr = PetscObjectTypeCompare((PetscObject)P,MATMPIAIJ,&mpi); CHKERRQ(ierr);
+    if (mpi) {
+        ierr = MatMPIAIJGetSeqAIJ(P,&Ad,&Ao,NULL); CHKERRQ(ierr);
+        ierr = MatSeqAIJGetArray(Ad,ad); CHKERRQ(ierr);
+        ierr = MatSeqAIJGetArray(Ao,ao); CHKERRQ(ierr);
+    } else {
+        ierr = MatSeqAIJGetArray(P,ad); CHKERRQ(ierr);
+        *ao = NULL;
+    }
+    return 0;
+}
+
+static PetscErrorCode PicardRestoreArrays(Mat P, PetscScalar **ad, PetscScalar **ao) {
+    PetscErrorCode ierr;
+    Mat            Ad, Ao;
+    PetscBool      mpi;
+    ierr = PetscObjectTypeCompare((PetscObject)P,MATMPIAIJ,&mpi); CHKERRQ(ierr);
+    if (mpi) {
+        ierr = MatMPIAIJGetSeqAIJ(P,&Ad,&Ao,NULL); CHKERRQ(ierr);
+        ierr = MatSeqAIJRestoreArray(Ad,ad); CHKERRQ(ierr);
+        ierr = MatSeqAIJRestoreArray(Ao,ao); CHKERRQ(ierr);
+    } else {
+        ierr = MatSeqAIJRestoreArray(P,ad); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+// zero the values, and put one on the diagonal of Dirichlet rows, if any
+static PetscErrorCode PicardZeroArrays(unfemCtx *user, const PetscInt *abf,
+                                       PetscScalar *ad, PetscScalar *ao) {
+    PetscErrorCode ierr;
+    PetscInt       n;
+    ierr = PetscArrayzero(ad,user->nzdiag); CHKERRQ(ierr);
+    if (ao) {
+        ierr = PetscArrayzero(ao,user->nzoff); CHKERRQ(ierr);
+    }
+    for (n = 0; n < user->mesh->Nown; n++) {
+        if (abf[n] == 2 && user->diagnz[n] >= 0)
+            ad[user->diagnz[n]] = 1.0;
+    }
+    return 0;
+}
+
+/* Geometric multigrid on the nested meshes from -un_refine.  Each coarser
+level gets a copy of the ctx with its own mesh, and its own Picard matrix,
+which FormPicard() reassembles (rediscretizes) from the injected iterate.
+The interpolations come from UMCreateInterpolation(), and restriction is
+their transpose.  Smoothers and the coarse solver are PCMG defaults, and
+can be changed by -mg_levels_ and -mg_coarse_ options.                 */
+PetscErrorCode SetUpMultigrid(PC pc, UM *coarse, PetscBool noprealloc,
+                              unfemCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt  L = user->mglevels, l;
+    Mat       pint;
+    KSP       kspl;
+
+    ierr = PetscMalloc4(L-1,&(user->mgctx),L-1,&(user->mgA),
+                        L-1,&(user->mgu),L-1,&(user->mginject)); CHKERRQ(ierr);
+    for (l = 0; l < L-1; l++) {
+        user->mgctx[l] = *user;
+        user->mgctx[l].mesh = &(coarse[l]);
+        user->mgctx[l].mglevels = 1;
+        ierr = UMCreateLocalVec(&(coarse[l]),&(user->mgctx[l].uloc)); CHKERRQ(ierr);
+        user->mgctx[l].matfree = PETSC_FALSE;  // coarser levels are assembled
+        ierr = PetscMalloc1(coarse[l].K,&(user->mgctx[l].acoef)); CHKERRQ(ierr);
+        ierr = SetUpDirichlet(&(user->mgctx[l])); CHKERRQ(ierr);
+        ierr = CreatePicardMatrix(&(user->mgctx[l]),coarse[l].ltog,noprealloc,PETSC_TRUE,
+                                  &(user->mgA[l])); CHKERRQ(ierr);
+        if (user->e2nz) {  // replace the copied fine-level map
+            ierr = SetUpElementToNonzero(&(user->mgctx[l]),user->mgA[l]); CHKERRQ(ierr);
+        }
+        ierr = UMCreateGlobalVec(&(coarse[l]),&(user->mgu[l])); CHKERRQ(ierr);
+        ierr = UMCreateInjection(&(coarse[l]),(l < L-2) ? &(coarse[l+1]) : user->mesh,
+                                 &(user->mginject[l])); CHKERRQ(ierr);
+    }
+    ierr = PCSetType(pc,PCMG); CHKERRQ(ierr);
+    ierr = PCMGSetLevels(pc,L,NULL); CHKERRQ(ierr);
+    ierr = PCMGSetGalerkin(pc,PC_MG_GALERKIN_NONE); CHKERRQ(ierr);
+    for (l = 1; l < L; l++) {
+        ierr = UMCreateInterpolation(&(coarse[l-1]),(l < L-1) ? &(coarse[l]) : user->mesh,
+                                     &pint); CHKERRQ(ierr);
+        ierr = PCMGSetInterpolation(pc,l,pint); CHKERRQ(ierr);
+        ierr = MatDestroy(&pint); CHKERRQ(ierr);
+    }
+    for (l = 0; l < L-1; l++) {
+        ierr = PCMGGetSmoother(pc,l,&kspl); CHKERRQ(ierr);
+        ierr = KSPSetOperators(kspl,user->mgA[l],user->mgA[l]); CHKERRQ(ierr);
+    }
+    if (user->matfree) {  // default SOR smoother needs matrix entries
+        PC  pcl;
+        ierr = PCMGGetSmoother(pc,L-1,&kspl); CHKERRQ(ierr);
+        ierr = KSPGetPC(kspl,&pcl); CHKERRQ(ierr);
+        ierr = PCSetType(pcl,PCJACOBI); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+/* Elimination of Dirichlet nodes (-un_eliminate_dirichlet).  Because the
+assembly routines already replace u by g_D at Dirichlet nodes and drop
+Dirichlet columns, the free rows of the full residual carry the boundary
+contributions (the "lifting"), and the free-free block of the full
+Picard or Newton matrix is the reduced matrix.  The reduced matrix is
+assembled directly, by the same routines, through user->freeltog, which
+numbers the free nodes globally and maps Dirichlet nodes to -1, so that
+MatSetValuesLocal() drops their rows and columns; the full matrix is never
+formed.  The reduced residual scatters the free values into ufull, calls
+the full-space function, and extracts the free rows, at the cost of two
+Vecs of full length.  On return u holds g_D at its owned Dirichlet nodes,
+and *ufree is the initial iterate.                                      */
+PetscErrorCode SetUpEliminateDirichlet(Vec u, unfemCtx *user, Vec *ufree) {
+    PetscErrorCode ierr;
+    UM              *mesh = user->mesh;
+    const PetscInt  *abf;
+    const PetscReal *aloc;
+    PetscInt        *ifree, *lidx, n, nfree = 0, rstart, Nfree;
+    PetscReal       *au;
+    Vec             gfree, lfree;
+
+    ierr = VecGetOwnershipRange(u,&rstart,NULL); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->Nown,&ifree); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecGetArray(u,&au); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        if (abf[n] == 2)
+            au[n] = user->gD[n];
+        else
+            ifree[nfree++] = rstart + n;
+    }
+    ierr = VecRestoreArray(u,&au); CHKERRQ(ierr);
+    ierr = ISCreateGeneral(PETSC_COMM_WORLD,nfree,ifree,PETSC_OWN_POINTER,
+                           &(user->isfree)); CHKERRQ(ierr);
+    ierr = ISGetSize(user->isfree,&Nfree); CHKERRQ(ierr);
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  eliminating %d Dirichlet nodes; solving for N=%d free nodes\n",
+               mesh->Nglobal-Nfree,Nfree); CHKERRQ(ierr);
+
+    ierr = VecCreateMPI(PETSC_COMM_WORLD,nfree,PETSC_DETERMINE,ufree); CHKERRQ(ierr);
+    ierr = VecScatterCreate(*ufree,NULL,u,user->isfree,&(user->free2full)); CHKERRQ(ierr);
+    ierr = VecScatterBegin(user->free2full,u,*ufree,
+                           INSERT_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = VecScatterEnd(user->free2full,u,*ufree,
+                         INSERT_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = VecDuplicate(u,&(user->ufull)); CHKERRQ(ierr);
+    ierr = VecCopy(u,user->ufull); CHKERRQ(ierr);
+    ierr = VecDuplicate(u,&(user->Ffull)); CHKERRQ(ierr);
+
+    // global free index of each local node, or -1; the values for ghost
+    //   nodes come from their owners
+    ierr = VecGetOwnershipRange(*ufree,&rstart,NULL); CHKERRQ(ierr);
+    ierr = VecDuplicate(u,&gfree); CHKERRQ(ierr);
+    ierr = VecGetArray(gfree,&au); CHKERRQ(ierr);
+    nfree = 0;
+    for (n = 0; n < mesh->Nown; n++)
+        au[n] = (abf[n] == 2) ? -1.0 : (PetscReal)(rstart + nfree++);
+    ierr = VecRestoreArray(gfree,&au); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMCreateLocalVec(mesh,&lfree); CHKERRQ(ierr);
+    ierr = UMGlobalToLocal(mesh,gfree,lfree); CHKERRQ(ierr);
+    ierr = PetscMalloc1(mesh->N,&lidx); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(lfree,&aloc); CHKERRQ(ierr);
+    for (n = 0; n < mesh->N; n++)
+        lidx[n] = (PetscInt)aloc[n];
+    ierr = VecRestoreArrayRead(lfree,&aloc); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingCreate(PETSC_COMM_WORLD,1,mesh->N,lidx,
+               PETSC_OWN_POINTER,&(user->freeltog)); CHKERRQ(ierr);
+    VecDestroy(&gfree);  VecDestroy(&lfree);
+    return 0;
+}
+
+PetscErrorCode FormFunctionReduced(SNES snes, Vec ufree, Vec Ffree, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx  *user = (unfemCtx*)ctx;
+    ierr = VecScatterBegin(user->free2full,ufree,user->ufull,
+                           INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = VecScatterEnd(user->free2full,ufree,user->ufull,
+                         INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = (*user->fullfunction)(snes,user->ufull,user->Ffull,ctx); CHKERRQ(ierr);
+    ierr = VecScatterBegin(user->free2full,user->Ffull,Ffree,
+                           INSERT_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    ierr = VecScatterEnd(user->free2full,user->Ffull,Ffree,
+                         INSERT_VALUES,SCATTER_REVERSE); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode FormJacobianReduced(SNES snes, Vec ufree, Mat A, Mat P,
+                                   void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx  *user = (unfemCtx*)ctx;
+    ierr = VecScatterBegin(user->free2full,ufree,user->ufull,
+                           INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    ierr = VecScatterEnd(user->free2full,ufree,user->ufull,
+                         INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+    // P has local-to-global map user->freeltog, so this fills it directly
+    ierr = (*user->fulljacobian)(snes,user->ufull,A,P,ctx); CHKERRQ(ierr);
+    return 0;
+}
+
+/* One step of adaptive refinement:  solve on the current mesh with a Picard
+iteration (CG+ICC unless overridden by options), compute the error indicators,
+mark by the Dorfler (bulk) criterion the fewest elements whose squared
+indicators sum to at least theta times the total, and refine.  If the estimate
+is already below tol then nothing is marked, the refined mesh is a copy, and
+*done is set.  The new mesh is not yet distributed, and replaces *mesh.     */
+PetscErrorCode AdaptMesh(UM *mesh, unfemCtx *user, PetscInt step,
+                         PetscReal theta, PetscReal tol, PetscBool *done) {
+    PetscErrorCode ierr;
+    unfemCtx   actx = *user;
+    UM         fine;
+    SNES       snes;
+    KSP        ksp;
+    PC         pc;
+    Mat        A;
+    Vec        u, r;
+    PetscReal  *eta2, total = 0.0, bulk = 0.0, eta;
+    PetscInt   *perm, k, j, nmark = 0;
+    PetscBool  *marked;
+
+    ierr = SetUpMesh(mesh,REORDER_NONE,&actx); CHKERRQ(ierr);
+    actx.mesh = mesh;
+    actx.matfree = PETSC_FALSE;
+    actx.sbaij = PETSC_FALSE;
+    actx.e2nz = NULL;
+    actx.mglevels = 1;
+    ierr = PetscMalloc1(mesh->K,&(actx.acoef)); CHKERRQ(ierr);
+    ierr = SetUpDirichlet(&actx); CHKERRQ(ierr);
+    ierr = UMCreateGlobalVec(mesh,&r); CHKERRQ(ierr);
+    ierr = VecDuplicate(r,&u); CHKERRQ(ierr);
+    ierr = VecSet(u,0.0); CHKERRQ(ierr);
+    ierr = UMCreateLocalVec(mesh,&(actx.uloc)); CHKERRQ(ierr);
+
+    ierr = SNESCreate(PETSC_COMM_WORLD,&snes); CHKERRQ(ierr);
+    ierr = SNESSetFunction(snes,r,actx.batch ? FormFunctionBatch : FormFunction,
+                           &actx); CHKERRQ(ierr);
+    ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
+    ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
+    ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+    ierr = PCSetType(pc,PCICC); CHKERRQ(ierr);
+    ierr = CreatePicardMatrix(&actx,mesh->ltog,PETSC_FALSE,PETSC_TRUE,&A); CHKERRQ(ierr);
+    ierr = SNESSetJacobian(snes,A,A,FormPicard,&actx); CHKERRQ(ierr);
+    ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
+    ierr = SNESSolve(snes,NULL,u); CHKERRQ(ierr);
+
+    ierr = PetscMalloc3(mesh->K,&eta2,mesh->K,&perm,mesh->K,&marked); CHKERRQ(ierr);
+    ierr = ErrorIndicators(&actx,u,eta2); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        total += eta2[k];
+        perm[k] = k;
+        marked[k] = PETSC_FALSE;
+    }
+    eta = PetscSqrtReal(total);
+    *done = (eta < tol) ? PETSC_TRUE : PETSC_FALSE;
+    if (!*done) {
+        ierr = PetscSortRealWithPermutation(mesh->K,eta2,perm); CHKERRQ(ierr);
+        for (j = mesh->K - 1; j >= 0 && bulk < theta * total; j--) {
+            marked[perm[j]] = PETSC_TRUE;
+            bulk += eta2[perm[j]];
+            nmark++;
+        }
+    }
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  adaptive step %d: N=%d nodes, K=%d elements, error estimate %.3e, marked %d\n",
+               step,mesh->Nglobal,mesh->Kglobal,eta,nmark); CHKERRQ(ierr);
+    ierr = UMInitialize(&fine); CHKERRQ(ierr);
+    ierr = UMRefineMarked(mesh,marked,&fine); CHKERRQ(ierr);
+
+    VecDestroy(&u);  VecDestroy(&r);  VecDestroy(&(actx.uloc));
+    MatDestroy(&A);  SNESDestroy(&snes);
+    PetscFree(actx.acoef);  PetscFree(actx.gD);
+    PetscFree3(eta2,perm,marked);
+    ierr = UMDestroy(mesh); CHKERRQ(ierr);
+    *mesh = fine;
+    return 0;
+}
+
 PetscErrorCode FillExact(Vec uexact, unfemCtx *ctx) {
     PetscErrorCode ierr;
     const Node   *aloc;
@@ -296,7 +1116,7 @@ PetscErrorCode FillExact(Vec uexact, unfemCtx *ctx) {
     PetscInt     i;
     ierr = UMGetNodeCoordArrayRead(ctx->mesh,&aloc); CHKERRQ(ierr);
     ierr = VecGetArray(uexact,&auexact); CHKERRQ(ierr);
-    for (i = 0; i < ctx->mesh->N; i++) {
+    for (i = 0; i < ctx->mesh->Nown; i++) {
         auexact[i] = ctx->uexact_fcn(aloc[i].x,aloc[i].y);
     }
     ierr = VecRestoreArray(uexact,&auexact); CHKERRQ(ierr);
@@ -304,182 +1124,1004 @@ PetscErrorCode FillExact(Vec uexact, unfemCtx *ctx) {
     return 0;
 }
 
+// Dirichlet values are fixed for the run, so evaluate g_D once at each
+//   local (owned+ghost) node instead of inside the element loops
+PetscErrorCode SetUpDirichlet(unfemCtx *ctx) {
+    PetscErrorCode ierr;
+    const Node     *aloc;
+    const PetscInt *abf;
+    PetscInt       n;
+    ierr = PetscMalloc1(ctx->mesh->N,&(ctx->gD)); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(ctx->mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(ctx->mesh->bf,&abf); CHKERRQ(ierr);
+    for (n = 0; n < ctx->mesh->N; n++) {
+        ctx->gD[n] = (abf[n] == 2) ? ctx->gD_fcn(aloc[n].x,aloc[n].y) : 0.0;
+    }
+    ierr = ISRestoreIndices(ctx->mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(ctx->mesh,&aloc); CHKERRQ(ierr);
+    return 0;
+}
+
 PetscReal InnerProd(const PetscReal V[2], const PetscReal W[2]) {
     return V[0] * W[0] + V[1] * W[1];
 }
 
+// Neumann boundary segment contributions to the P1 residual
+static PetscErrorCode NeumannResidual(unfemCtx *user, const Node *aloc,
+                                      const PetscInt *abf, PetscReal *aF) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const PetscInt   *ans;
+    PetscInt         p, na, nb;
+    PetscReal        dx, dy, ls, xmid, ymid, sint;
+
+    if (mesh->P == 0)
+        return 0;
+    ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    for (p = 0; p < mesh->P; p++) {
+        na = ans[2*p+0];  nb = ans[2*p+1];  // end nodes of segment
+        dx = aloc[na].x-aloc[nb].x;  dy = aloc[na].y-aloc[nb].y;
+        ls = sqrt(dx * dx + dy * dy);  // length of segment
+        // midpoint rule; psi_na=psi_nb=0.5 at midpoint of segment
+        xmid = 0.5*(aloc[na].x+aloc[nb].x);
+        ymid = 0.5*(aloc[na].y+aloc[nb].y);
+        sint = 0.5 * ls * user->gN_fcn(xmid,ymid);
+        // nodes could be Dirichlet, or ghosts owned by another process
+        if (abf[na] != 2 && na < mesh->Nown)
+            aF[na] -= sint;
+        if (abf[nb] != 2 && nb < mesh->Nown)
+            aF[nb] -= sint;
+    }
+    ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    return 0;
+}
+
 //STARTRESIDUAL
 PetscErrorCode FormFunction(SNES snes, Vec u, Vec F, void *ctx) {
     PetscErrorCode ierr;
     unfemCtx         *user = (unfemCtx*)ctx;
+    UM               *mesh = user->mesh;
     const Quad2DTri  q = symmgauss[user->quaddegree-1];
-    const PetscInt   *ae, *ans, *abf, *en;
+    const PetscInt   *ae, *abf, *en;
     const Node       *aloc;
     const PetscReal  *au;
-    PetscInt         p, na, nb, k, l, r;
-    PetscReal        *aF, unode[3], gradu[2], gradpsi[3][2], uquad[4],
-                     aquad[4], fquad[4], dx, dy, dx1, dx2, dy1, dy2,
-                     detJ, ls, xmid, ymid, sint, xx, yy, psi, ip, sum;
+    PetscInt         K = mesh->K, nc, c, jstart, jend, j, k, l, r;
+    PetscReal        *aF, unode[3], gradu[2], gradpsi[3][2],
+                     uquad[MAXPTS_TRI], aquad[MAXPTS_TRI], fquad[MAXPTS_TRI],
+                     psiquad[3][MAXPTS_TRI], xx, yy, ip, sum;
 
     PetscLogStagePush(user->resstage);  //STRIP
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
     ierr = VecSet(F,0.0); CHKERRQ(ierr);
     ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
-    ierr = UMGetNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
-    ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
 
     // Neumann boundary segment contributions (if any)
-    if (user->mesh->P > 0) {
-        ierr = ISGetIndices(user->mesh->ns,&ans); CHKERRQ(ierr);
-        for (p = 0; p < user->mesh->P; p++) {
-            na = ans[2*p+0];  nb = ans[2*p+1];  // end nodes of segment
-            dx = aloc[na].x-aloc[nb].x;  dy = aloc[na].y-aloc[nb].y;
-            ls = sqrt(dx * dx + dy * dy);  // length of segment
-            // midpoint rule; psi_na=psi_nb=0.5 at midpoint of segment
-            xmid = 0.5*(aloc[na].x+aloc[nb].x);
-            ymid = 0.5*(aloc[na].y+aloc[nb].y);
-            sint = 0.5 * ls * user->gN_fcn(xmid,ymid);
-            // nodes could be Dirichlet
-            if (abf[na] != 2)
-                aF[na] -= sint;
-            if (abf[nb] != 2)
-                aF[nb] -= sint;
-        }
-        ierr = ISRestoreIndices(user->mesh->ns,&ans); CHKERRQ(ierr);
-    }
-
-    // element contributions and Dirichlet node residuals
-    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
-    ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    for (k = 0; k < user->mesh->K; k++) {
-        // element geometry and hat function gradients
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        dx1 = aloc[en[1]].x - aloc[en[0]].x;
-        dx2 = aloc[en[2]].x - aloc[en[0]].x;
-        dy1 = aloc[en[1]].y - aloc[en[0]].y;
-        dy2 = aloc[en[2]].y - aloc[en[0]].y;
-        detJ = dx1 * dy2 - dx2 * dy1;
-        for (l = 0; l < 3; l++) {
-            gradpsi[l][0] = ( dy2 * dchi[l][0] - dy1 * dchi[l][1]) / detJ;
-            gradpsi[l][1] = (-dx2 * dchi[l][0] + dx1 * dchi[l][1]) / detJ;
+    ierr = NeumannResidual(user,aloc,abf,aF); CHKERRQ(ierr);
+
+    // hat functions at quadrature points are the same on every element
+    for (l = 0; l < 3; l++)
+        for (r = 0; r < q.n; r++)
+            psiquad[l][r] = chi(l,q.xi[r],q.eta[r]);
+
+    // element contributions and Dirichlet node residuals; geometry comes
+    //   from the cache built by UMSetUpGeometry(); with threads the elements
+    //   are visited one color at a time (see UMColorElements()) so no two
+    //   threads write to the same entry of aF
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    nc = (mesh->ncolors > 0) ? mesh->ncolors : 1;
+    for (c = 0; c < nc; c++) {
+        jstart = (mesh->ncolors > 0) ? mesh->colorptr[c] : 0;
+        jend = (mesh->ncolors > 0) ? mesh->colorptr[c+1] : K;
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(k,en,l,r,unode,gradu,gradpsi,uquad,aquad,fquad,xx,yy,ip,sum)
+#endif
+        for (j = jstart; j < jend; j++) {
+            k = (mesh->ncolors > 0) ? mesh->colorel[j] : j;
+            en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
+            // u and grad u on element
+            gradu[0] = 0.0;
+            gradu[1] = 0.0;
+            for (l = 0; l < 3; l++) {
+                gradpsi[l][0] = mesh->gpx[l*K+k];
+                gradpsi[l][1] = mesh->gpy[l*K+k];
+                if (abf[en[l]] == 2)  // enforces symmetry
+                    unode[l] = user->gD[en[l]];
+                else
+                    unode[l] = au[en[l]];
+                gradu[0] += unode[l] * gradpsi[l][0];
+                gradu[1] += unode[l] * gradpsi[l][1];
+            }
+            // function values at quadrature points on element
+            for (r = 0; r < q.n; r++) {
+                uquad[r] = eval(unode,q.xi[r],q.eta[r]);
+                xx = mesh->xq[r*K+k];
+                yy = mesh->yq[r*K+k];
+                aquad[r] = user->a_fcn(uquad[r],xx,yy);
+                fquad[r] = user->f_fcn(uquad[r],xx,yy);
+            }
+            // residual contribution for each owned node of element
+            for (l = 0; l < 3; l++) {
+                if (en[l] >= mesh->Nown)
+                    continue;
+                if (abf[en[l]] == 2) { // set Dirichlet residual
+                    aF[en[l]] = au[en[l]] - user->gD[en[l]];
+                } else {
+                    ip  = InnerProd(gradu,gradpsi[l]);
+                    sum = 0.0;
+                    for (r = 0; r < q.n; r++)
+                        sum += q.w[r] * ( aquad[r] * ip - fquad[r] * psiquad[l][r] );
+                    aF[en[l]] += mesh->absdetJ[k] * sum;
+                }
+            }
         }
-        // u and grad u on element
-        gradu[0] = 0.0;
-        gradu[1] = 0.0;
+    }
+
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
+//ENDRESIDUAL
+
+
+/* Batched residual for P1 elements.  Elements are taken NB at a time, in
+element order or color order (with threads), and their data are gathered
+into structure-of-arrays blocks [..][NB].  The arithmetic then runs over the
+NB lanes in loops marked PetscPragmaSIMD, and a() and f() are called once per
+batch through the batched callbacks in cases.h.  With NB = 8 the lanes fill
+AVX-512 registers with doubles, or two AVX2 registers.  Incomplete batches
+are padded by repeating the first element, whose results are not used.    */
+#define NB 8
+
+PetscErrorCode FormFunctionBatch(SNES snes, Vec u, Vec F, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx         *user = (unfemCtx*)ctx;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf;
+    const Node       *aloc;
+    const PetscReal  *au;
+    PetscInt         K = mesh->K, nc, c, jstart, jend, j, nb, b, l, r, n,
+                     kb[NB];
+    PetscReal        *aF, psiquad[3][MAXPTS_TRI], un[3][NB], gx[3][NB],
+                     gy[3][NB], gux[NB], guy[NB], uq[NB], xb[NB], yb[NB],
+                     aq[MAXPTS_TRI][NB], fq[MAXPTS_TRI][NB], res[3][NB];
+
+    PetscLogStagePush(user->resstage);  //STRIP
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
+    ierr = VecSet(F,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = NeumannResidual(user,aloc,abf,aF); CHKERRQ(ierr);
+
+    for (l = 0; l < 3; l++)
+        for (r = 0; r < q.n; r++)
+            psiquad[l][r] = chi(l,q.xi[r],q.eta[r]);
+
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    nc = (mesh->ncolors > 0) ? mesh->ncolors : 1;
+    for (c = 0; c < nc; c++) {
+        jstart = (mesh->ncolors > 0) ? mesh->colorptr[c] : 0;
+        jend = (mesh->ncolors > 0) ? mesh->colorptr[c+1] : K;
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(nb,b,l,r,n,kb,un,gx,gy,gux,guy,uq,xb,yb,aq,fq,res)
+#endif
+        for (j = jstart; j < jend; j += NB) {
+            nb = PetscMin(NB,jend-j);
+            for (b = 0; b < NB; b++)
+                kb[b] = (mesh->ncolors > 0) ? mesh->colorel[j + ((b < nb) ? b : 0)]
+                                            : j + ((b < nb) ? b : 0);
+            // gather nodal values and cached gradients
+            for (l = 0; l < 3; l++) {
+                for (b = 0; b < NB; b++) {
+                    n = ae[3*kb[b]+l];
+                    un[l][b] = (abf[n] == 2) ? user->gD[n] : au[n];
+                    gx[l][b] = mesh->gpx[l*K+kb[b]];
+                    gy[l][b] = mesh->gpy[l*K+kb[b]];
+                }
+            }
+            PetscPragmaSIMD
+            for (b = 0; b < NB; b++) {
+                gux[b] = un[0][b] * gx[0][b] + un[1][b] * gx[1][b] + un[2][b] * gx[2][b];
+                guy[b] = un[0][b] * gy[0][b] + un[1][b] * gy[1][b] + un[2][b] * gy[2][b];
+            }
+            // coefficients at quadrature points, one batched call each
+            for (r = 0; r < q.n; r++) {
+                for (b = 0; b < NB; b++) {
+                    xb[b] = mesh->xq[r*K+kb[b]];
+                    yb[b] = mesh->yq[r*K+kb[b]];
+                }
+                PetscPragmaSIMD
+                for (b = 0; b < NB; b++)
+                    uq[b] = un[0][b] * psiquad[0][r] + un[1][b] * psiquad[1][r]
+                            + un[2][b] * psiquad[2][r];
+                user->a_batch(NB,uq,xb,yb,aq[r]);
+                user->f_batch(NB,uq,xb,yb,fq[r]);
+            }
+            // element residuals for all three nodes in all lanes
+            for (l = 0; l < 3; l++) {
+                PetscPragmaSIMD
+                for (b = 0; b < NB; b++)
+                    res[l][b] = 0.0;
+                for (r = 0; r < q.n; r++) {
+                    PetscPragmaSIMD
+                    for (b = 0; b < NB; b++)
+                        res[l][b] += q.w[r] * ( aq[r][b] * (gux[b] * gx[l][b] + guy[b] * gy[l][b])
+                                                - fq[r][b] * psiquad[l][r] );
+                }
+            }
+            // scatter, as in FormFunction()
+            for (b = 0; b < nb; b++) {
+                for (l = 0; l < 3; l++) {
+                    n = ae[3*kb[b]+l];
+                    if (n >= mesh->Nown)
+                        continue;
+                    if (abf[n] == 2)
+                        aF[n] = au[n] - user->gD[n];
+                    else
+                        aF[n] += mesh->absdetJ[kb[b]] * res[l][b];
+                }
+            }
+        }
+    }
+
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
+
+/* Microbenchmark for -un_bench_residual N:  N evaluations each of the
+scalar FormFunction() and the batched FormFunctionBatch() at the current
+iterate, reporting elements per second (over owned elements on all
+processes) for the quadrature degree in use, and the largest difference
+between the two residuals.                                               */
+PetscErrorCode BenchResidual(unfemCtx *user, Vec u, Vec F, PetscInt N) {
+    PetscErrorCode ierr;
+    PetscInt   i, m;
+    PetscLogDouble t0, t1;
+    PetscReal  t, tmax, diff;
+    Vec        Fbatch;
+    PetscErrorCode (*fcn[2])(SNES,Vec,Vec,void*) = {FormFunction, FormFunctionBatch};
+    const char *name[2] = {"scalar ", "batched"};
+
+    ierr = VecDuplicate(F,&Fbatch); CHKERRQ(ierr);
+    for (m = 0; m < 2; m++) {
+        ierr = MPI_Barrier(PETSC_COMM_WORLD); CHKERRQ(ierr);
+        ierr = PetscTime(&t0); CHKERRQ(ierr);
+        for (i = 0; i < N; i++) {
+            ierr = (*fcn[m])(NULL,u,(m == 0) ? F : Fbatch,user); CHKERRQ(ierr);
+        }
+        ierr = PetscTime(&t1); CHKERRQ(ierr);
+        t = t1 - t0;
+        ierr = MPI_Allreduce(&t,&tmax,1,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD); CHKERRQ(ierr);
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "  residual %s (quadrature degree %d):  %.3e elements/s\n",
+                   name[m],user->quaddegree,(PetscReal)(N * user->mesh->Kglobal) / tmax); CHKERRQ(ierr);
+    }
+    ierr = VecAXPY(Fbatch,-1.0,F); CHKERRQ(ierr);
+    ierr = VecNorm(Fbatch,NORM_INFINITY,&diff); CHKERRQ(ierr);
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  |F_scalar - F_batched|_inf = %.2e\n",diff); CHKERRQ(ierr);
+    VecDestroy(&Fbatch);
+    return 0;
+}
+
+
+/* Residual-based a posteriori error indicators for P1 elements.  On element K
+the squared indicator is
+  eta_K^2 = h_K^2 || f + div(a grad u_h) ||_K^2
+            + (1/2) sum_E |E|^2 [a grad u_h . n]_E^2
+            + sum_E |E|^2 (g_N - a grad u_h . n)^2
+where h_K is the longest side of K, the first sum is over interior edges
+(each jump is shared by two elements), and the second is over Neumann
+segments of K.  Within K, div(a grad u_h) = grad a_h . grad u_h where a_h is
+the P1 interpolant of a(u_h,x,y).  Edge terms use the midpoint rule.  The
+mesh must be whole on this process (serial).                             */
+PetscErrorCode ErrorIndicators(unfemCtx *user, Vec u, PetscReal *eta2) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf, *en;
+    const Node       *aloc;
+    const PetscReal  *au;
+    PetscInt         K = mesh->K, *nbr, k, l, r, s, t, na, nb, nc;
+    PetscReal        *gux, *guy, unode[3], grada[2], anode, uquad, res, sum,
+                     hK, dx, dy, len, nx, ny, xmid, ymid, umid, jump;
+
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = PetscMalloc2(K,&gux,K,&guy); CHKERRQ(ierr);
+
+    // element residuals; keep grad u_h on each element for the jumps
+    for (k = 0; k < K; k++) {
+        en = ae + 3*k;
+        gux[k] = 0.0;  guy[k] = 0.0;
+        grada[0] = 0.0;  grada[1] = 0.0;
+        hK = 0.0;
         for (l = 0; l < 3; l++) {
-            if (abf[en[l]] == 2)  // enforces symmetry
-                unode[l] = user->gD_fcn(aloc[en[l]].x,aloc[en[l]].y);
-            else
-                unode[l] = au[en[l]];
-            gradu[0] += unode[l] * gradpsi[l][0];
-            gradu[1] += unode[l] * gradpsi[l][1];
+            unode[l] = (abf[en[l]] == 2) ? user->gD[en[l]] : au[en[l]];
+            anode = user->a_fcn(unode[l],aloc[en[l]].x,aloc[en[l]].y);
+            gux[k] += unode[l] * mesh->gpx[l*K+k];
+            guy[k] += unode[l] * mesh->gpy[l*K+k];
+            grada[0] += anode * mesh->gpx[l*K+k];
+            grada[1] += anode * mesh->gpy[l*K+k];
+            dx = aloc[en[(l+1)%3]].x - aloc[en[l]].x;
+            dy = aloc[en[(l+1)%3]].y - aloc[en[l]].y;
+            hK = PetscMax(hK,dx * dx + dy * dy);  // squared
         }
-        // function values at quadrature points on element
+        sum = 0.0;
         for (r = 0; r < q.n; r++) {
-            uquad[r] = eval(unode,q.xi[r],q.eta[r]);
-            xx = aloc[en[0]].x + dx1 * q.xi[r] + dx2 * q.eta[r];
-            yy = aloc[en[0]].y + dy1 * q.xi[r] + dy2 * q.eta[r];
-            aquad[r] = user->a_fcn(uquad[r],xx,yy);
-            fquad[r] = user->f_fcn(uquad[r],xx,yy);
+            uquad = eval(unode,q.xi[r],q.eta[r]);
+            res = user->f_fcn(uquad,mesh->xq[r*K+k],mesh->yq[r*K+k])
+                  + grada[0] * gux[k] + grada[1] * guy[k];
+            sum += q.w[r] * res * res;
         }
-        // residual contribution for each node of element
+        eta2[k] = hK * mesh->absdetJ[k] * sum;
+    }
+
+    // flux jumps across interior edges, visited once from the element with
+    //   the larger slot, and Neumann residuals; Dirichlet edges contribute
+    //   nothing
+    ierr = UMEdgeNeighbors(mesh,&nbr); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        en = ae + 3*k;
         for (l = 0; l < 3; l++) {
-            if (abf[en[l]] == 2) { // set Dirichlet residual
-                xx = aloc[en[l]].x;   yy = aloc[en[l]].y;
-                aF[en[l]] = au[en[l]] - user->gD_fcn(xx,yy);
+            s = 3*k + l;
+            t = nbr[s];
+            if (t == -1 || (t >= 0 && t < s))
+                continue;
+            na = en[l];  nb = en[(l+1)%3];  nc = en[(l+2)%3];
+            dx = aloc[nb].x - aloc[na].x;
+            dy = aloc[nb].y - aloc[na].y;
+            len = PetscSqrtReal(dx * dx + dy * dy);
+            nx = dy / len;  ny = - dx / len;
+            xmid = 0.5 * (aloc[na].x + aloc[nb].x);
+            ymid = 0.5 * (aloc[na].y + aloc[nb].y);
+            umid = 0.5 * ( ((abf[na] == 2) ? user->gD[na] : au[na])
+                           + ((abf[nb] == 2) ? user->gD[nb] : au[nb]) );
+            if (t >= 0) {
+                jump = user->a_fcn(umid,xmid,ymid)
+                       * ((gux[k] - gux[t/3]) * nx + (guy[k] - guy[t/3]) * ny);
+                eta2[k] += 0.5 * len * len * jump * jump;
+                eta2[t/3] += 0.5 * len * len * jump * jump;
             } else {
-                sum = 0.0;
-                for (r = 0; r < q.n; r++) {
-                    psi = chi(l,q.xi[r],q.eta[r]);
-                    ip  = InnerProd(gradu,gradpsi[l]);
-                    sum += q.w[r] * ( aquad[r] * ip - fquad[r] * psi );
+                if (nx * (aloc[nc].x - xmid) + ny * (aloc[nc].y - ymid) > 0.0) {
+                    nx = - nx;  ny = - ny;  // outward
                 }
-                aF[en[l]] += PetscAbsReal(detJ) * sum;
+                jump = user->gN_fcn(xmid,ymid) - user->a_fcn(umid,xmid,ymid)
+                                                 * (gux[k] * nx + guy[k] * ny);
+                eta2[k] += len * len * jump * jump;
             }
         }
     }
 
-    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    ierr = UMRestoreNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
+    PetscFree(nbr);
+    PetscFree2(gux,guy);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    return 0;
+}
+
+
+/* P2 elements.  The basis values psi[l][r] and the gradient coefficients
+dpsi[l][r][i] (see dchi2()) at the quadrature points are tabulated once.  On
+each element the gradients of all six basis functions at all quadrature
+points are then formed in one batch from the three cached P1 gradients.   */
+static void P2Tables(const Quad2DTri *q, PetscReal psi[6][MAXPTS_TRI],
+                     PetscReal dpsi[6][MAXPTS_TRI][3]) {
+    PetscInt  l, r;
+    for (l = 0; l < 6; l++) {
+        for (r = 0; r < q->n; r++) {
+            psi[l][r] = chi2(l,q->xi[r],q->eta[r]);
+            dchi2(l,q->xi[r],q->eta[r],dpsi[l][r]);
+        }
+    }
+}
+
+static void P2Gradients(const UM *mesh, PetscInt k, PetscInt nq,
+                        PetscReal dpsi[6][MAXPTS_TRI][3],
+                        PetscReal gradpsi[6][MAXPTS_TRI][2]) {
+    const PetscInt  K = mesh->K;
+    PetscReal       gx[3], gy[3];
+    PetscInt        i, l, r;
+    for (i = 0; i < 3; i++) {
+        gx[i] = mesh->gpx[i*K+k];
+        gy[i] = mesh->gpy[i*K+k];
+    }
+    for (l = 0; l < 6; l++) {
+        for (r = 0; r < nq; r++) {
+            gradpsi[l][r][0] = dpsi[l][r][0] * gx[0] + dpsi[l][r][1] * gx[1]
+                               + dpsi[l][r][2] * gx[2];
+            gradpsi[l][r][1] = dpsi[l][r][0] * gy[0] + dpsi[l][r][1] * gy[1]
+                               + dpsi[l][r][2] * gy[2];
+        }
+    }
+}
+
+// as FormFunction() but for P2 elements; Neumann segments use 3-point
+//   Gauss-Legendre along the segment
+PetscErrorCode FormFunctionP2(SNES snes, Vec u, Vec F, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx         *user = (unfemCtx*)ctx;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const Quad1D     g = gausslegendre[2];
+    const PetscInt   *ae, *ans, *abf, *en, *sn;
+    const Node       *aloc;
+    const PetscReal  *au;
+    PetscInt         K = mesh->K, p, nc, c, jstart, jend, j, k, l, r;
+    PetscReal        *aF, unode[6], gradu[MAXPTS_TRI][2], uquad[MAXPTS_TRI],
+                     aquad[MAXPTS_TRI], fquad[MAXPTS_TRI],
+                     psiquad[6][MAXPTS_TRI], dpsiquad[6][MAXPTS_TRI][3],
+                     gradpsi[6][MAXPTS_TRI][2], psiseg[3], ls, sq, gNw,
+                     xx, yy, sum;
+
+    PetscLogStagePush(user->resstage);  //STRIP
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
+    ierr = VecSet(F,0.0); CHKERRQ(ierr);
+    ierr = VecGetArray(F,&aF); CHKERRQ(ierr);
+    ierr = UMGetNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    // Neumann boundary segment contributions (if any); sn[0], sn[1] are the
+    //   ends and sn[2] is the midpoint
+    if (mesh->P > 0) {
+        ierr = ISGetIndices(mesh->ns,&ans); CHKERRQ(ierr);
+        for (p = 0; p < mesh->P; p++) {
+            sn = ans + 3*p;
+            xx = aloc[sn[1]].x - aloc[sn[0]].x;
+            yy = aloc[sn[1]].y - aloc[sn[0]].y;
+            ls = PetscSqrtReal(xx * xx + yy * yy);
+            for (r = 0; r < g.n; r++) {
+                sq = 0.5 * (1.0 + g.xi[r]);  // in [0,1] from sn[0] to sn[1]
+                psiseg[0] = (1.0 - sq) * (1.0 - 2.0 * sq);
+                psiseg[1] = sq * (2.0 * sq - 1.0);
+                psiseg[2] = 4.0 * sq * (1.0 - sq);
+                gNw = 0.5 * ls * g.w[r]
+                      * user->gN_fcn(aloc[sn[0]].x + sq * xx, aloc[sn[0]].y + sq * yy);
+                for (l = 0; l < 3; l++) {
+                    if (abf[sn[l]] != 2 && sn[l] < mesh->Nown)
+                        aF[sn[l]] -= gNw * psiseg[l];
+                }
+            }
+        }
+        ierr = ISRestoreIndices(mesh->ns,&ans); CHKERRQ(ierr);
+    }
+
+    P2Tables(&q,psiquad,dpsiquad);
+
+    // element contributions and Dirichlet node residuals, by color as in
+    //   FormFunction()
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    nc = (mesh->ncolors > 0) ? mesh->ncolors : 1;
+    for (c = 0; c < nc; c++) {
+        jstart = (mesh->ncolors > 0) ? mesh->colorptr[c] : 0;
+        jend = (mesh->ncolors > 0) ? mesh->colorptr[c+1] : K;
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(k,en,l,r,unode,gradu,gradpsi,uquad,aquad,fquad,xx,yy,sum)
+#endif
+        for (j = jstart; j < jend; j++) {
+            k = (mesh->ncolors > 0) ? mesh->colorel[j] : j;
+            en = ae + 6*k;  // vertices en[0..2], edge midpoints en[3..5]
+            for (l = 0; l < 6; l++) {
+                if (abf[en[l]] == 2)  // enforces symmetry
+                    unode[l] = user->gD[en[l]];
+                else
+                    unode[l] = au[en[l]];
+            }
+            P2Gradients(mesh,k,q.n,dpsiquad,gradpsi);
+            // u, grad u, and function values at quadrature points
+            for (r = 0; r < q.n; r++) {
+                uquad[r] = 0.0;
+                gradu[r][0] = 0.0;
+                gradu[r][1] = 0.0;
+                for (l = 0; l < 6; l++) {
+                    uquad[r] += unode[l] * psiquad[l][r];
+                    gradu[r][0] += unode[l] * gradpsi[l][r][0];
+                    gradu[r][1] += unode[l] * gradpsi[l][r][1];
+                }
+                xx = mesh->xq[r*K+k];
+                yy = mesh->yq[r*K+k];
+                aquad[r] = user->a_fcn(uquad[r],xx,yy);
+                fquad[r] = user->f_fcn(uquad[r],xx,yy);
+            }
+            // residual contribution for each owned node of element
+            for (l = 0; l < 6; l++) {
+                if (en[l] >= mesh->Nown)
+                    continue;
+                if (abf[en[l]] == 2) { // set Dirichlet residual
+                    aF[en[l]] = au[en[l]] - user->gD[en[l]];
+                } else {
+                    sum = 0.0;
+                    for (r = 0; r < q.n; r++)
+                        sum += q.w[r] * ( aquad[r] * InnerProd(gradu[r],gradpsi[l][r])
+                                          - fquad[r] * psiquad[l][r] );
+                    aF[en[l]] += mesh->absdetJ[k] * sum;
+                }
+            }
+        }
+    }
+
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = UMRestoreNodeCoordArrayRead(mesh,&aloc); CHKERRQ(ierr);
     ierr = VecRestoreArray(F,&aF); CHKERRQ(ierr);
     PetscLogStagePop();  //STRIP
     return 0;
 }
-//ENDRESIDUAL
+
+// assemble the Picard matrix for P2 elements; the 6x6 element matrices
+//   need a(u) at each quadrature point, so there is no acoef[] shortcut
+static PetscErrorCode AssemblePicardP2(unfemCtx *user, Vec u, Mat P) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf, *en;
+    const PetscReal  *au;
+    PetscReal        unode[6], uquad, aw[MAXPTS_TRI], psiquad[6][MAXPTS_TRI],
+                     dpsiquad[6][MAXPTS_TRI][3], gradpsi[6][MAXPTS_TRI][2],
+                     v[36], sum;
+    PetscScalar      *pad = NULL, *pao = NULL;
+    PetscInt         K = mesh->K, n, k, l, m, r, cr, cc, cv, row[6], col[6], p;
+
+    P2Tables(&q,psiquad,dpsiquad);
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    if (user->e2nz) {
+        // write element matrices into the value arrays (-un_reuse)
+        ierr = PicardGetArrays(P,&pad,&pao); CHKERRQ(ierr);
+        ierr = PicardZeroArrays(user,abf,pad,pao); CHKERRQ(ierr);
+    } else {
+        ierr = MatZeroEntries(P); CHKERRQ(ierr);
+        for (n = 0; n < mesh->Nown; n++) {
+            if (abf[n] == 2) {
+                v[0] = 1.0;
+                ierr = MatSetValuesLocal(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
+            }
+        }
+    }
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
+        en = ae + 6*k;
+        for (l = 0; l < 6; l++) {
+            if (abf[en[l]] == 2)
+                unode[l] = user->gD[en[l]];
+            else
+                unode[l] = au[en[l]];
+        }
+        // weighted a(u) at quadrature points
+        for (r = 0; r < q.n; r++) {
+            uquad = 0.0;
+            for (l = 0; l < 6; l++)
+                uquad += unode[l] * psiquad[l][r];
+            aw[r] = mesh->absdetJ[k] * q.w[r]
+                    * user->a_fcn(uquad,mesh->xq[r*K+k],mesh->yq[r*K+k]);
+        }
+        P2Gradients(mesh,k,q.n,dpsiquad,gradpsi);
+        if (user->e2nz) {
+            for (l = 0; l < 6; l++) {
+                for (m = 0; m < 6; m++) {
+                    p = user->e2nz[36*k+6*l+m];
+                    if (p < 0)
+                        continue;
+                    sum = 0.0;
+                    for (r = 0; r < q.n; r++)
+                        sum += aw[r] * InnerProd(gradpsi[l][r],gradpsi[m][r]);
+                    if (p < user->nzdiag)
+                        pad[p] += sum;
+                    else
+                        pao[p-user->nzdiag] += sum;
+                }
+            }
+            continue;
+        }
+        // drop Dirichlet rows and columns, and rows for ghost nodes
+        cr = 0;  cc = 0;  cv = 0;  // cr,cc = count rows,cols; cv = entry counter
+        for (m = 0; m < 6; m++) {
+            if (abf[en[m]] != 2)
+                col[cc++] = en[m];
+        }
+        for (l = 0; l < 6; l++) {
+            if (abf[en[l]] != 2 && en[l] < mesh->Nown) {
+                row[cr++] = en[l];
+                for (m = 0; m < 6; m++) {
+                    if (abf[en[m]] != 2) {
+                        sum = 0.0;
+                        for (r = 0; r < q.n; r++)
+                            sum += aw[r] * InnerProd(gradpsi[l][r],gradpsi[m][r]);
+                        v[cv++] = sum;
+                    }
+                }
+            }
+        }
+        ierr = MatSetValuesLocal(P,cr,row,cc,col,v,ADD_VALUES); CHKERRQ(ierr);
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    if (user->e2nz) {
+        ierr = PicardRestoreArrays(P,&pad,&pao); CHKERRQ(ierr);
+    }
+
+    ierr = MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    return 0;
+}
 
 
 //STARTPICARD
+// assemble the Picard matrix on the mesh in user, at iterate u
+static PetscErrorCode AssemblePicard(unfemCtx *user, Vec u, Mat P) {
+    PetscErrorCode ierr;
+    UM               *mesh = user->mesh;
+    const Quad2DTri  q = symmgauss[user->quaddegree-1];
+    const PetscInt   *ae, *abf, *en;
+    const PetscReal  *au;
+    PetscReal        unode[3], gradpsi[3][2], uquad, v[9], asum,
+                     un[3][NB], uq[NB], aq[NB], as[NB], ps[3];
+    PetscScalar      *pad, *pao;
+    PetscInt         K = mesh->K, n, k, l, m, r, cr, cc, cv, row[3], col[3],
+                     nb, b, p;
+
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    // for P1 elements the gradients are constant so the element stiffness
+    //   matrix is acoef[k] * (grad psi_l . grad psi_m) where acoef[k] is the
+    //   integral of a(u,x,y) over element k; elements are independent so
+    //   this loop is threaded without coloring
+    if (user->batch) {
+        // as below, for NB consecutive elements at a time; the quadrature
+        //   point coordinates of these are contiguous in the geometry cache
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(nb,b,n,l,r,un,uq,aq,as,ps)
+#endif
+        for (k = 0; k < K; k += NB) {
+            nb = PetscMin(NB,K-k);
+            for (l = 0; l < 3; l++) {
+                for (b = 0; b < nb; b++) {
+                    n = ae[3*(k+b)+l];
+                    un[l][b] = (abf[n] == 2) ? user->gD[n] : au[n];
+                }
+            }
+            for (b = 0; b < nb; b++)
+                as[b] = 0.0;
+            for (r = 0; r < q.n; r++) {
+                for (l = 0; l < 3; l++)
+                    ps[l] = chi(l,q.xi[r],q.eta[r]);
+                PetscPragmaSIMD
+                for (b = 0; b < nb; b++)
+                    uq[b] = un[0][b] * ps[0] + un[1][b] * ps[1] + un[2][b] * ps[2];
+                user->a_batch(nb,uq,mesh->xq+r*K+k,mesh->yq+r*K+k,aq);
+                PetscPragmaSIMD
+                for (b = 0; b < nb; b++)
+                    as[b] += q.w[r] * aq[b];
+            }
+            PetscPragmaSIMD
+            for (b = 0; b < nb; b++)
+                user->acoef[k+b] = mesh->absdetJ[k+b] * as[b];
+        }
+    } else {
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(en,l,r,unode,uquad,asum)
+#endif
+        for (k = 0; k < K; k++) {
+            en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
+            for (l = 0; l < 3; l++) {
+                if (abf[en[l]] == 2)
+                    unode[l] = user->gD[en[l]];
+                else
+                    unode[l] = au[en[l]];
+            }
+            asum = 0.0;
+            for (r = 0; r < q.n; r++) {
+                uquad = eval(unode,q.xi[r],q.eta[r]);
+                asum += q.w[r] * user->a_fcn(uquad,mesh->xq[r*K+k],mesh->yq[r*K+k]);
+            }
+            user->acoef[k] = mesh->absdetJ[k] * asum;
+        }
+    }
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
+
+    // a MATSHELL (-un_matfree) applies the element matrices in PicardMult()
+    if (user->e2nz) {
+        // write element matrices into the value arrays (-un_reuse)
+        ierr = PicardGetArrays(P,&pad,&pao); CHKERRQ(ierr);
+        ierr = PicardZeroArrays(user,abf,pad,pao); CHKERRQ(ierr);
+        for (k = 0; k < K; k++) {
+            for (l = 0; l < 3; l++) {
+                gradpsi[l][0] = mesh->gpx[l*K+k];
+                gradpsi[l][1] = mesh->gpy[l*K+k];
+            }
+            for (l = 0; l < 3; l++) {
+                for (m = 0; m < 3; m++) {
+                    p = user->e2nz[9*k+3*l+m];
+                    if (p < 0)
+                        continue;
+                    if (p < user->nzdiag)
+                        pad[p] += user->acoef[k] * InnerProd(gradpsi[l],gradpsi[m]);
+                    else
+                        pao[p-user->nzdiag] += user->acoef[k] * InnerProd(gradpsi[l],gradpsi[m]);
+                }
+            }
+        }
+        ierr = PicardRestoreArrays(P,&pad,&pao); CHKERRQ(ierr);
+    } else if (!user->matfree) {
+        ierr = MatZeroEntries(P); CHKERRQ(ierr);
+        for (n = 0; n < mesh->Nown; n++) {
+            if (abf[n] == 2) {
+                v[0] = 1.0;
+                ierr = MatSetValuesLocal(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
+            }
+        }
+        // insert element matrices (MatSetValuesLocal() is not thread safe);
+        //   drop Dirichlet rows and columns, and rows for ghost nodes
+        for (k = 0; k < K; k++) {
+            en = ae + 3*k;
+            for (l = 0; l < 3; l++) {
+                gradpsi[l][0] = mesh->gpx[l*K+k];
+                gradpsi[l][1] = mesh->gpy[l*K+k];
+            }
+            cr = 0;  cc = 0;  cv = 0;  // cr,cc = count rows,cols; cv = entry counter
+            for (m = 0; m < 3; m++) {
+                if (abf[en[m]] != 2)
+                    col[cc++] = en[m];
+            }
+            for (l = 0; l < 3; l++) {
+                if (abf[en[l]] != 2 && en[l] < mesh->Nown) {
+                    row[cr++] = en[l];
+                    for (m = 0; m < 3; m++) {
+                        if (abf[en[m]] != 2)
+                            v[cv++] = user->acoef[k] * InnerProd(gradpsi[l],gradpsi[m]);
+                    }
+                }
+            }
+            ierr = MatSetValuesLocal(P,cr,row,cc,col,v,ADD_VALUES); CHKERRQ(ierr);
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+
+    ierr = MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    return 0;
+}
+
+/* Matrix-free application of the Picard matrix from the last FormPicard(),
+y = A x, using the element integrals acoef[] and the cached gradients.  Like
+the assembled matrix, Dirichlet rows are identity rows and Dirichlet columns
+are dropped.  As in FormFunction(), threads go through the elements by color.
+The local Vec uloc is reused for x.                                       */
+PetscErrorCode PicardMult(Mat A, Vec x, Vec y) {
+    PetscErrorCode ierr;
+    unfemCtx         *user;
+    UM               *mesh;
+    const PetscInt   *ae, *abf, *en;
+    const PetscReal  *ax;
+    PetscReal        *ay, gradpsi[3][2], sum;
+    PetscInt         K, n, nc, c, jstart, jend, j, k, l, m;
+
+    ierr = MatShellGetContext(A,&user); CHKERRQ(ierr);
+    mesh = user->mesh;
+    K = mesh->K;
+    ierr = UMGlobalToLocal(mesh,x,user->uloc); CHKERRQ(ierr);
+    ierr = VecSet(y,0.0); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(user->uloc,&ax); CHKERRQ(ierr);
+    ierr = VecGetArray(y,&ay); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        if (abf[n] == 2)
+            ay[n] = ax[n];
+    }
+    nc = (mesh->ncolors > 0) ? mesh->ncolors : 1;
+    for (c = 0; c < nc; c++) {
+        jstart = (mesh->ncolors > 0) ? mesh->colorptr[c] : 0;
+        jend = (mesh->ncolors > 0) ? mesh->colorptr[c+1] : K;
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(user->threads) private(k,en,l,m,gradpsi,sum)
+#endif
+        for (j = jstart; j < jend; j++) {
+            k = (mesh->ncolors > 0) ? mesh->colorel[j] : j;
+            en = ae + 3*k;
+            for (l = 0; l < 3; l++) {
+                gradpsi[l][0] = mesh->gpx[l*K+k];
+                gradpsi[l][1] = mesh->gpy[l*K+k];
+            }
+            for (l = 0; l < 3; l++) {
+                if (abf[en[l]] == 2 || en[l] >= mesh->Nown)
+                    continue;
+                sum = 0.0;
+                for (m = 0; m < 3; m++) {
+                    if (abf[en[m]] != 2)
+                        sum += InnerProd(gradpsi[l],gradpsi[m]) * ax[en[m]];
+                }
+                ay[en[l]] += user->acoef[k] * sum;
+            }
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArray(y,&ay); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&ax); CHKERRQ(ierr);
+    return 0;
+}
+
+// diagonal of the matrix-free Picard matrix, e.g. for PCJACOBI or Chebyshev
+PetscErrorCode PicardGetDiagonal(Mat A, Vec d) {
+    PetscErrorCode ierr;
+    unfemCtx         *user;
+    UM               *mesh;
+    const PetscInt   *ae, *abf, *en;
+    PetscReal        *ad;
+    PetscInt         K, n, k, l;
+
+    ierr = MatShellGetContext(A,&user); CHKERRQ(ierr);
+    mesh = user->mesh;
+    K = mesh->K;
+    ierr = VecGetArray(d,&ad); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++)
+        ad[n] = (abf[n] == 2) ? 1.0 : 0.0;
+    for (k = 0; k < K; k++) {
+        en = ae + 3*k;
+        for (l = 0; l < 3; l++) {
+            if (abf[en[l]] != 2 && en[l] < mesh->Nown)
+                ad[en[l]] += user->acoef[k]
+                             * (mesh->gpx[l*K+k] * mesh->gpx[l*K+k]
+                                + mesh->gpy[l*K+k] * mesh->gpy[l*K+k]);
+        }
+    }
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArray(d,&ad); CHKERRQ(ierr);
+    return 0;
+}
+
 PetscErrorCode FormPicard(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
+    PetscErrorCode ierr;
+    unfemCtx  *user = (unfemCtx*)ctx;
+    PetscInt  l;
+
+    PetscLogStagePush(user->jacstage);  //STRIP
+    if (user->mesh->nen == 6) {
+        ierr = AssemblePicardP2(user,u,P); CHKERRQ(ierr);
+    } else {
+        ierr = AssemblePicard(user,u,P); CHKERRQ(ierr);
+    }
+    // for geometric multigrid, rediscretize on coarser levels using the
+    //   iterate injected to each level
+    for (l = user->mglevels-2; l >= 0; l--) {
+        Vec  ufine = (l == user->mglevels-2) ? u : user->mgu[l+1];
+        ierr = VecScatterBegin(user->mginject[l],ufine,user->mgu[l],
+                               INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+        ierr = VecScatterEnd(user->mginject[l],ufine,user->mgu[l],
+                             INSERT_VALUES,SCATTER_FORWARD); CHKERRQ(ierr);
+        ierr = AssemblePicard(&(user->mgctx[l]),user->mgu[l],user->mgA[l]); CHKERRQ(ierr);
+    }
+    if (A != P) {
+        ierr = MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    PetscLogStagePop();  //STRIP
+    return 0;
+}
+//ENDPICARD
+
+
+/* Newton Jacobian of the residual in FormFunction().  For a non-Dirichlet
+node j of element k, the derivative of the element residual for node l is
+    int_k a(u) grad psi_j . grad psi_l + a'(u) psi_j grad u . grad psi_l
+          - f'(u) psi_j psi_l
+where a' = da/du and f' = df/du.  The first term is the Picard matrix.  As
+there, Dirichlet rows are identity rows and Dirichlet columns are dropped,
+because FormFunction() uses g_D in place of u at Dirichlet nodes.       */
+PetscErrorCode FormNewtonJacobian(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
     PetscErrorCode ierr;
     unfemCtx         *user = (unfemCtx*)ctx;
+    UM               *mesh = user->mesh;
     const Quad2DTri  q = symmgauss[user->quaddegree-1];
     const PetscInt   *ae, *abf, *en;
-    const Node       *aloc;
     const PetscReal  *au;
-    PetscReal        unode[3], gradpsi[3][2], uquad[4], aquad[4], v[9],
-                     dx1, dx2, dy1, dy2, detJ, xx, yy, sum;
-    PetscInt         n, k, l, m, r, cr, cv, row[3];
+    PetscReal        unode[3], gradu[2], gradpsi[3][2], psiquad[3][MAXPTS_TRI],
+                     uquad, xx, yy, asum, dasum[3], dfsum[3][3], ip, v[9];
+    PetscInt         K = mesh->K, n, k, l, m, r, cr, cc, cv, row[3], col[3];
 
     PetscLogStagePush(user->jacstage);  //STRIP
+    for (l = 0; l < 3; l++)
+        for (r = 0; r < q.n; r++)
+            psiquad[l][r] = chi(l,q.xi[r],q.eta[r]);
+    ierr = UMGlobalToLocal(mesh,u,user->uloc); CHKERRQ(ierr);
     ierr = MatZeroEntries(P); CHKERRQ(ierr);
-    ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    for (n = 0; n < user->mesh->N; n++) {
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
         if (abf[n] == 2) {
             v[0] = 1.0;
-            ierr = MatSetValues(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
+            ierr = MatSetValuesLocal(P,1,&n,1,&n,v,ADD_VALUES); CHKERRQ(ierr);
         }
     }
-    ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = VecGetArrayRead(u,&au); CHKERRQ(ierr);
-    ierr = UMGetNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
-    for (k = 0; k < user->mesh->K; k++) {
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = VecGetArrayRead(user->uloc,&au); CHKERRQ(ierr);
+    for (k = 0; k < K; k++) {
         en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        // geometry of element
-        dx1 = aloc[en[1]].x - aloc[en[0]].x;
-        dx2 = aloc[en[2]].x - aloc[en[0]].x;
-        dy1 = aloc[en[1]].y - aloc[en[0]].y;
-        dy2 = aloc[en[2]].y - aloc[en[0]].y;
-        detJ = dx1 * dy2 - dx2 * dy1;
-        // gradients of hat functions and u on element
+        gradu[0] = 0.0;
+        gradu[1] = 0.0;
         for (l = 0; l < 3; l++) {
-            gradpsi[l][0] = ( dy2 * dchi[l][0] - dy1 * dchi[l][1]) / detJ;
-            gradpsi[l][1] = (-dx2 * dchi[l][0] + dx1 * dchi[l][1]) / detJ;
+            gradpsi[l][0] = mesh->gpx[l*K+k];
+            gradpsi[l][1] = mesh->gpy[l*K+k];
             if (abf[en[l]] == 2)
-                unode[l] = user->gD_fcn(aloc[en[l]].x,aloc[en[l]].y);
+                unode[l] = user->gD[en[l]];
             else
                 unode[l] = au[en[l]];
+            gradu[0] += unode[l] * gradpsi[l][0];
+            gradu[1] += unode[l] * gradpsi[l][1];
+        }
+        // quadrature:  asum = int a,  dasum[m] = int a' psi_m,
+        //   dfsum[l][m] = int f' psi_l psi_m
+        asum = 0.0;
+        for (m = 0; m < 3; m++) {
+            dasum[m] = 0.0;
+            for (l = 0; l < 3; l++)
+                dfsum[l][m] = 0.0;
         }
-        // function values at quadrature points on element
         for (r = 0; r < q.n; r++) {
-            uquad[r] = eval(unode,q.xi[r],q.eta[r]);
-            xx = aloc[en[0]].x + dx1 * q.xi[r] + dx2 * q.eta[r];
-            yy = aloc[en[0]].y + dy1 * q.xi[r] + dy2 * q.eta[r];
-            aquad[r] = user->a_fcn(uquad[r],xx,yy);
+            uquad = eval(unode,q.xi[r],q.eta[r]);
+            xx = mesh->xq[r*K+k];
+            yy = mesh->yq[r*K+k];
+            asum += q.w[r] * user->a_fcn(uquad,xx,yy);
+            ip = q.w[r] * user->dadu_fcn(uquad,xx,yy);
+            for (m = 0; m < 3; m++)
+                dasum[m] += ip * psiquad[m][r];
+            ip = q.w[r] * user->dfdu_fcn(uquad,xx,yy);
+            for (l = 0; l < 3; l++)
+                for (m = 0; m < 3; m++)
+                    dfsum[l][m] += ip * psiquad[l][r] * psiquad[m][r];
+        }
+        // element Jacobian; rows only for owned non-Dirichlet nodes
+        cr = 0;  cc = 0;  cv = 0;  // cr,cc = count rows,cols; cv = entry counter
+        for (m = 0; m < 3; m++) {
+            if (abf[en[m]] != 2)
+                col[cc++] = en[m];
         }
-        // generate 3x3 element stiffness matrix (may be smaller)
-        cr = 0;  cv = 0;  // cr = count rows; cv = entry counter
         for (l = 0; l < 3; l++) {
-            if (abf[en[l]] != 2) {
+            if (abf[en[l]] != 2 && en[l] < mesh->Nown) {
                 row[cr++] = en[l];
+                ip = InnerProd(gradu,gradpsi[l]);
                 for (m = 0; m < 3; m++) {
-                    if (abf[en[m]] != 2) {
-                        sum = 0.0;
-                        for (r = 0; r < q.n; r++) {
-                            sum += q.w[r] * aquad[r]
-                                   * InnerProd(gradpsi[l],gradpsi[m]);
-                        }
-                        v[cv++] = PetscAbsReal(detJ) * sum;
-                    }
+                    if (abf[en[m]] != 2)
+                        v[cv++] = mesh->absdetJ[k]
+                                  * ( asum * InnerProd(gradpsi[l],gradpsi[m])
+                                      + dasum[m] * ip - dfsum[l][m] );
                 }
             }
         }
-        ierr = MatSetValues(P,cr,row,cr,row,v,ADD_VALUES); CHKERRQ(ierr);
+        ierr = MatSetValuesLocal(P,cr,row,cc,col,v,ADD_VALUES); CHKERRQ(ierr);
     }
-    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    ierr = VecRestoreArrayRead(u,&au); CHKERRQ(ierr);
-    ierr = UMRestoreNodeCoordArrayRead(user->mesh,&aloc); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = VecRestoreArrayRead(user->uloc,&au); CHKERRQ(ierr);
 
     ierr = MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
     ierr = MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
@@ -490,67 +2132,117 @@ PetscErrorCode FormPicard(SNES snes, Vec u, Mat A, Mat P, void *ctx) {
     PetscLogStagePop();  //STRIP
     return 0;
 }
-//ENDPICARD
 
 
-/* The following procedure is accomplishes essentially the same actions
-as DMCreateMatrix() when a DM is present.  It first preallocates storage
-for the sparse matrix by providing a count of the entries.  Then it
-actually sets the sparsity pattern by inserting zeros--ironically--where
-there will be nonzero entries.  This means that -snes_fd_color can be used.
-
-Note that nnz[n] is the number of nonzeros in row n.  In our case it
-equals one for Dirichlet rows, it is one more than the number of incident
-triangles for an interior point, and it is two more than the number of
-incident triangles for Neumann boundary nodes. */
+/* The following procedure accomplishes essentially the same actions as
+DMCreateMatrix() when a DM is present.  It builds the node adjacency graph
+for the owned rows in CSR form:  the columns of row n are the free
+(non-Dirichlet) nodes of the elements which touch node n, sorted and with
+repeats removed, while a Dirichlet row has only its diagonal entry.  This is
+exact for both P1 and P2 elements, and because every element touching an
+owned node is on this process (see UMDistribute()), the rows are complete.
+Rows and columns are numbered by ltog, and nodes it maps to -1 (Dirichlet
+nodes, for the reduced matrix of -un_eliminate_dirichlet) are left out.
+The CSR arrays, with global column indices and zero values, preallocate the
+matrix and set its sparsity pattern in one call, so -snes_fd_color can be
+used.  For SBAIJ storage each row keeps only its upper triangle, i.e. the
+columns with global index at least that of the row. */
 //STARTPREALLOC
-PetscErrorCode PreallocateAndSetNonzeros(Mat J, unfemCtx *user) {
+PetscErrorCode PreallocateAndSetNonzeros(Mat J, ISLocalToGlobalMapping ltog,
+                                         unfemCtx *user) {
     PetscErrorCode ierr;
-    const PetscInt  *ae, *abf, *en;
-    PetscInt        *nnz, n, k, l, cr, row[3];
-    PetscReal       zero = 0.0,
-                    v[9] = {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
-
-    // preallocate: set number of nonzeros per row
-    ierr = ISGetIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
-    ierr = ISGetIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = PetscMalloc1(user->mesh->N,&nnz); CHKERRQ(ierr);
-    for (n = 0; n < user->mesh->N; n++)
-        nnz[n] = (abf[n] == 1) ? 2 : 1;
-    for (k = 0; k < user->mesh->K; k++) {
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        for (l = 0; l < 3; l++)
-            if (abf[en[l]] != 2)
-                nnz[en[l]] += 1;
+    UM              *mesh = user->mesh;
+    const PetscInt  *ae, *abf, *en, *gidx, nen = mesh->nen;
+    PetscInt        *ia, *ja, *next, n, k, l, m, r, len, nz, nrows, rstart;
+    PetscReal       *aa;
+    PetscBool       sbaij;
+
+    ierr = PetscObjectTypeCompareAny((PetscObject)J,&sbaij,
+               MATSBAIJ,MATSEQSBAIJ,MATMPISBAIJ,""); CHKERRQ(ierr);
+    ierr = PicardOwnedRows(mesh,ltog,&nrows,&rstart); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingGetIndices(ltog,&gidx); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISGetIndices(mesh->e,&ae); CHKERRQ(ierr);
+
+    // count the entries in each owned row, with repeats; owned node n is
+    //   row r = gidx[n] - rstart
+    ierr = PetscCalloc2(nrows+1,&ia,nrows,&next); CHKERRQ(ierr);
+    for (n = 0; n < mesh->Nown; n++) {
+        if (abf[n] == 2 && gidx[n] >= 0)
+            ia[gidx[n]-rstart+1] = 1;
     }
-    ierr = MatSeqAIJSetPreallocation(J,-1,nnz); CHKERRQ(ierr);
-    ierr = PetscFree(nnz); CHKERRQ(ierr);
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + nen*k;
+        for (l = 0; l < nen; l++) {
+            if (abf[en[l]] != 2 && en[l] < mesh->Nown) {
+                r = gidx[en[l]] - rstart;
+                for (m = 0; m < nen; m++) {
+                    if (abf[en[m]] != 2
+                        && (!sbaij || gidx[en[m]] >= gidx[en[l]]))
+                        ia[r+1]++;
+                }
+            }
+        }
+    }
+    for (r = 0; r < nrows; r++)
+        ia[r+1] += ia[r];
 
-    // set nonzeros: put values (=zeros) in allocated locations
-    for (n = 0; n < user->mesh->N; n++) {
-        if (abf[n] == 2) {
-            ierr = MatSetValues(J,1,&n,1,&n,&zero,INSERT_VALUES); CHKERRQ(ierr);
+    // fill in global column indices
+    ierr = PetscMalloc1(ia[nrows],&ja); CHKERRQ(ierr);
+    for (r = 0; r < nrows; r++)
+        next[r] = ia[r];
+    for (n = 0; n < mesh->Nown; n++) {
+        if (abf[n] == 2 && gidx[n] >= 0) {
+            r = gidx[n] - rstart;
+            ja[next[r]++] = gidx[n];
         }
     }
-    for (k = 0; k < user->mesh->K; k++) {
-        en = ae + 3*k;  // en[0], en[1], en[2] are nodes of element k
-        // a 3x3 element stiffness matrix (at most) for each element
-        cr = 0;  // cr = count rows
-        for (l = 0; l < 3; l++) {
-            if (abf[en[l]] != 2) {
-                row[cr++] = en[l];
+    for (k = 0; k < mesh->K; k++) {
+        en = ae + nen*k;
+        for (l = 0; l < nen; l++) {
+            if (abf[en[l]] != 2 && en[l] < mesh->Nown) {
+                r = gidx[en[l]] - rstart;
+                for (m = 0; m < nen; m++) {
+                    if (abf[en[m]] != 2
+                        && (!sbaij || gidx[en[m]] >= gidx[en[l]]))
+                        ja[next[r]++] = gidx[en[m]];
+                }
             }
         }
-        ierr = MatSetValues(J,cr,row,cr,row,v,INSERT_VALUES); CHKERRQ(ierr);
     }
-    ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
-    ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->e,&ae); CHKERRQ(ierr);
+    ierr = ISRestoreIndices(mesh->bf,&abf); CHKERRQ(ierr);
+    ierr = ISLocalToGlobalMappingRestoreIndices(ltog,&gidx); CHKERRQ(ierr);
+
+    // sort each row and remove repeats, compacting ia[] and ja[] in place;
+    //   row r starts at the old ia[r], which is read before it is reset
+    nz = 0;
+    for (r = 0; r < nrows; r++) {
+        len = ia[r+1] - ia[r];
+        ierr = PetscSortRemoveDupsInt(&len,ja+ia[r]); CHKERRQ(ierr);
+        ierr = PetscArraymove(ja+nz,ja+ia[r],len); CHKERRQ(ierr);
+        ia[r] = nz;
+        nz += len;
+    }
+    ia[nrows] = nz;
+
+    // preallocate and set nonzeros (=zeros) at once; only the call
+    //   matching the type of J has an effect, and it assembles J
+    ierr = PetscCalloc1(nz,&aa); CHKERRQ(ierr);
+    ierr = MatSeqAIJSetPreallocationCSR(J,ia,ja,aa); CHKERRQ(ierr);
+    ierr = MatMPIAIJSetPreallocationCSR(J,ia,ja,aa); CHKERRQ(ierr);
+    ierr = MatSeqSBAIJSetPreallocationCSR(J,1,ia,ja,aa); CHKERRQ(ierr);
+    ierr = MatMPISBAIJSetPreallocationCSR(J,1,ia,ja,aa); CHKERRQ(ierr);
+    ierr = PetscFree2(ia,next); CHKERRQ(ierr);
+    ierr = PetscFree(ja); CHKERRQ(ierr);
+    ierr = PetscFree(aa); CHKERRQ(ierr);
+    ierr = MatSetLocalToGlobalMapping(J,ltog,ltog); CHKERRQ(ierr);
+    if (sbaij) {
+        ierr = MatSetOption(J,MAT_IGNORE_LOWER_TRIANGULAR,PETSC_TRUE); CHKERRQ(ierr);
+    }
     // the assembly routine FormPicard() will generate an error if
     //   it tries to put a matrix entry in the wrong place
     ierr = MatSetOption(J,MAT_NEW_NONZERO_LOCATION_ERR,PETSC_TRUE); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->e,&ae); CHKERRQ(ierr);
-    ierr = ISRestoreIndices(user->mesh->bf,&abf); CHKERRQ(ierr);
     return 0;
 }
 //ENDPREALLOC
-
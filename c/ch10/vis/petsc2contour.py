@@ -64,9 +64,13 @@ print('reading solution from file %s ...' % (root+'.soln'))
 objecttype = io.readObjectType(solnfile)
 if objecttype == 'Vec':
     u = io.readVec(solnfile)
-    if len(u) != N:
+    if len(u) < N:
         print('ERROR: solution vec is wrong size ... stopping')
         sys.exit()
+    elif len(u) > N:
+        # from unfem -un_order 2; edge midpoint values follow node values
+        print('using first %d of %d solution values (P2 solution) ...' % (N,len(u)))
+        u = u[:N]
 else:
     print('ERROR: no valid .soln file ... stopping')
     sys.exit()
@@ -100,6 +100,8 @@ int main(int argc,char **argv) {
   user.cy = 1.0;
   user.cz = 1.0;
   user.g_bdry = &g_fcn;
+  user.cache_bdry = PETSC_FALSE;
+  user.k_coeff = NULL;
   user.f_rhs = &zero;
   user.addctx = NULL;
   ierr = DMSetApplicationContext(da,&user);CHKERRQ(ierr);
@@ -113,6 +113,8 @@ int main(int argc,char **argv) {
   user.cy = 1.0;
   user.cz = 1.0;
   user.g_bdry = &g_fcn;
+  user.cache_bdry = PETSC_FALSE;
+  user.k_coeff = NULL;
   user.f_rhs = &f_fcn;
   user.addctx = &dctx;
 
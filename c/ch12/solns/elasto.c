@@ -78,6 +78,8 @@ int main(int argc,char **argv) {
   user.cy = 1.0;
   user.cz = 1.0;
   user.g_bdry = &zero;
+  user.cache_bdry = PETSC_FALSE;
+  user.k_coeff = NULL;
   user.f_rhs = &f_fcn;
   user.addctx = &elasto;
   ierr = DMSetApplicationContext(da,&user);CHKERRQ(ierr);
@@ -2,8 +2,9 @@ static char help[] =
 "Solves structured-grid Poisson problem in 1D, 2D, 3D.  Option prefix fsh_.\n"
 "Equation is\n"
 "    - cx u_xx - cy u_yy - cz u_zz = f,\n"
-"subject to Dirichlet boundary conditions.  Solves three different problems\n"
-"where exact solution is known.  Uses DMDA and SNES.  Equation is put in form\n"
+"subject to Dirichlet boundary conditions.  Solves four different problems\n"
+"where exact solution is known, one (manuvar) with variable coefficient\n"
+"- div (k grad u).  Uses DMDA and SNES.  Equation is put in form\n"
 "F(u) = - grad^2 u - f.  Call-backs fully-rediscretize for the supplied grid.\n"
 "Defaults to 2D, a SNESType of KSPONLY, and a KSPType of CG.\n\n";
 
@@ -81,6 +82,53 @@ static PetscReal f_rhs_3Dmanuexp(PetscReal x, PetscReal y, PetscReal z, void *ct
     return 2.0 * x * PetscExpReal(y + z);  // note  f = - laplacian u = - 2 u
 }
 
+// problem manuvar has the manupoly exact solution but variable coefficient
+//   k(x,y,z) = 1 + x^2 + y^2 + z^2, so  f = - div (k grad u)
+
+static PetscReal k_manuvar(PetscReal x, PetscReal y, PetscReal z, void *ctx) {
+    return 1.0 + x*x + y*y + z*z;
+}
+
+static PetscReal f_rhs_1Dmanuvar(PetscReal x, PetscReal y, PetscReal z, void *ctx) {
+    PoissonCtx* user = (PoissonCtx*)ctx;
+    PetscReal   daa, ddaa;
+    daa = 2.0 * x * (1.0 - 2.0 * x*x);
+    ddaa = 2.0 * (1.0 - 6.0 * x*x);
+    return - user->cx * (k_manuvar(x,y,z,ctx) * ddaa + 2.0 * x * daa);
+}
+
+static PetscReal f_rhs_2Dmanuvar(PetscReal x, PetscReal y, PetscReal z, void *ctx) {
+    PoissonCtx* user = (PoissonCtx*)ctx;
+    PetscReal   k, aa, bb, daa, dbb, ddaa, ddbb;
+    k = k_manuvar(x,y,z,ctx);
+    aa = x*x * (1.0 - x*x);
+    bb = y*y * (y*y - 1.0);
+    daa = 2.0 * x * (1.0 - 2.0 * x*x);
+    dbb = 2.0 * y * (2.0 * y*y - 1.0);
+    ddaa = 2.0 * (1.0 - 6.0 * x*x);
+    ddbb = 2.0 * (6.0 * y*y - 1.0);
+    return - user->cx * (k * ddaa + 2.0 * x * daa) * bb
+           - user->cy * aa * (k * ddbb + 2.0 * y * dbb);
+}
+
+static PetscReal f_rhs_3Dmanuvar(PetscReal x, PetscReal y, PetscReal z, void *ctx) {
+    PoissonCtx* user = (PoissonCtx*)ctx;
+    PetscReal   k, aa, bb, cc, daa, dbb, dcc, ddaa, ddbb, ddcc;
+    k = k_manuvar(x,y,z,ctx);
+    aa = x*x * (1.0 - x*x);
+    bb = y*y * (y*y - 1.0);
+    cc = z*z * (z*z - 1.0);
+    daa = 2.0 * x * (1.0 - 2.0 * x*x);
+    dbb = 2.0 * y * (2.0 * y*y - 1.0);
+    dcc = 2.0 * z * (2.0 * z*z - 1.0);
+    ddaa = 2.0 * (1.0 - 6.0 * x*x);
+    ddbb = 2.0 * (6.0 * y*y - 1.0);
+    ddcc = 2.0 * (6.0 * z*z - 1.0);
+    return - user->cx * (k * ddaa + 2.0 * x * daa) * bb * cc
+           - user->cy * aa * (k * ddbb + 2.0 * y * dbb) * cc
+           - user->cz * aa * bb * (k * ddcc + 2.0 * z * dcc);
+}
+
 // functions simply to put u_exact()=g_bdry() into a grid
 // these are irritatingly-dimension-dependent inside ...
 extern PetscErrorCode Form1DUExact(DMDALocalInfo*, Vec, PoissonCtx*);
@@ -105,26 +153,84 @@ static ExactFcnVec getuexact_ptr[3]
     = {&Form1DUExact, &Form2DUExact, &Form3DUExact};
 //ENDPTRARRAYS
 
-typedef enum {MANUPOLY, MANUEXP, ZERO} ProblemType;
-static const char* ProblemTypes[] = {"manupoly","manuexp","zero",
+typedef enum {MANUPOLY, MANUEXP, ZERO, MANUVAR} ProblemType;
+static const char* ProblemTypes[] = {"manupoly","manuexp","zero","manuvar",
                                      "ProblemType", "", NULL};
 
 // more arrays of pointers to functions:   ..._ptr[DIMS][PROBLEMS]
 typedef PetscReal (*PointwiseFcn)(PetscReal,PetscReal,PetscReal,void*);
 
-static PointwiseFcn g_bdry_ptr[3][3]
-    = {{&u_exact_1Dmanupoly, &u_exact_1Dmanuexp, &zero},
-       {&u_exact_2Dmanupoly, &u_exact_2Dmanuexp, &zero},
-       {&u_exact_3Dmanupoly, &u_exact_3Dmanuexp, &zero}};
+static PointwiseFcn g_bdry_ptr[3][4]
+    = {{&u_exact_1Dmanupoly, &u_exact_1Dmanuexp, &zero, &u_exact_1Dmanupoly},
+       {&u_exact_2Dmanupoly, &u_exact_2Dmanuexp, &zero, &u_exact_2Dmanupoly},
+       {&u_exact_3Dmanupoly, &u_exact_3Dmanuexp, &zero, &u_exact_3Dmanupoly}};
 
-static PointwiseFcn f_rhs_ptr[3][3]
-    = {{&f_rhs_1Dmanupoly, &f_rhs_1Dmanuexp, &zero},
-       {&f_rhs_2Dmanupoly, &f_rhs_2Dmanuexp, &zero},
-       {&f_rhs_3Dmanupoly, &f_rhs_3Dmanuexp, &zero}};
+static PointwiseFcn f_rhs_ptr[3][4]
+    = {{&f_rhs_1Dmanupoly, &f_rhs_1Dmanuexp, &zero, &f_rhs_1Dmanuvar},
+       {&f_rhs_2Dmanupoly, &f_rhs_2Dmanuexp, &zero, &f_rhs_2Dmanuvar},
+       {&f_rhs_3Dmanupoly, &f_rhs_3Dmanuexp, &zero, &f_rhs_3Dmanuvar}};
 
 static const char* InitialTypes[] = {"zeros","random",
                                      "InitialType", "", NULL};
 
+// time N evaluations of each 3D residual kernel on u (without the ghost
+//   update); the stencil pass uses f = 0, so that evaluating f (e.g. exp()
+//   for manuexp) does not count, and is reported as points/s and the memory
+//   bandwidth implied by reading u and writing F once per point (compare with
+//   "make streams"); the full residual, with the problem's f, is reported as
+//   points/s only
+static PetscErrorCode BenchResidual3D(DM da, Vec u, PoissonCtx *user,
+                                      PetscInt N) {
+    PetscErrorCode ierr;
+    DMDASNESFunction fcn[2] = {(DMDASNESFunction)&Poisson3DFunctionLocal,
+                               (DMDASNESFunction)&Poisson3DFunctionLocalBlocked};
+    const char     *name[2] = {"plain  ", "blocked"};
+    DMDALocalInfo  info;
+    PoissonCtx     stencil = *user;
+    PoissonCtx     *ctx[2] = {&stencil, user};
+    Vec            uloc, F[2];
+    PetscReal      ***au, ***aF, t, tmax[2], diff, points;
+    PetscLogDouble t0, t1;
+    PetscInt       i, m, p;
+
+    stencil.f_rhs = &zero;
+
+    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
+    ierr = DMGetLocalVector(da,&uloc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalBegin(da,u,INSERT_VALUES,uloc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalEnd(da,u,INSERT_VALUES,uloc); CHKERRQ(ierr);
+    ierr = DMDAVecGetArrayRead(da,uloc,&au); CHKERRQ(ierr);
+    points = (PetscReal)info.mx * info.my * info.mz;
+    for (m = 0; m < 2; m++) {
+        ierr = DMCreateGlobalVector(da,&(F[m])); CHKERRQ(ierr);
+        ierr = DMDAVecGetArray(da,F[m],&aF); CHKERRQ(ierr);
+        for (p = 0; p < 2; p++) {  // p = 0: stencil only;  p = 1: with f
+            ierr = MPI_Barrier(PETSC_COMM_WORLD); CHKERRQ(ierr);
+            ierr = PetscTime(&t0); CHKERRQ(ierr);
+            for (i = 0; i < N; i++) {
+                ierr = (*fcn[m])(&info,au,aF,ctx[p]); CHKERRQ(ierr);
+            }
+            ierr = PetscTime(&t1); CHKERRQ(ierr);
+            t = t1 - t0;
+            ierr = MPI_Allreduce(&t,&(tmax[p]),1,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD); CHKERRQ(ierr);
+        }
+        ierr = DMDAVecRestoreArray(da,F[m],&aF); CHKERRQ(ierr);
+        ierr = PetscPrintf(PETSC_COMM_WORLD,
+                   "  residual %s:  stencil (f = 0) %.3e points/s, %.2f GB/s;  with f %.3e points/s\n",
+                   name[m],N * points / tmax[0],
+                   2.0 * sizeof(PetscReal) * N * points / tmax[0] / 1.0e9,
+                   N * points / tmax[1]); CHKERRQ(ierr);
+    }
+    ierr = DMDAVecRestoreArrayRead(da,uloc,&au); CHKERRQ(ierr);
+    ierr = DMRestoreLocalVector(da,&uloc); CHKERRQ(ierr);
+    ierr = VecAXPY(F[1],-1.0,F[0]); CHKERRQ(ierr);
+    ierr = VecNorm(F[1],NORM_INFINITY,&diff); CHKERRQ(ierr);
+    ierr = PetscPrintf(PETSC_COMM_WORLD,
+               "  |F_plain - F_blocked|_inf = %.2e\n",diff); CHKERRQ(ierr);
+    VecDestroy(&(F[0]));  VecDestroy(&(F[1]));
+    return 0;
+}
+
 int main(int argc,char **argv) {
     PetscErrorCode ierr;
     DM             da, da_after;
@@ -139,9 +245,14 @@ int main(int argc,char **argv) {
 
     // fish defaults:
     PetscInt       dim = 2;                  // 2D
+    PetscInt       bench = 0;                // no residual benchmark
+    PetscInt       order = 2;                // 5-point/7-point stencils
     ProblemType    problem = MANUEXP;        // manufactured problem using exp()
     InitialType    initial = ZEROS;          // set u=0 for initial iterate
     PetscBool      gonboundary = PETSC_TRUE; // initial iterate has u=g on boundary
+    PetscBool      blocked = PETSC_FALSE,    // plain 3D residual kernel
+                   matfree = PETSC_FALSE,    // assembled Jacobian
+                   levelspcset;
 
     ierr = PetscInitialize(&argc,&argv,NULL,help); if (ierr) return ierr;
 
@@ -152,7 +263,17 @@ int main(int argc,char **argv) {
     user.cx = 1.0;
     user.cy = 1.0;
     user.cz = 1.0;
+    user.cache_bdry = PETSC_FALSE;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD,"fsh_", "options for fish.c", ""); CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-bench_residual",
+         "before solving, time this many evaluations of each 3D residual kernel and report memory bandwidth of the stencil pass (with f = 0)",
+         "fish.c",bench,&bench,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-blocked",
+         "use the cache-blocked, vectorizable 3D residual Poisson3DFunctionLocalBlocked()",
+         "fish.c",blocked,&blocked,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-cache_bdry",
+         "evaluate boundary function g only once per grid; see PoissonGetBoundaryCache()",
+         "fish.c",user.cache_bdry,&user.cache_bdry,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsReal("-cx",
          "set coefficient of x term u_xx in equation",
          "fish.c",user.cx,&user.cx,NULL);CHKERRQ(ierr);
@@ -171,6 +292,9 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsEnum("-initial_type",
          "type of initial iterate",
          "fish.c",InitialTypes,(PetscEnum)initial,(PetscEnum*)&initial,NULL); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-matfree",
+         "apply Jacobian as MATSHELL; only the coarsest PCMG level is assembled",
+         "fish.c",matfree,&matfree,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsReal("-Lx",
          "set Lx in domain ([0,Lx] x [0,Ly] x [0,Lz], etc.)",
          "fish.c",user.Lx,&user.Lx,NULL);CHKERRQ(ierr);
@@ -180,15 +304,49 @@ int main(int argc,char **argv) {
     ierr = PetscOptionsReal("-Lz",
          "set Ly in domain ([0,Lx] x [0,Ly] x [0,Lz], etc.)",
          "fish.c",user.Lz,&user.Lz,NULL);CHKERRQ(ierr);
+    ierr = PetscOptionsInt("-order",
+         "order of the finite difference scheme (=2,4); 4 uses Mehrstellen stencils",
+         "fish.c",order,&order,NULL);CHKERRQ(ierr);
     ierr = PetscOptionsEnum("-problem",
          "problem type; determines exact solution and RHS",
          "fish.c",ProblemTypes,(PetscEnum)problem,(PetscEnum*)&problem,NULL); CHKERRQ(ierr);
     ierr = PetscOptionsEnd(); CHKERRQ(ierr);
     user.g_bdry = g_bdry_ptr[dim-1][problem];
     user.f_rhs = f_rhs_ptr[dim-1][problem];
+    user.k_coeff = (problem == MANUVAR) ? &k_manuvar : NULL;
     if ( user.cx <= 0.0 || user.cy <= 0.0 || user.cz <= 0.0 ) {
         SETERRQ(PETSC_COMM_SELF,2,"positivity required for coefficients cx,cy,cz\n");
     }
+    if ((blocked || bench > 0) && dim != 3) {
+        SETERRQ(PETSC_COMM_SELF,5,"-fsh_blocked and -fsh_bench_residual require -fsh_dim 3\n");
+    }
+    if (order != 2 && order != 4) {
+        SETERRQ(PETSC_COMM_SELF,6,"-fsh_order must be 2 or 4\n");
+    }
+    if (order == 4 && (blocked || matfree)) {
+        SETERRQ(PETSC_COMM_SELF,7,"-fsh_order 4 is not implemented with -fsh_blocked or -fsh_matfree\n");
+    }
+    if (blocked) {
+        residual_ptr[2] = (DMDASNESFunction)&Poisson3DFunctionLocalBlocked;
+    }
+    if (problem == MANUVAR && (order == 4 || blocked || matfree)) {
+        SETERRQ(PETSC_COMM_SELF,8,"-fsh_problem manuvar is not implemented with -fsh_order 4, -fsh_blocked, or -fsh_matfree\n");
+    }
+    if (problem == MANUVAR) {
+        residual_ptr[0] = (DMDASNESFunction)&Poisson1DFunctionLocalVarCoeff;
+        residual_ptr[1] = (DMDASNESFunction)&Poisson2DFunctionLocalVarCoeff;
+        residual_ptr[2] = (DMDASNESFunction)&Poisson3DFunctionLocalVarCoeff;
+        jacobian_ptr[0] = (DMDASNESJacobian)&Poisson1DJacobianLocalVarCoeff;
+        jacobian_ptr[1] = (DMDASNESJacobian)&Poisson2DJacobianLocalVarCoeff;
+        jacobian_ptr[2] = (DMDASNESJacobian)&Poisson3DJacobianLocalVarCoeff;
+    }
+    if (order == 4) {
+        residual_ptr[0] = (DMDASNESFunction)&Poisson1DFunctionLocalMehrstellen;
+        residual_ptr[1] = (DMDASNESFunction)&Poisson2DFunctionLocalMehrstellen;
+        residual_ptr[2] = (DMDASNESFunction)&Poisson3DFunctionLocalMehrstellen;
+        jacobian_ptr[1] = (DMDASNESJacobian)&Poisson2DJacobianLocalMehrstellen;
+        jacobian_ptr[2] = (DMDASNESJacobian)&Poisson3DJacobianLocalMehrstellen;
+    }
     if ((problem == MANUEXP) && ( user.cx != 1.0 || user.cy != 1.0 || user.cz != 1.0)) {
         SETERRQ(PETSC_COMM_SELF,3,"cx=cy=cz=1 required for problem MANUEXP\n");
     }
@@ -202,13 +360,14 @@ int main(int argc,char **argv) {
             break;
         case 2:
             ierr = DMDACreate2d(PETSC_COMM_WORLD,
-                DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,DMDA_STENCIL_STAR,
+                DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,
+                (order == 4) ? DMDA_STENCIL_BOX : DMDA_STENCIL_STAR,
                 3,3,PETSC_DECIDE,PETSC_DECIDE,1,1,NULL,NULL,&da); CHKERRQ(ierr);
             break;
         case 3:
             ierr = DMDACreate3d(PETSC_COMM_WORLD,
                 DM_BOUNDARY_NONE, DM_BOUNDARY_NONE, DM_BOUNDARY_NONE,
-                DMDA_STENCIL_STAR,
+                (order == 4) ? DMDA_STENCIL_BOX : DMDA_STENCIL_STAR,
                 3,3,3,PETSC_DECIDE,PETSC_DECIDE,PETSC_DECIDE,
                 1,1,NULL,NULL,NULL,&da); CHKERRQ(ierr);
             break;
@@ -219,6 +378,9 @@ int main(int argc,char **argv) {
     ierr = DMSetFromOptions(da); CHKERRQ(ierr);
     ierr = DMSetUp(da); CHKERRQ(ierr);  // call BEFORE SetUniformCoordinates
     ierr = DMDASetUniformCoordinates(da,0.0,user.Lx,0.0,user.Ly,0.0,user.Lz); CHKERRQ(ierr);
+    if (matfree) {
+        ierr = PoissonSetMatrixFree(da); CHKERRQ(ierr);
+    }
 
     // set SNES call-backs
     ierr = SNESCreate(PETSC_COMM_WORLD,&snes); CHKERRQ(ierr);
@@ -232,11 +394,24 @@ int main(int argc,char **argv) {
     ierr = SNESSetType(snes,SNESKSPONLY); CHKERRQ(ierr);
     ierr = SNESGetKSP(snes,&ksp); CHKERRQ(ierr);
     ierr = KSPSetType(ksp,KSPCG); CHKERRQ(ierr);
+    if (matfree) {
+        // smoothers and PCs which only need the diagonal
+        PC  pc;
+        ierr = KSPGetPC(ksp,&pc); CHKERRQ(ierr);
+        ierr = PCSetType(pc,PCJACOBI); CHKERRQ(ierr);
+        ierr = PetscOptionsHasName(NULL,NULL,"-mg_levels_pc_type",&levelspcset); CHKERRQ(ierr);
+        if (!levelspcset) {
+            ierr = PetscOptionsSetValue(NULL,"-mg_levels_pc_type","jacobi"); CHKERRQ(ierr);
+        }
+    }
     ierr = SNESSetFromOptions(snes); CHKERRQ(ierr);
 
     // set initial iterate and then solve
     ierr = DMGetGlobalVector(da,&u_initial); CHKERRQ(ierr);
     ierr = InitialState(da, initial, gonboundary, u_initial, &user); CHKERRQ(ierr);
+    if (bench > 0) {
+        ierr = BenchResidual3D(da,u_initial,&user,bench); CHKERRQ(ierr);
+    }
     ierr = SNESSolve(snes,NULL,u_initial); CHKERRQ(ierr);
 //ENDCREATE
 
@@ -5,23 +5,26 @@ PetscErrorCode Poisson1DFunctionLocal(DMDALocalInfo *info, PetscReal *au,
                                       PetscReal *aF, PoissonCtx *user) {
     PetscErrorCode ierr;
     PetscInt   i;
-    PetscReal  xmax[1], xmin[1], h, x, ue, uw;
+    PetscReal  xmax[1], xmin[1], h, x, ue, uw, *ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
     ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
     h = (xmax[0] - xmin[0]) / (info->mx - 1);
     for (i = info->xs; i < info->xs + info->xm; i++) {
         x = xmin[0] + i * h;
         if (i==0 || i==info->mx-1) {
-            aF[i] = au[i] - user->g_bdry(x,0.0,0.0,user);
+            aF[i] = au[i] - POISSON_G1D(user,ag,i,x);
             aF[i] *= user->cx * (2.0 / h);
         } else {
-            ue = (i+1 == info->mx-1) ? user->g_bdry(x+h,0.0,0.0,user)
+            ue = (i+1 == info->mx-1) ? POISSON_G1D(user,ag,i+1,x+h)
                                      : au[i+1];
-            uw = (i-1 == 0)          ? user->g_bdry(x-h,0.0,0.0,user)
+            uw = (i-1 == 0)          ? POISSON_G1D(user,ag,i-1,x-h)
                                      : au[i-1];
             aF[i] = user->cx * (2.0 * au[i] - uw - ue) / h
                     - h * user->f_rhs(x,0.0,0.0,user);
         }
     }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
     ierr = PetscLogFlops(9.0*info->xm);CHKERRQ(ierr);
     return 0;
 }
@@ -32,7 +35,9 @@ PetscErrorCode Poisson2DFunctionLocal(DMDALocalInfo *info, PetscReal **au,
     PetscErrorCode ierr;
     PetscInt   i, j;
     PetscReal  xymin[2], xymax[2], hx, hy, darea, scx, scy, scdiag, x, y,
-               ue, uw, un, us;
+               ue, uw, un, us, **ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
     ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
     hx = (xymax[0] - xymin[0]) / (info->mx - 1);
     hy = (xymax[1] - xymin[1]) / (info->my - 1);
@@ -45,16 +50,16 @@ PetscErrorCode Poisson2DFunctionLocal(DMDALocalInfo *info, PetscReal **au,
         for (i = info->xs; i < info->xs + info->xm; i++) {
             x = xymin[0] + i * hx;
             if (i==0 || i==info->mx-1 || j==0 || j==info->my-1) {
-                aF[j][i] = au[j][i] - user->g_bdry(x,y,0.0,user);
+                aF[j][i] = au[j][i] - POISSON_G2D(user,ag,j,i,x,y);
                 aF[j][i] *= scdiag;
             } else {
-                ue = (i+1 == info->mx-1) ? user->g_bdry(x+hx,y,0.0,user)
+                ue = (i+1 == info->mx-1) ? POISSON_G2D(user,ag,j,i+1,x+hx,y)
                                          : au[j][i+1];
-                uw = (i-1 == 0)          ? user->g_bdry(x-hx,y,0.0,user)
+                uw = (i-1 == 0)          ? POISSON_G2D(user,ag,j,i-1,x-hx,y)
                                          : au[j][i-1];
-                un = (j+1 == info->my-1) ? user->g_bdry(x,y+hy,0.0,user)
+                un = (j+1 == info->my-1) ? POISSON_G2D(user,ag,j+1,i,x,y+hy)
                                          : au[j+1][i];
-                us = (j-1 == 0)          ? user->g_bdry(x,y-hy,0.0,user)
+                us = (j-1 == 0)          ? POISSON_G2D(user,ag,j-1,i,x,y-hy)
                                          : au[j-1][i];
                 aF[j][i] = scdiag * au[j][i]
                            - scx * (uw + ue) - scy * (us + un)
@@ -62,6 +67,7 @@ PetscErrorCode Poisson2DFunctionLocal(DMDALocalInfo *info, PetscReal **au,
             }
         }
     }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
     ierr = PetscLogFlops(11.0*info->xm*info->ym);CHKERRQ(ierr);
     return 0;
 }
@@ -72,7 +78,9 @@ PetscErrorCode Poisson3DFunctionLocal(DMDALocalInfo *info, PetscReal ***au,
     PetscErrorCode ierr;
     PetscInt   i, j, k;
     PetscReal  xyzmin[3], xyzmax[3], hx, hy, hz, dvol, scx, scy, scz, scdiag,
-               x, y, z, ue, uw, un, us, uu, ud;
+               x, y, z, ue, uw, un, us, uu, ud, ***ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
     ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
     hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
     hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
@@ -91,20 +99,20 @@ PetscErrorCode Poisson3DFunctionLocal(DMDALocalInfo *info, PetscReal ***au,
                 if (   i==0 || i==info->mx-1
                     || j==0 || j==info->my-1
                     || k==0 || k==info->mz-1) {
-                    aF[k][j][i] = au[k][j][i] - user->g_bdry(x,y,z,user);
+                    aF[k][j][i] = au[k][j][i] - POISSON_G3D(user,ag,k,j,i,x,y,z);
                     aF[k][j][i] *= scdiag;
                 } else {
-                    ue = (i+1 == info->mx-1) ? user->g_bdry(x+hx,y,z,user)
+                    ue = (i+1 == info->mx-1) ? POISSON_G3D(user,ag,k,j,i+1,x+hx,y,z)
                                              : au[k][j][i+1];
-                    uw = (i-1 == 0)          ? user->g_bdry(x-hx,y,z,user)
+                    uw = (i-1 == 0)          ? POISSON_G3D(user,ag,k,j,i-1,x-hx,y,z)
                                              : au[k][j][i-1];
-                    un = (j+1 == info->my-1) ? user->g_bdry(x,y+hy,z,user)
+                    un = (j+1 == info->my-1) ? POISSON_G3D(user,ag,k,j+1,i,x,y+hy,z)
                                              : au[k][j+1][i];
-                    us = (j-1 == 0)          ? user->g_bdry(x,y-hy,z,user)
+                    us = (j-1 == 0)          ? POISSON_G3D(user,ag,k,j-1,i,x,y-hy,z)
                                              : au[k][j-1][i];
-                    uu = (k+1 == info->mz-1) ? user->g_bdry(x,y,z+hz,user)
+                    uu = (k+1 == info->mz-1) ? POISSON_G3D(user,ag,k+1,j,i,x,y,z+hz)
                                              : au[k+1][j][i];
-                    ud = (k-1 == 0)          ? user->g_bdry(x,y,z-hz,user)
+                    ud = (k-1 == 0)          ? POISSON_G3D(user,ag,k-1,j,i,x,y,z-hz)
                                              : au[k-1][j][i];
                     aF[k][j][i] = scdiag * au[k][j][i]
                         - scx * (uw + ue) - scy * (us + un) - scz * (uu + ud)
@@ -113,17 +121,522 @@ PetscErrorCode Poisson3DFunctionLocal(DMDALocalInfo *info, PetscReal ***au,
             }
         }
     }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
     ierr = PetscLogFlops(14.0*info->xm*info->ym*info->zm);CHKERRQ(ierr);
     return 0;
 }
 
+// fast memory (bytes) which the tile of rows in Poisson3DFunctionLocalBlocked()
+//   should fit into; typical per-core L2
+#define POISSON_TILEBYTES 262144
+
+// correction at interior point (i,j,k) for those neighbours which are on the
+//   boundary, where the residual uses g instead of u
+static PetscReal BoundaryNeighbors3D(DMDALocalInfo *info, PetscReal ***au,
+        PetscReal ***ag, PetscInt i, PetscInt j, PetscInt k, PetscReal x,
+        PetscReal y, PetscReal z, const PetscReal h[3], const PetscReal sc[3],
+        PoissonCtx *user) {
+    PetscReal c = 0.0;
+    if (i-1 == 0)
+        c += sc[0] * (POISSON_G3D(user,ag,k,j,i-1,x-h[0],y,z) - au[k][j][i-1]);
+    if (i+1 == info->mx-1)
+        c += sc[0] * (POISSON_G3D(user,ag,k,j,i+1,x+h[0],y,z) - au[k][j][i+1]);
+    if (j-1 == 0)
+        c += sc[1] * (POISSON_G3D(user,ag,k,j-1,i,x,y-h[1],z) - au[k][j-1][i]);
+    if (j+1 == info->my-1)
+        c += sc[1] * (POISSON_G3D(user,ag,k,j+1,i,x,y+h[1],z) - au[k][j+1][i]);
+    if (k-1 == 0)
+        c += sc[2] * (POISSON_G3D(user,ag,k-1,j,i,x,y,z-h[2]) - au[k-1][j][i]);
+    if (k+1 == info->mz-1)
+        c += sc[2] * (POISSON_G3D(user,ag,k+1,j,i,x,y,z+h[2]) - au[k+1][j][i]);
+    return c;
+}
+
+PetscErrorCode Poisson3DFunctionLocalBlocked(DMDALocalInfo *info,
+        PetscReal ***au, PetscReal ***aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j, k, is, ie, js, je, ks, ke, jb, jend, jtile;
+    PetscReal  xyzmin[3], xyzmax[3], h[3], sc[3], dvol, scdiag, x, y, z, ***ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    h[0] = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    h[1] = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    h[2] = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    dvol = h[0] * h[1] * h[2];
+    sc[0] = user->cx * dvol / (h[0]*h[0]);
+    sc[1] = user->cy * dvol / (h[1]*h[1]);
+    sc[2] = user->cz * dvol / (h[2]*h[2]);
+    scdiag = 2.0 * (sc[0] + sc[1] + sc[2]);
+    // owned interior points are [is,ie) x [js,je) x [ks,ke)
+    is = PetscMax(info->xs,1);  ie = PetscMin(info->xs + info->xm,info->mx-1);
+    js = PetscMax(info->ys,1);  je = PetscMin(info->ys + info->ym,info->my-1);
+    ks = PetscMax(info->zs,1);  ke = PetscMin(info->zs + info->zm,info->mz-1);
+
+    // owned points on the boundary faces
+    for (k = info->zs; k < info->zs + info->zm; k++) {
+        z = xyzmin[2] + k * h[2];
+        for (j = info->ys; j < info->ys + info->ym; j++) {
+            y = xyzmin[1] + j * h[1];
+            for (i = info->xs; i < info->xs + info->xm; i++) {
+                if (   i==0 || i==info->mx-1
+                    || j==0 || j==info->my-1
+                    || k==0 || k==info->mz-1) {
+                    x = xyzmin[0] + i * h[0];
+                    aF[k][j][i] = scdiag * (au[k][j][i] - POISSON_G3D(user,ag,k,j,i,x,y,z));
+                } else if (i < info->mx-2) {
+                    i = info->mx-2;  // skip the interior of the row
+                }
+            }
+        }
+    }
+
+    // interior points:  the stencil uses u at all neighbours, without
+    //   branches, so the inner loop vectorizes; a tile of rows is swept over
+    //   all planes k before the next, so the planes k-1,k,k+1 of the tile
+    //   stay in cache
+    jtile = PetscMax(1,POISSON_TILEBYTES / (4 * (info->xm + 2) * (PetscInt)sizeof(PetscReal)));
+    for (jb = js; jb < je; jb += jtile) {
+        jend = PetscMin(jb + jtile,je);
+        for (k = ks; k < ke; k++) {
+            z = xyzmin[2] + k * h[2];
+            for (j = jb; j < jend; j++) {
+                const PetscReal *PETSC_RESTRICT uc = au[k][j],
+                                *PETSC_RESTRICT us = au[k][j-1],
+                                *PETSC_RESTRICT un = au[k][j+1],
+                                *PETSC_RESTRICT ud = au[k-1][j],
+                                *PETSC_RESTRICT uu = au[k+1][j];
+                PetscReal       *PETSC_RESTRICT F = aF[k][j];
+                y = xyzmin[1] + j * h[1];
+                for (i = is; i < ie; i++)
+                    F[i] = scdiag * uc[i] - sc[0] * (uc[i-1] + uc[i+1])
+                           - sc[1] * (us[i] + un[i]) - sc[2] * (ud[i] + uu[i]);
+                for (i = is; i < ie; i++)
+                    F[i] -= dvol * user->f_rhs(xyzmin[0] + i * h[0],y,z,user);
+            }
+        }
+    }
+
+    // interior points next to the boundary
+    for (k = ks; k < ke; k++) {
+        z = xyzmin[2] + k * h[2];
+        for (j = js; j < je; j++) {
+            y = xyzmin[1] + j * h[1];
+            for (i = is; i < ie; i++) {
+                if (   i==1 || i==info->mx-2
+                    || j==1 || j==info->my-2
+                    || k==1 || k==info->mz-2) {
+                    x = xyzmin[0] + i * h[0];
+                    aF[k][j][i] -= BoundaryNeighbors3D(info,au,ag,i,j,k,x,y,z,h,sc,user);
+                } else if (i < info->mx-3) {
+                    i = info->mx-3;  // skip the middle of the row
+                }
+            }
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PetscLogFlops(14.0*info->xm*info->ym*info->zm);CHKERRQ(ierr);
+    return 0;
+}
+
+/* Fourth-order compact (Mehrstellen) residuals.  For
+    - cx u_xx - cy u_yy - cz u_zz = f
+the truncation error of the usual second differences is cancelled, to
+O(h^4), by adding mixed fourth differences to the operator and by applying
+(I + (1/12) sum_a h_a^2 delta_a^2) to f.  The operator stencils are 3-point
+in 1D, 9-point in 2D, and 19-point (faces and edges, not corners) in 3D.
+The rows are scaled as in Poisson2DFunctionLocal() etc.  Boundary rows are
+scaled by the diagonal entry of the interior rows, so the Jacobians again
+have constant diagonal.                                                    */
+
+PetscErrorCode Poisson1DFunctionLocalMehrstellen(DMDALocalInfo *info,
+        PetscReal *au, PetscReal *aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i;
+    PetscReal  xmax[1], xmin[1], h, x, ue, uw, ff, *ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
+    h = (xmax[0] - xmin[0]) / (info->mx - 1);
+    for (i = info->xs; i < info->xs + info->xm; i++) {
+        x = xmin[0] + i * h;
+        if (i==0 || i==info->mx-1) {
+            aF[i] = au[i] - POISSON_G1D(user,ag,i,x);
+            aF[i] *= user->cx * (2.0 / h);
+        } else {
+            ue = (i+1 == info->mx-1) ? POISSON_G1D(user,ag,i+1,x+h)
+                                     : au[i+1];
+            uw = (i-1 == 0)          ? POISSON_G1D(user,ag,i-1,x-h)
+                                     : au[i-1];
+            ff = (10.0 * user->f_rhs(x,0.0,0.0,user)
+                  + user->f_rhs(x-h,0.0,0.0,user)
+                  + user->f_rhs(x+h,0.0,0.0,user)) / 12.0;
+            aF[i] = user->cx * (2.0 * au[i] - uw - ue) / h - h * ff;
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PetscLogFlops(14.0*info->xm);CHKERRQ(ierr);
+    return 0;
+}
+
+// 9-point stencil coefficients a[dj+1][di+1]; returns the diagonal entry
+static PetscReal Mehrstellen2DStencil(PoissonCtx *user,
+        PetscReal hx, PetscReal hy, PetscReal a[3][3]) {
+    const PetscReal scx = user->cx * hy / hx,
+                    scy = user->cy * hx / hy,
+                    sxy = (scx + scy) / 12.0;
+    a[1][1] = 2.0 * (scx + scy) - 4.0 * sxy;
+    a[1][0] = a[1][2] = - scx + 2.0 * sxy;
+    a[0][1] = a[2][1] = - scy + 2.0 * sxy;
+    a[0][0] = a[0][2] = a[2][0] = a[2][2] = - sxy;
+    return a[1][1];
+}
+
+PetscErrorCode Poisson2DFunctionLocalMehrstellen(DMDALocalInfo *info,
+        PetscReal **au, PetscReal **aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j, di, dj;
+    PetscReal  xymin[2], xymax[2], hx, hy, darea, a[3][3], diag, x, y, v, ff,
+               **ag;
+    Vec        gloc;
+    if (info->st != DMDA_STENCIL_BOX) {
+        SETERRQ(PETSC_COMM_SELF,9,"Mehrstellen stencil requires DMDA_STENCIL_BOX\n");
+    }
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
+    hx = (xymax[0] - xymin[0]) / (info->mx - 1);
+    hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    darea = hx * hy;
+    diag = Mehrstellen2DStencil(user,hx,hy,a);
+    for (j = info->ys; j < info->ys + info->ym; j++) {
+        y = xymin[1] + j * hy;
+        for (i = info->xs; i < info->xs + info->xm; i++) {
+            x = xymin[0] + i * hx;
+            if (i==0 || i==info->mx-1 || j==0 || j==info->my-1) {
+                aF[j][i] = diag * (au[j][i] - POISSON_G2D(user,ag,j,i,x,y));
+                continue;
+            }
+            aF[j][i] = 0.0;
+            for (dj = -1; dj <= 1; dj++) {
+                for (di = -1; di <= 1; di++) {
+                    if (   i+di == 0 || i+di == info->mx-1
+                        || j+dj == 0 || j+dj == info->my-1)
+                        v = POISSON_G2D(user,ag,j+dj,i+di,x+di*hx,y+dj*hy);
+                    else
+                        v = au[j+dj][i+di];
+                    aF[j][i] += a[dj+1][di+1] * v;
+                }
+            }
+            ff = (8.0 * user->f_rhs(x,y,0.0,user)
+                  + user->f_rhs(x-hx,y,0.0,user) + user->f_rhs(x+hx,y,0.0,user)
+                  + user->f_rhs(x,y-hy,0.0,user) + user->f_rhs(x,y+hy,0.0,user))
+                 / 12.0;
+            aF[j][i] -= darea * ff;
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PetscLogFlops(26.0*info->xm*info->ym);CHKERRQ(ierr);
+    return 0;
+}
+
+// 19-point stencil coefficients a[dk+1][dj+1][di+1], with zero at the
+//   corners; returns the diagonal entry
+static PetscReal Mehrstellen3DStencil(PoissonCtx *user,
+        PetscReal hx, PetscReal hy, PetscReal hz, PetscReal a[3][3][3]) {
+    const PetscReal dvol = hx * hy * hz,
+                    scx = user->cx * dvol / (hx*hx),
+                    scy = user->cy * dvol / (hy*hy),
+                    scz = user->cz * dvol / (hz*hz),
+                    sxy = (scx + scy) / 12.0,
+                    sxz = (scx + scz) / 12.0,
+                    syz = (scy + scz) / 12.0;
+    PetscInt  di, dj, dk;
+    for (dk = 0; dk < 3; dk++)
+        for (dj = 0; dj < 3; dj++)
+            for (di = 0; di < 3; di++)
+                a[dk][dj][di] = 0.0;
+    a[1][1][1] = 2.0 * (scx + scy + scz) - 4.0 * (sxy + sxz + syz);
+    a[1][1][0] = a[1][1][2] = - scx + 2.0 * (sxy + sxz);
+    a[1][0][1] = a[1][2][1] = - scy + 2.0 * (sxy + syz);
+    a[0][1][1] = a[2][1][1] = - scz + 2.0 * (sxz + syz);
+    a[1][0][0] = a[1][0][2] = a[1][2][0] = a[1][2][2] = - sxy;
+    a[0][1][0] = a[0][1][2] = a[2][1][0] = a[2][1][2] = - sxz;
+    a[0][0][1] = a[0][2][1] = a[2][0][1] = a[2][2][1] = - syz;
+    return a[1][1][1];
+}
+
+PetscErrorCode Poisson3DFunctionLocalMehrstellen(DMDALocalInfo *info,
+        PetscReal ***au, PetscReal ***aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j, k, di, dj, dk;
+    PetscReal  xyzmin[3], xyzmax[3], hx, hy, hz, dvol, a[3][3][3], diag,
+               x, y, z, v, ff, ***ag;
+    Vec        gloc;
+    if (info->st != DMDA_STENCIL_BOX) {
+        SETERRQ(PETSC_COMM_SELF,10,"Mehrstellen stencil requires DMDA_STENCIL_BOX\n");
+    }
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    dvol = hx * hy * hz;
+    diag = Mehrstellen3DStencil(user,hx,hy,hz,a);
+    for (k = info->zs; k < info->zs + info->zm; k++) {
+        z = xyzmin[2] + k * hz;
+        for (j = info->ys; j < info->ys + info->ym; j++) {
+            y = xyzmin[1] + j * hy;
+            for (i = info->xs; i < info->xs + info->xm; i++) {
+                x = xyzmin[0] + i * hx;
+                if (   i==0 || i==info->mx-1
+                    || j==0 || j==info->my-1
+                    || k==0 || k==info->mz-1) {
+                    aF[k][j][i] = diag * (au[k][j][i] - POISSON_G3D(user,ag,k,j,i,x,y,z));
+                    continue;
+                }
+                aF[k][j][i] = 0.0;
+                for (dk = -1; dk <= 1; dk++) {
+                    for (dj = -1; dj <= 1; dj++) {
+                        for (di = -1; di <= 1; di++) {
+                            if (a[dk+1][dj+1][di+1] == 0.0)
+                                continue;
+                            if (   i+di == 0 || i+di == info->mx-1
+                                || j+dj == 0 || j+dj == info->my-1
+                                || k+dk == 0 || k+dk == info->mz-1)
+                                v = POISSON_G3D(user,ag,k+dk,j+dj,i+di,
+                                                x+di*hx,y+dj*hy,z+dk*hz);
+                            else
+                                v = au[k+dk][j+dj][i+di];
+                            aF[k][j][i] += a[dk+1][dj+1][di+1] * v;
+                        }
+                    }
+                }
+                ff = (6.0 * user->f_rhs(x,y,z,user)
+                      + user->f_rhs(x-hx,y,z,user) + user->f_rhs(x+hx,y,z,user)
+                      + user->f_rhs(x,y-hy,z,user) + user->f_rhs(x,y+hy,z,user)
+                      + user->f_rhs(x,y,z-hz,user) + user->f_rhs(x,y,z+hz,user))
+                     / 12.0;
+                aF[k][j][i] -= dvol * ff;
+            }
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PetscLogFlops(48.0*info->xm*info->ym*info->zm);CHKERRQ(ierr);
+    return 0;
+}
+
+/* Matrix-free versions of the Jacobians above.  A MATSHELL created by
+DMCreateMatrix() on a DM with MATSHELL type is given these operations by
+the PoissonXDJacobianLocal() call-backs; its context is the DMDA.  The
+products compute the same rows as the assembled matrices:  Dirichlet rows
+are diagonal, and interior rows omit the columns of boundary points.     */
+
+static PetscErrorCode Poisson1DMultLocal(DMDALocalInfo *info, PetscReal *ax,
+                                         PetscReal *ay, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i;
+    PetscReal  xmin[1], xmax[1], h, sc, ue, uw;
+    ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
+    h = (xmax[0] - xmin[0]) / (info->mx - 1);
+    sc = user->cx / h;
+    for (i = info->xs; i < info->xs + info->xm; i++) {
+        if (i==0 || i==info->mx-1) {
+            ay[i] = 2.0 * sc * ax[i];
+        } else {
+            ue = (i+1 == info->mx-1) ? 0.0 : ax[i+1];
+            uw = (i-1 == 0)          ? 0.0 : ax[i-1];
+            ay[i] = sc * (2.0 * ax[i] - uw - ue);
+        }
+    }
+    ierr = PetscLogFlops(4.0*info->xm);CHKERRQ(ierr);
+    return 0;
+}
+
+static PetscErrorCode Poisson2DMultLocal(DMDALocalInfo *info, PetscReal **ax,
+                                         PetscReal **ay, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j;
+    PetscReal  xymin[2], xymax[2], hx, hy, scx, scy, scdiag, ue, uw, un, us;
+    ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
+    hx = (xymax[0] - xymin[0]) / (info->mx - 1);
+    hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    scx = user->cx * hy / hx;
+    scy = user->cy * hx / hy;
+    scdiag = 2.0 * (scx + scy);
+    for (j = info->ys; j < info->ys + info->ym; j++) {
+        for (i = info->xs; i < info->xs + info->xm; i++) {
+            if (i==0 || i==info->mx-1 || j==0 || j==info->my-1) {
+                ay[j][i] = scdiag * ax[j][i];
+            } else {
+                ue = (i+1 == info->mx-1) ? 0.0 : ax[j][i+1];
+                uw = (i-1 == 0)          ? 0.0 : ax[j][i-1];
+                un = (j+1 == info->my-1) ? 0.0 : ax[j+1][i];
+                us = (j-1 == 0)          ? 0.0 : ax[j-1][i];
+                ay[j][i] = scdiag * ax[j][i] - scx * (uw + ue) - scy * (us + un);
+            }
+        }
+    }
+    ierr = PetscLogFlops(7.0*info->xm*info->ym);CHKERRQ(ierr);
+    return 0;
+}
+
+static PetscErrorCode Poisson3DMultLocal(DMDALocalInfo *info, PetscReal ***ax,
+                                         PetscReal ***ay, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j, k;
+    PetscReal  xyzmin[3], xyzmax[3], hx, hy, hz, dvol, scx, scy, scz, scdiag,
+               ue, uw, un, us, uu, ud;
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    dvol = hx * hy * hz;
+    scx = user->cx * dvol / (hx*hx);
+    scy = user->cy * dvol / (hy*hy);
+    scz = user->cz * dvol / (hz*hz);
+    scdiag = 2.0 * (scx + scy + scz);
+    for (k = info->zs; k < info->zs + info->zm; k++) {
+        for (j = info->ys; j < info->ys + info->ym; j++) {
+            for (i = info->xs; i < info->xs + info->xm; i++) {
+                if (   i==0 || i==info->mx-1
+                    || j==0 || j==info->my-1
+                    || k==0 || k==info->mz-1) {
+                    ay[k][j][i] = scdiag * ax[k][j][i];
+                } else {
+                    ue = (i+1 == info->mx-1) ? 0.0 : ax[k][j][i+1];
+                    uw = (i-1 == 0)          ? 0.0 : ax[k][j][i-1];
+                    un = (j+1 == info->my-1) ? 0.0 : ax[k][j+1][i];
+                    us = (j-1 == 0)          ? 0.0 : ax[k][j-1][i];
+                    uu = (k+1 == info->mz-1) ? 0.0 : ax[k+1][j][i];
+                    ud = (k-1 == 0)          ? 0.0 : ax[k-1][j][i];
+                    ay[k][j][i] = scdiag * ax[k][j][i]
+                        - scx * (uw + ue) - scy * (us + un) - scz * (uu + ud);
+                }
+            }
+        }
+    }
+    ierr = PetscLogFlops(10.0*info->xm*info->ym*info->zm);CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode PoissonShellMult(Mat A, Vec x, Vec y) {
+    PetscErrorCode ierr;
+    DM             da;
+    DMDALocalInfo  info;
+    PoissonCtx     *user;
+    Vec            xloc;
+    void           *ax, *ay;
+    ierr = MatShellGetContext(A,&da); CHKERRQ(ierr);
+    ierr = DMGetApplicationContext(da,&user); CHKERRQ(ierr);
+    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
+    ierr = DMGetLocalVector(da,&xloc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalBegin(da,x,INSERT_VALUES,xloc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalEnd(da,x,INSERT_VALUES,xloc); CHKERRQ(ierr);
+    ierr = DMDAVecGetArrayRead(da,xloc,&ax); CHKERRQ(ierr);
+    ierr = DMDAVecGetArray(da,y,&ay); CHKERRQ(ierr);
+    switch (info.dim) {
+        case 1:
+            ierr = Poisson1DMultLocal(&info,(PetscReal*)ax,(PetscReal*)ay,user); CHKERRQ(ierr);
+            break;
+        case 2:
+            ierr = Poisson2DMultLocal(&info,(PetscReal**)ax,(PetscReal**)ay,user); CHKERRQ(ierr);
+            break;
+        case 3:
+            ierr = Poisson3DMultLocal(&info,(PetscReal***)ax,(PetscReal***)ay,user); CHKERRQ(ierr);
+            break;
+        default:
+            SETERRQ(PETSC_COMM_SELF,6,"invalid dim from DMDALocalInfo\n");
+    }
+    ierr = DMDAVecRestoreArray(da,y,&ay); CHKERRQ(ierr);
+    ierr = DMDAVecRestoreArrayRead(da,xloc,&ax); CHKERRQ(ierr);
+    ierr = DMRestoreLocalVector(da,&xloc); CHKERRQ(ierr);
+    return 0;
+}
+
+// the diagonal is constant; see poissonfunctions.h
+PetscErrorCode PoissonShellGetDiagonal(Mat A, Vec d) {
+    PetscErrorCode ierr;
+    DM             da;
+    DMDALocalInfo  info;
+    PoissonCtx     *user;
+    PetscReal      xyzmin[3], xyzmax[3], hx, hy, hz, scdiag;
+    ierr = MatShellGetContext(A,&da); CHKERRQ(ierr);
+    ierr = DMGetApplicationContext(da,&user); CHKERRQ(ierr);
+    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info.mx - 1);
+    switch (info.dim) {
+        case 1:
+            scdiag = 2.0 * user->cx / hx;
+            break;
+        case 2:
+            hy = (xyzmax[1] - xyzmin[1]) / (info.my - 1);
+            scdiag = 2.0 * (user->cx * hy / hx + user->cy * hx / hy);
+            break;
+        case 3:
+            hy = (xyzmax[1] - xyzmin[1]) / (info.my - 1);
+            hz = (xyzmax[2] - xyzmin[2]) / (info.mz - 1);
+            scdiag = 2.0 * hx * hy * hz * (  user->cx / (hx*hx)
+                                           + user->cy / (hy*hy)
+                                           + user->cz / (hz*hz));
+            break;
+        default:
+            SETERRQ(PETSC_COMM_SELF,7,"invalid dim from DMDALocalInfo\n");
+    }
+    ierr = VecSet(d,scdiag); CHKERRQ(ierr);
+    return 0;
+}
+
+/* If Jpre is a MATSHELL then give it the operations above, so the
+PoissonXDJacobianLocal() call-backs have nothing to assemble.             */
+static PetscErrorCode ShellJacobian(DM da, Mat J, Mat Jpre, PetscBool *isshell) {
+    PetscErrorCode ierr;
+    ierr = PetscObjectTypeCompare((PetscObject)Jpre,MATSHELL,isshell); CHKERRQ(ierr);
+    if (!*isshell)
+        return 0;
+    ierr = MatShellSetContext(Jpre,(void*)da); CHKERRQ(ierr);
+    ierr = MatShellSetOperation(Jpre,MATOP_MULT,
+                                (void(*)(void))PoissonShellMult); CHKERRQ(ierr);
+    ierr = MatShellSetOperation(Jpre,MATOP_GET_DIAGONAL,
+                                (void(*)(void))PoissonShellGetDiagonal); CHKERRQ(ierr);
+    ierr = MatSetOption(Jpre,MAT_SYMMETRIC,PETSC_TRUE); CHKERRQ(ierr);
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+// each DM made by DMCoarsen() is the coarsest so far, so it alone gets an
+//   assembled matrix
+static PetscErrorCode MatrixFreeCoarsenHook(DM fine, DM coarse, void *ctx) {
+    PetscErrorCode ierr;
+    ierr = DMSetMatType(fine,MATSHELL); CHKERRQ(ierr);
+    ierr = DMSetMatType(coarse,MATAIJ); CHKERRQ(ierr);
+    ierr = DMCoarsenHookAdd(coarse,MatrixFreeCoarsenHook,NULL,ctx); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode PoissonSetMatrixFree(DM da) {
+    PetscErrorCode ierr;
+    ierr = DMSetMatType(da,MATSHELL); CHKERRQ(ierr);
+    ierr = DMCoarsenHookAdd(da,MatrixFreeCoarsenHook,NULL,NULL); CHKERRQ(ierr);
+    return 0;
+}
+
 PetscErrorCode Poisson1DJacobianLocal(DMDALocalInfo *info, PetscScalar *au,
                                       Mat J, Mat Jpre, PoissonCtx *user) {
     PetscErrorCode  ierr;
     PetscInt     i,ncols;
     PetscReal    xmin[1], xmax[1], h, v[3];
     MatStencil   col[3],row;
+    PetscBool    isshell;
 
+    ierr = ShellJacobian(info->da,J,Jpre,&isshell); CHKERRQ(ierr);
+    if (isshell)
+        return 0;
     ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
     h = (xmax[0] - xmin[0]) / (info->mx - 1);
     for (i = info->xs; i < info->xs+info->xm; i++) {
@@ -159,7 +672,11 @@ PetscErrorCode Poisson2DJacobianLocal(DMDALocalInfo *info, PetscScalar **au,
     PetscReal   xymin[2], xymax[2], hx, hy, scx, scy, scdiag, v[5];
     PetscInt    i,j,ncols;
     MatStencil  col[5],row;
+    PetscBool   isshell;
 
+    ierr = ShellJacobian(info->da,J,Jpre,&isshell); CHKERRQ(ierr);
+    if (isshell)
+        return 0;
     ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
     hx = (xymax[0] - xymin[0]) / (info->mx - 1);
     hy = (xymax[1] - xymin[1]) / (info->my - 1);
@@ -203,7 +720,11 @@ PetscErrorCode Poisson3DJacobianLocal(DMDALocalInfo *info, PetscScalar ***au,
     PetscReal   xyzmin[3], xyzmax[3], hx, hy, hz, dvol, scx, scy, scz, scdiag, v[7];
     PetscInt    i,j,k,ncols;
     MatStencil  col[7],row;
+    PetscBool   isshell;
 
+    ierr = ShellJacobian(info->da,J,Jpre,&isshell); CHKERRQ(ierr);
+    if (isshell)
+        return 0;
     ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
     hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
     hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
@@ -263,47 +784,248 @@ PetscErrorCode Poisson3DJacobianLocal(DMDALocalInfo *info, PetscScalar ***au,
     return 0;
 }
 
-PetscErrorCode InitialState(DM da, InitialType it, PetscBool gbdry,
-                            Vec u, PoissonCtx *user) {
-    PetscErrorCode ierr;
-    DMDALocalInfo  info;
-    PetscRandom    rctx;
-    switch (it) {
-        case ZEROS:
-            ierr = VecSet(u,0.0); CHKERRQ(ierr);
-            break;
-        case RANDOM:
-            ierr = PetscRandomCreate(PETSC_COMM_WORLD,&rctx); CHKERRQ(ierr);
-            ierr = VecSetRandom(u,rctx); CHKERRQ(ierr);
-            ierr = PetscRandomDestroy(&rctx); CHKERRQ(ierr);
-            break;
-        default:
-            SETERRQ(PETSC_COMM_SELF,4,"invalid InitialType ... how did I get here?\n");
-    }
-    if (!gbdry) {
-        return 0;
+// Jacobians of the Mehrstellen residuals; Poisson1DJacobianLocal() serves
+//   for Poisson1DFunctionLocalMehrstellen()
+PetscErrorCode Poisson2DJacobianLocalMehrstellen(DMDALocalInfo *info,
+        PetscScalar **au, Mat J, Mat Jpre, PoissonCtx *user) {
+    PetscErrorCode  ierr;
+    PetscReal   xymin[2], xymax[2], hx, hy, a[3][3], v[9];
+    PetscInt    i, j, di, dj, ncols;
+    MatStencil  col[9], row;
+
+    if (info->st != DMDA_STENCIL_BOX) {
+        SETERRQ(PETSC_COMM_SELF,14,"Mehrstellen stencil requires DMDA_STENCIL_BOX\n");
     }
-    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
-    switch (info.dim) {
-        case 1:
-        {
-            PetscInt  i;
-            PetscReal xmax[1], xmin[1], h, x, *au;
-            ierr = DMDAVecGetArray(da, u, &au); CHKERRQ(ierr);
-            ierr = DMGetBoundingBox(da,xmin,xmax); CHKERRQ(ierr);
-            h = (xmax[0] - xmin[0]) / (info.mx - 1);
-            for (i = info.xs; i < info.xs + info.xm; i++) {
-                if (i==0 || i==info.mx-1) {
-                    x = xmin[0] + i * h;
-                    au[i] = user->g_bdry(x,0.0,0.0,user);
+    ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
+    hx = (xymax[0] - xymin[0]) / (info->mx - 1);
+    hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    Mehrstellen2DStencil(user,hx,hy,a);
+    for (j = info->ys; j < info->ys+info->ym; j++) {
+        row.j = j;
+        for (i = info->xs; i < info->xs+info->xm; i++) {
+            row.i = i;
+            col[0].j = j;  col[0].i = i;  v[0] = a[1][1];
+            ncols = 1;
+            if (i>0 && i<info->mx-1 && j>0 && j<info->my-1) {
+                for (dj = -1; dj <= 1; dj++) {
+                    for (di = -1; di <= 1; di++) {
+                        if (   (di == 0 && dj == 0)
+                            || i+di == 0 || i+di == info->mx-1
+                            || j+dj == 0 || j+dj == info->my-1)
+                            continue;
+                        col[ncols].j = j+dj;  col[ncols].i = i+di;
+                        v[ncols++] = a[dj+1][di+1];
+                    }
                 }
             }
-            ierr = DMDAVecRestoreArray(da, u, &au); CHKERRQ(ierr);
-            break;
+            ierr = MatSetValuesStencil(Jpre,1,&row,ncols,col,v,INSERT_VALUES); CHKERRQ(ierr);
         }
-        case 2:
-        {
-            PetscInt   i, j;
+    }
+
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+PetscErrorCode Poisson3DJacobianLocalMehrstellen(DMDALocalInfo *info,
+        PetscScalar ***au, Mat J, Mat Jpre, PoissonCtx *user) {
+    PetscErrorCode  ierr;
+    PetscReal   xyzmin[3], xyzmax[3], hx, hy, hz, a[3][3][3], v[19];
+    PetscInt    i, j, k, di, dj, dk, ncols;
+    MatStencil  col[19], row;
+
+    if (info->st != DMDA_STENCIL_BOX) {
+        SETERRQ(PETSC_COMM_SELF,15,"Mehrstellen stencil requires DMDA_STENCIL_BOX\n");
+    }
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    Mehrstellen3DStencil(user,hx,hy,hz,a);
+    for (k = info->zs; k < info->zs+info->zm; k++) {
+        row.k = k;
+        for (j = info->ys; j < info->ys+info->ym; j++) {
+            row.j = j;
+            for (i = info->xs; i < info->xs+info->xm; i++) {
+                row.i = i;
+                col[0].k = k;  col[0].j = j;  col[0].i = i;  v[0] = a[1][1][1];
+                ncols = 1;
+                if (i>0 && i<info->mx-1 && j>0 && j<info->my-1 && k>0 && k<info->mz-1) {
+                    for (dk = -1; dk <= 1; dk++) {
+                        for (dj = -1; dj <= 1; dj++) {
+                            for (di = -1; di <= 1; di++) {
+                                if (   (di == 0 && dj == 0 && dk == 0)
+                                    || a[dk+1][dj+1][di+1] == 0.0
+                                    || i+di == 0 || i+di == info->mx-1
+                                    || j+dj == 0 || j+dj == info->my-1
+                                    || k+dk == 0 || k+dk == info->mz-1)
+                                    continue;
+                                col[ncols].k = k+dk;  col[ncols].j = j+dj;
+                                col[ncols].i = i+di;
+                                v[ncols++] = a[dk+1][dj+1][di+1];
+                            }
+                        }
+                    }
+                }
+                ierr = MatSetValuesStencil(Jpre,1,&row,ncols,col,v,INSERT_VALUES); CHKERRQ(ierr);
+            }
+        }
+    }
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+// fill the ghosted local Vec gloc with g at the boundary points it covers,
+//   including ghost points, and zero elsewhere
+static PetscErrorCode FillBoundaryCache(DM da, PoissonCtx *user, Vec gloc) {
+    PetscErrorCode ierr;
+    DMDALocalInfo  info;
+    PetscInt       i, j, k;
+    PetscReal      xyzmin[3], xyzmax[3], h[3] = {0.0, 0.0, 0.0}, x, y, z;
+    ierr = VecSet(gloc,0.0); CHKERRQ(ierr);
+    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(da,xyzmin,xyzmax); CHKERRQ(ierr);
+    h[0] = (xyzmax[0] - xyzmin[0]) / (info.mx - 1);
+    if (info.dim > 1)
+        h[1] = (xyzmax[1] - xyzmin[1]) / (info.my - 1);
+    if (info.dim > 2)
+        h[2] = (xyzmax[2] - xyzmin[2]) / (info.mz - 1);
+    switch (info.dim) {
+        case 1:
+        {
+            PetscReal *ag;
+            ierr = DMDAVecGetArray(da,gloc,&ag); CHKERRQ(ierr);
+            for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                if (i==0 || i==info.mx-1)
+                    ag[i] = user->g_bdry(xyzmin[0] + i * h[0],0.0,0.0,user);
+            }
+            ierr = DMDAVecRestoreArray(da,gloc,&ag); CHKERRQ(ierr);
+            break;
+        }
+        case 2:
+        {
+            PetscReal **ag;
+            ierr = DMDAVecGetArray(da,gloc,&ag); CHKERRQ(ierr);
+            for (j = info.gys; j < info.gys + info.gym; j++) {
+                y = xyzmin[1] + j * h[1];
+                for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                    if (i==0 || i==info.mx-1 || j==0 || j==info.my-1) {
+                        x = xyzmin[0] + i * h[0];
+                        ag[j][i] = user->g_bdry(x,y,0.0,user);
+                    }
+                }
+            }
+            ierr = DMDAVecRestoreArray(da,gloc,&ag); CHKERRQ(ierr);
+            break;
+        }
+        case 3:
+        {
+            PetscReal ***ag;
+            ierr = DMDAVecGetArray(da,gloc,&ag); CHKERRQ(ierr);
+            for (k = info.gzs; k < info.gzs + info.gzm; k++) {
+                z = xyzmin[2] + k * h[2];
+                for (j = info.gys; j < info.gys + info.gym; j++) {
+                    y = xyzmin[1] + j * h[1];
+                    for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                        if (i==0 || i==info.mx-1 || j==0 || j==info.my-1
+                                 || k==0 || k==info.mz-1) {
+                            x = xyzmin[0] + i * h[0];
+                            ag[k][j][i] = user->g_bdry(x,y,z,user);
+                        }
+                    }
+                }
+            }
+            ierr = DMDAVecRestoreArray(da,gloc,&ag); CHKERRQ(ierr);
+            break;
+        }
+        default:
+            SETERRQ(PETSC_COMM_SELF,8,"invalid dim from DMDALocalInfo\n");
+    }
+    return 0;
+}
+
+// the cache is a named local Vec of the DMDA, so each DMDA (e.g. each level
+//   made by -snes_grid_sequence or PCMG) gets its own, filled on first use,
+//   and it is destroyed along with the DMDA
+PetscErrorCode PoissonGetBoundaryCache(DM da, PoissonCtx *user,
+                                       Vec *gloc, void *ag) {
+    PetscErrorCode ierr;
+    PetscBool      filled;
+    *gloc = NULL;
+    *(void**)ag = NULL;
+    if (!user->cache_bdry)
+        return 0;
+    ierr = DMHasNamedLocalVector(da,"poisson_gbdry",&filled); CHKERRQ(ierr);
+    ierr = DMGetNamedLocalVector(da,"poisson_gbdry",gloc); CHKERRQ(ierr);
+    if (!filled) {
+        ierr = FillBoundaryCache(da,user,*gloc); CHKERRQ(ierr);
+    }
+    ierr = DMDAVecGetArrayRead(da,*gloc,ag); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode PoissonRestoreBoundaryCache(DM da, Vec *gloc, void *ag) {
+    PetscErrorCode ierr;
+    if (!*gloc)
+        return 0;
+    ierr = DMDAVecRestoreArrayRead(da,*gloc,ag); CHKERRQ(ierr);
+    ierr = DMRestoreNamedLocalVector(da,"poisson_gbdry",gloc); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode InitialState(DM da, InitialType it, PetscBool gbdry,
+                            Vec u, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    DMDALocalInfo  info;
+    PetscRandom    rctx;
+    Vec            gloc;
+    void           *ag;
+    switch (it) {
+        case ZEROS:
+            ierr = VecSet(u,0.0); CHKERRQ(ierr);
+            break;
+        case RANDOM:
+            ierr = PetscRandomCreate(PETSC_COMM_WORLD,&rctx); CHKERRQ(ierr);
+            ierr = VecSetRandom(u,rctx); CHKERRQ(ierr);
+            ierr = PetscRandomDestroy(&rctx); CHKERRQ(ierr);
+            break;
+        default:
+            SETERRQ(PETSC_COMM_SELF,4,"invalid InitialType ... how did I get here?\n");
+    }
+    if (!gbdry) {
+        return 0;
+    }
+    ierr = DMDAGetLocalInfo(da,&info); CHKERRQ(ierr);
+    ierr = PoissonGetBoundaryCache(da,user,&gloc,&ag); CHKERRQ(ierr);
+    switch (info.dim) {
+        case 1:
+        {
+            PetscInt  i;
+            PetscReal xmax[1], xmin[1], h, x, *au;
+            ierr = DMDAVecGetArray(da, u, &au); CHKERRQ(ierr);
+            ierr = DMGetBoundingBox(da,xmin,xmax); CHKERRQ(ierr);
+            h = (xmax[0] - xmin[0]) / (info.mx - 1);
+            for (i = info.xs; i < info.xs + info.xm; i++) {
+                if (i==0 || i==info.mx-1) {
+                    x = xmin[0] + i * h;
+                    au[i] = POISSON_G1D(user,(PetscReal*)ag,i,x);
+                }
+            }
+            ierr = DMDAVecRestoreArray(da, u, &au); CHKERRQ(ierr);
+            break;
+        }
+        case 2:
+        {
+            PetscInt   i, j;
             PetscReal  xymin[2], xymax[2], hx, hy, x, y, **au;
             ierr = DMDAVecGetArray(da, u, &au); CHKERRQ(ierr);
             ierr = DMGetBoundingBox(da,xymin,xymax); CHKERRQ(ierr);
@@ -314,7 +1036,7 @@ PetscErrorCode InitialState(DM da, InitialType it, PetscBool gbdry,
                 for (i = info.xs; i < info.xs + info.xm; i++) {
                     if (i==0 || i==info.mx-1 || j==0 || j==info.my-1) {
                         x = xymin[0] + i * hx;
-                        au[j][i] = user->g_bdry(x,y,0.0,user);
+                        au[j][i] = POISSON_G2D(user,(PetscReal**)ag,j,i,x,y);
                     }
                 }
             }
@@ -338,7 +1060,7 @@ PetscErrorCode InitialState(DM da, InitialType it, PetscBool gbdry,
                         if (i==0 || i==info.mx-1 || j==0 || j==info.my-1
                                  || k==0 || k==info.mz-1) {
                             x = xyzmin[0] + i * hx;
-                            au[k][j][i] = user->g_bdry(x,y,z,user);
+                            au[k][j][i] = POISSON_G3D(user,(PetscReal***)ag,k,j,i,x,y,z);
                         }
                     }
                 }
@@ -349,6 +1071,564 @@ PetscErrorCode InitialState(DM da, InitialType it, PetscBool gbdry,
         default:
             SETERRQ(PETSC_COMM_SELF,5,"invalid dim from DMDALocalInfo\n");
     }
+    ierr = PoissonRestoreBoundaryCache(da,&gloc,&ag); CHKERRQ(ierr);
     return 0;
 }
 
+
+/* Variable-coefficient residuals and Jacobians for
+    - (cx k u_x)_x - (cy k u_y)_y - (cz k u_z)_z = f
+The face-centred values of k are computed once per DMDA and kept in a local
+Vec, with dof = dim, on a companion DMDA with the same ownership ranges
+and a box stencil; component c at node (i,j,k) is k on the face between
+that node and its neighbour in the positive c direction.                  */
+
+static PetscErrorCode CreateFaceDMDA(DM da, DM *dak) {
+    PetscErrorCode  ierr;
+    MPI_Comm        comm;
+    PetscInt        dim, M, N, P, m, n, p;
+    const PetscInt  *lx, *ly, *lz;
+    ierr = PetscObjectGetComm((PetscObject)da,&comm); CHKERRQ(ierr);
+    ierr = DMDAGetInfo(da,&dim,&M,&N,&P,&m,&n,&p,
+                       NULL,NULL,NULL,NULL,NULL,NULL); CHKERRQ(ierr);
+    ierr = DMDAGetOwnershipRanges(da,&lx,&ly,&lz); CHKERRQ(ierr);
+    switch (dim) {
+        case 1:
+            ierr = DMDACreate1d(comm,DM_BOUNDARY_NONE,M,1,1,lx,dak); CHKERRQ(ierr);
+            break;
+        case 2:
+            ierr = DMDACreate2d(comm,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,
+                                DMDA_STENCIL_BOX,M,N,m,n,2,1,lx,ly,dak); CHKERRQ(ierr);
+            break;
+        case 3:
+            ierr = DMDACreate3d(comm,DM_BOUNDARY_NONE,DM_BOUNDARY_NONE,
+                                DM_BOUNDARY_NONE,DMDA_STENCIL_BOX,M,N,P,m,n,p,
+                                3,1,lx,ly,lz,dak); CHKERRQ(ierr);
+            break;
+        default:
+            SETERRQ(PETSC_COMM_SELF,12,"invalid dim from DMDAGetInfo\n");
+    }
+    ierr = DMSetUp(*dak); CHKERRQ(ierr);
+    return 0;
+}
+
+// evaluate k at the faces of all nodes in the ghosted range of dak; faces
+//   outside the domain get zero
+static PetscErrorCode FillFaceCoefficients(DM da, DM dak, PoissonCtx *user,
+                                           Vec kloc) {
+    PetscErrorCode ierr;
+    DMDALocalInfo  info;
+    PetscInt       i, j, k;
+    PetscReal      xyzmin[3], xyzmax[3], h[3] = {0.0, 0.0, 0.0}, x, y, z;
+    ierr = DMDAGetLocalInfo(dak,&info); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(da,xyzmin,xyzmax); CHKERRQ(ierr);
+    h[0] = (xyzmax[0] - xyzmin[0]) / (info.mx - 1);
+    if (info.dim > 1)
+        h[1] = (xyzmax[1] - xyzmin[1]) / (info.my - 1);
+    if (info.dim > 2)
+        h[2] = (xyzmax[2] - xyzmin[2]) / (info.mz - 1);
+    switch (info.dim) {
+        case 1:
+        {
+            PetscReal **ak;
+            ierr = DMDAVecGetArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                x = xyzmin[0] + i * h[0];
+                ak[i][0] = (i < info.mx-1) ? user->k_coeff(x+h[0]/2,0.0,0.0,user) : 0.0;
+            }
+            ierr = DMDAVecRestoreArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            break;
+        }
+        case 2:
+        {
+            PetscReal ***ak;
+            ierr = DMDAVecGetArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            for (j = info.gys; j < info.gys + info.gym; j++) {
+                y = xyzmin[1] + j * h[1];
+                for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                    x = xyzmin[0] + i * h[0];
+                    ak[j][i][0] = (i < info.mx-1) ? user->k_coeff(x+h[0]/2,y,0.0,user) : 0.0;
+                    ak[j][i][1] = (j < info.my-1) ? user->k_coeff(x,y+h[1]/2,0.0,user) : 0.0;
+                }
+            }
+            ierr = DMDAVecRestoreArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            break;
+        }
+        case 3:
+        {
+            PetscReal ****ak;
+            ierr = DMDAVecGetArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            for (k = info.gzs; k < info.gzs + info.gzm; k++) {
+                z = xyzmin[2] + k * h[2];
+                for (j = info.gys; j < info.gys + info.gym; j++) {
+                    y = xyzmin[1] + j * h[1];
+                    for (i = info.gxs; i < info.gxs + info.gxm; i++) {
+                        x = xyzmin[0] + i * h[0];
+                        ak[k][j][i][0] = (i < info.mx-1) ? user->k_coeff(x+h[0]/2,y,z,user) : 0.0;
+                        ak[k][j][i][1] = (j < info.my-1) ? user->k_coeff(x,y+h[1]/2,z,user) : 0.0;
+                        ak[k][j][i][2] = (k < info.mz-1) ? user->k_coeff(x,y,z+h[2]/2,user) : 0.0;
+                    }
+                }
+            }
+            ierr = DMDAVecRestoreArrayDOF(dak,kloc,&ak); CHKERRQ(ierr);
+            break;
+        }
+        default:
+            SETERRQ(PETSC_COMM_SELF,13,"invalid dim from DMDALocalInfo\n");
+    }
+    return 0;
+}
+
+static PetscReal Harmonic(PetscReal a, PetscReal b) {
+    return (a + b > 0.0) ? 2.0 * a * b / (a + b) : 0.0;
+}
+
+// component c of the face coefficients at node (i,j,k)
+static PetscReal FineFace(PetscInt dim, void *ak, PetscInt i, PetscInt j,
+                          PetscInt k, PetscInt c) {
+    switch (dim) {
+        case 1:  return ((PetscReal**)ak)[i][c];
+        case 2:  return ((PetscReal***)ak)[j][i][c];
+        default: return ((PetscReal****)ak)[k][j][i][c];
+    }
+}
+
+// k on the coarse face in direction c at fine node (i,j,k), from the fine
+//   faces it covers:  the two fine faces along the normal are in series
+//   (harmonic mean), and the fine rows across it are in parallel (weights
+//   1/4,1/2,1/4, renormalized at the boundary)
+static PetscReal CoarseFace(DMDALocalInfo *info, void *ak, PetscInt i,
+                            PetscInt j, PetscInt k, PetscInt c) {
+    const PetscReal w[3] = {0.25, 0.5, 0.25};
+    const PetscInt  m[3] = {info->mx, info->my, info->mz};
+    PetscInt  d, o[3], p[3], lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    PetscReal wt, sum = 0.0, sumw = 0.0;
+    for (d = 0; d < info->dim; d++) {
+        if (d != c) {
+            lo[d] = -1;  hi[d] = 1;
+        }
+    }
+    for (o[2] = lo[2]; o[2] <= hi[2]; o[2]++) {
+        for (o[1] = lo[1]; o[1] <= hi[1]; o[1]++) {
+            for (o[0] = lo[0]; o[0] <= hi[0]; o[0]++) {
+                p[0] = i + o[0];  p[1] = j + o[1];  p[2] = k + o[2];
+                wt = 1.0;
+                for (d = 0; d < info->dim; d++) {
+                    if (p[d] < 0 || p[d] > m[d]-1)
+                        wt = 0.0;
+                    else if (d != c)
+                        wt *= w[o[d]+1];
+                }
+                if (wt == 0.0)
+                    continue;
+                sum += wt * Harmonic(FineFace(info->dim,ak,p[0],p[1],p[2],c),
+                                     FineFace(info->dim,ak,p[0] + (c==0),
+                                              p[1] + (c==1),p[2] + (c==2),c));
+                sumw += wt;
+            }
+        }
+    }
+    return sum / sumw;
+}
+
+/* Coarse DMDAs made by DMCoarsen() (e.g. by PCMG) get face coefficients
+from the fine ones, combined by CoarseFace() at the even fine nodes and then
+injected, rather than by evaluating k, so that the coarse operators see the
+same medium as the fine one even when k is rough.                         */
+static PetscErrorCode FaceCoefficientsCoarsenHook(DM fine, DM coarse, void *ctx) {
+    PetscErrorCode ierr;
+    PoissonCtx     *user = (PoissonCtx*)ctx;
+    DMDALocalInfo  info;
+    DM             dakf, dakc;
+    Vec            kf, pf, pc, kc;
+    Mat            inject;
+    PetscInt       i, j, k, c, n[3], m[3];
+    PetscReal      v;
+    void           *ak, *ap;
+
+    ierr = PoissonGetFaceCoefficients(fine,user,&ak); CHKERRQ(ierr);
+    ierr = PetscObjectQuery((PetscObject)fine,"poisson_kface",(PetscObject*)&kf); CHKERRQ(ierr);
+    ierr = VecGetDM(kf,&dakf); CHKERRQ(ierr);
+    ierr = DMDAGetLocalInfo(dakf,&info); CHKERRQ(ierr);
+    m[0] = info.mx;  m[1] = info.my;  m[2] = info.mz;
+    ierr = DMGetGlobalVector(dakf,&pf); CHKERRQ(ierr);
+    ierr = DMDAVecGetArrayDOF(dakf,pf,&ap); CHKERRQ(ierr);
+    for (k = info.zs; k < info.zs + info.zm; k++) {
+        for (j = info.ys; j < info.ys + info.ym; j++) {
+            for (i = info.xs; i < info.xs + info.xm; i++) {
+                n[0] = i;  n[1] = j;  n[2] = k;
+                for (c = 0; c < info.dim; c++) {
+                    // only even nodes are injected; the others are copied
+                    if (n[c] % 2 == 0 && n[c] < m[c]-1)
+                        v = CoarseFace(&info,ak,i,j,k,c);
+                    else
+                        v = FineFace(info.dim,ak,i,j,k,c);
+                    switch (info.dim) {
+                        case 1:  ((PetscReal**)ap)[i][c] = v;  break;
+                        case 2:  ((PetscReal***)ap)[j][i][c] = v;  break;
+                        default: ((PetscReal****)ap)[k][j][i][c] = v;
+                    }
+                }
+            }
+        }
+    }
+    ierr = DMDAVecRestoreArrayDOF(dakf,pf,&ap); CHKERRQ(ierr);
+    ierr = PoissonRestoreFaceCoefficients(fine,&ak); CHKERRQ(ierr);
+
+    ierr = CreateFaceDMDA(coarse,&dakc); CHKERRQ(ierr);
+    ierr = DMCreateInjection(dakc,dakf,&inject); CHKERRQ(ierr);
+    ierr = DMCreateGlobalVector(dakc,&pc); CHKERRQ(ierr);
+    ierr = MatRestrict(inject,pf,pc); CHKERRQ(ierr);
+    ierr = MatDestroy(&inject); CHKERRQ(ierr);
+    ierr = DMRestoreGlobalVector(dakf,&pf); CHKERRQ(ierr);
+    ierr = DMCreateLocalVector(dakc,&kc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalBegin(dakc,pc,INSERT_VALUES,kc); CHKERRQ(ierr);
+    ierr = DMGlobalToLocalEnd(dakc,pc,INSERT_VALUES,kc); CHKERRQ(ierr);
+    ierr = PetscObjectCompose((PetscObject)coarse,"poisson_kface",(PetscObject)kc); CHKERRQ(ierr);
+    ierr = VecDestroy(&pc); CHKERRQ(ierr);
+    ierr = VecDestroy(&kc); CHKERRQ(ierr);
+    ierr = DMDestroy(&dakc); CHKERRQ(ierr);
+    ierr = DMCoarsenHookAdd(coarse,FaceCoefficientsCoarsenHook,NULL,ctx); CHKERRQ(ierr);
+    return 0;
+}
+
+// the Vec is composed with the DMDA, so each DMDA has its own and it is
+//   destroyed along with the DMDA
+PetscErrorCode PoissonGetFaceCoefficients(DM da, PoissonCtx *user, void *ak) {
+    PetscErrorCode ierr;
+    Vec            kloc;
+    DM             dak;
+    ierr = PetscObjectQuery((PetscObject)da,"poisson_kface",(PetscObject*)&kloc); CHKERRQ(ierr);
+    if (!kloc) {
+        if (!user->k_coeff) {
+            SETERRQ(PETSC_COMM_SELF,11,"variable-coefficient functions need user->k_coeff\n");
+        }
+        ierr = CreateFaceDMDA(da,&dak); CHKERRQ(ierr);
+        ierr = DMCreateLocalVector(dak,&kloc); CHKERRQ(ierr);
+        ierr = FillFaceCoefficients(da,dak,user,kloc); CHKERRQ(ierr);
+        ierr = PetscObjectCompose((PetscObject)da,"poisson_kface",(PetscObject)kloc); CHKERRQ(ierr);
+        ierr = VecDestroy(&kloc); CHKERRQ(ierr);
+        ierr = DMDestroy(&dak); CHKERRQ(ierr);
+        ierr = DMCoarsenHookAdd(da,FaceCoefficientsCoarsenHook,NULL,user); CHKERRQ(ierr);
+        ierr = PetscObjectQuery((PetscObject)da,"poisson_kface",(PetscObject*)&kloc); CHKERRQ(ierr);
+    }
+    ierr = VecGetDM(kloc,&dak); CHKERRQ(ierr);
+    ierr = DMDAVecGetArrayDOFRead(dak,kloc,ak); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode PoissonRestoreFaceCoefficients(DM da, void *ak) {
+    PetscErrorCode ierr;
+    Vec            kloc;
+    DM             dak;
+    ierr = PetscObjectQuery((PetscObject)da,"poisson_kface",(PetscObject*)&kloc); CHKERRQ(ierr);
+    ierr = VecGetDM(kloc,&dak); CHKERRQ(ierr);
+    ierr = DMDAVecRestoreArrayDOFRead(dak,kloc,ak); CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode Poisson1DFunctionLocalVarCoeff(DMDALocalInfo *info,
+        PetscReal *au, PetscReal *aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i;
+    PetscReal  xmax[1], xmin[1], h, x, ue, uw, **ak, *ag;
+    Vec        gloc;
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
+    h = (xmax[0] - xmin[0]) / (info->mx - 1);
+    for (i = info->xs; i < info->xs + info->xm; i++) {
+        x = xmin[0] + i * h;
+        if (i==0 || i==info->mx-1) {
+            aF[i] = au[i] - POISSON_G1D(user,ag,i,x);
+            aF[i] *= user->cx * (2.0 / h);
+        } else {
+            ue = (i+1 == info->mx-1) ? POISSON_G1D(user,ag,i+1,x+h)
+                                     : au[i+1];
+            uw = (i-1 == 0)          ? POISSON_G1D(user,ag,i-1,x-h)
+                                     : au[i-1];
+            aF[i] = - user->cx * (ak[i][0] * (ue - au[i])
+                                  - ak[i-1][0] * (au[i] - uw)) / h
+                    - h * user->f_rhs(x,0.0,0.0,user);
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+    ierr = PetscLogFlops(12.0*info->xm);CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode Poisson2DFunctionLocalVarCoeff(DMDALocalInfo *info,
+        PetscReal **au, PetscReal **aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j;
+    PetscReal  xymin[2], xymax[2], hx, hy, darea, scx, scy, scdiag, x, y,
+               ue, uw, un, us, ***ak, **ag;
+    Vec        gloc;
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
+    hx = (xymax[0] - xymin[0]) / (info->mx - 1);
+    hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    darea = hx * hy;
+    scx = user->cx * hy / hx;
+    scy = user->cy * hx / hy;
+    scdiag = 2.0 * (scx + scy);
+    for (j = info->ys; j < info->ys + info->ym; j++) {
+        y = xymin[1] + j * hy;
+        for (i = info->xs; i < info->xs + info->xm; i++) {
+            x = xymin[0] + i * hx;
+            if (i==0 || i==info->mx-1 || j==0 || j==info->my-1) {
+                aF[j][i] = au[j][i] - POISSON_G2D(user,ag,j,i,x,y);
+                aF[j][i] *= scdiag;
+            } else {
+                ue = (i+1 == info->mx-1) ? POISSON_G2D(user,ag,j,i+1,x+hx,y)
+                                         : au[j][i+1];
+                uw = (i-1 == 0)          ? POISSON_G2D(user,ag,j,i-1,x-hx,y)
+                                         : au[j][i-1];
+                un = (j+1 == info->my-1) ? POISSON_G2D(user,ag,j+1,i,x,y+hy)
+                                         : au[j+1][i];
+                us = (j-1 == 0)          ? POISSON_G2D(user,ag,j-1,i,x,y-hy)
+                                         : au[j-1][i];
+                aF[j][i] = - scx * (  ak[j][i][0]   * (ue - au[j][i])
+                                    - ak[j][i-1][0] * (au[j][i] - uw))
+                           - scy * (  ak[j][i][1]   * (un - au[j][i])
+                                    - ak[j-1][i][1] * (au[j][i] - us))
+                           - darea * user->f_rhs(x,y,0.0,user);
+            }
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+    ierr = PetscLogFlops(19.0*info->xm*info->ym);CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode Poisson3DFunctionLocalVarCoeff(DMDALocalInfo *info,
+        PetscReal ***au, PetscReal ***aF, PoissonCtx *user) {
+    PetscErrorCode ierr;
+    PetscInt   i, j, k;
+    PetscReal  xyzmin[3], xyzmax[3], hx, hy, hz, dvol, scx, scy, scz, scdiag,
+               x, y, z, ue, uw, un, us, uu, ud, ****ak, ***ag;
+    Vec        gloc;
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    dvol = hx * hy * hz;
+    scx = user->cx * dvol / (hx*hx);
+    scy = user->cy * dvol / (hy*hy);
+    scz = user->cz * dvol / (hz*hz);
+    scdiag = 2.0 * (scx + scy + scz);
+    for (k = info->zs; k < info->zs + info->zm; k++) {
+        z = xyzmin[2] + k * hz;
+        for (j = info->ys; j < info->ys + info->ym; j++) {
+            y = xyzmin[1] + j * hy;
+            for (i = info->xs; i < info->xs + info->xm; i++) {
+                x = xyzmin[0] + i * hx;
+                if (   i==0 || i==info->mx-1
+                    || j==0 || j==info->my-1
+                    || k==0 || k==info->mz-1) {
+                    aF[k][j][i] = au[k][j][i] - POISSON_G3D(user,ag,k,j,i,x,y,z);
+                    aF[k][j][i] *= scdiag;
+                } else {
+                    ue = (i+1 == info->mx-1) ? POISSON_G3D(user,ag,k,j,i+1,x+hx,y,z)
+                                             : au[k][j][i+1];
+                    uw = (i-1 == 0)          ? POISSON_G3D(user,ag,k,j,i-1,x-hx,y,z)
+                                             : au[k][j][i-1];
+                    un = (j+1 == info->my-1) ? POISSON_G3D(user,ag,k,j+1,i,x,y+hy,z)
+                                             : au[k][j+1][i];
+                    us = (j-1 == 0)          ? POISSON_G3D(user,ag,k,j-1,i,x,y-hy,z)
+                                             : au[k][j-1][i];
+                    uu = (k+1 == info->mz-1) ? POISSON_G3D(user,ag,k+1,j,i,x,y,z+hz)
+                                             : au[k+1][j][i];
+                    ud = (k-1 == 0)          ? POISSON_G3D(user,ag,k-1,j,i,x,y,z-hz)
+                                             : au[k-1][j][i];
+                    aF[k][j][i] =
+                        - scx * (  ak[k][j][i][0]   * (ue - au[k][j][i])
+                                 - ak[k][j][i-1][0] * (au[k][j][i] - uw))
+                        - scy * (  ak[k][j][i][1]   * (un - au[k][j][i])
+                                 - ak[k][j-1][i][1] * (au[k][j][i] - us))
+                        - scz * (  ak[k][j][i][2]   * (uu - au[k][j][i])
+                                 - ak[k-1][j][i][2] * (au[k][j][i] - ud))
+                        - dvol * user->f_rhs(x,y,z,user);
+                }
+            }
+        }
+    }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+    ierr = PetscLogFlops(26.0*info->xm*info->ym*info->zm);CHKERRQ(ierr);
+    return 0;
+}
+
+PetscErrorCode Poisson1DJacobianLocalVarCoeff(DMDALocalInfo *info,
+        PetscScalar *au, Mat J, Mat Jpre, PoissonCtx *user) {
+    PetscErrorCode  ierr;
+    PetscInt     i, ncols;
+    PetscReal    xmin[1], xmax[1], h, sc, v[3], **ak;
+    MatStencil   col[3], row;
+
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xmin,xmax); CHKERRQ(ierr);
+    h = (xmax[0] - xmin[0]) / (info->mx - 1);
+    sc = user->cx / h;
+    for (i = info->xs; i < info->xs+info->xm; i++) {
+        row.i = i;
+        col[0].i = i;
+        ncols = 1;
+        if (i==0 || i==info->mx-1) {
+            v[0] = 2.0 * sc;
+        } else {
+            v[0] = sc * (ak[i][0] + ak[i-1][0]);
+            if (i-1 > 0) {
+                col[ncols].i = i-1;  v[ncols++] = - sc * ak[i-1][0];
+            }
+            if (i+1 < info->mx-1) {
+                col[ncols].i = i+1;  v[ncols++] = - sc * ak[i][0];
+            }
+        }
+        ierr = MatSetValuesStencil(Jpre,1,&row,ncols,col,v,INSERT_VALUES); CHKERRQ(ierr);
+    }
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+PetscErrorCode Poisson2DJacobianLocalVarCoeff(DMDALocalInfo *info,
+        PetscScalar **au, Mat J, Mat Jpre, PoissonCtx *user) {
+    PetscErrorCode  ierr;
+    PetscReal   xymin[2], xymax[2], hx, hy, scx, scy, v[5], ***ak;
+    PetscInt    i, j, ncols;
+    MatStencil  col[5], row;
+
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
+    hx = (xymax[0] - xymin[0]) / (info->mx - 1);
+    hy = (xymax[1] - xymin[1]) / (info->my - 1);
+    scx = user->cx * hy / hx;
+    scy = user->cy * hx / hy;
+    for (j = info->ys; j < info->ys+info->ym; j++) {
+        row.j = j;
+        col[0].j = j;
+        for (i = info->xs; i < info->xs+info->xm; i++) {
+            row.i = i;
+            col[0].i = i;
+            ncols = 1;
+            if (i==0 || i==info->mx-1 || j==0 || j==info->my-1) {
+                v[0] = 2.0 * (scx + scy);
+            } else {
+                v[0] =   scx * (ak[j][i][0] + ak[j][i-1][0])
+                       + scy * (ak[j][i][1] + ak[j-1][i][1]);
+                if (i-1 > 0) {
+                    col[ncols].j = j;    col[ncols].i = i-1;
+                    v[ncols++] = - scx * ak[j][i-1][0];
+                }
+                if (i+1 < info->mx-1) {
+                    col[ncols].j = j;    col[ncols].i = i+1;
+                    v[ncols++] = - scx * ak[j][i][0];
+                }
+                if (j-1 > 0) {
+                    col[ncols].j = j-1;  col[ncols].i = i;
+                    v[ncols++] = - scy * ak[j-1][i][1];
+                }
+                if (j+1 < info->my-1) {
+                    col[ncols].j = j+1;  col[ncols].i = i;
+                    v[ncols++] = - scy * ak[j][i][1];
+                }
+            }
+            ierr = MatSetValuesStencil(Jpre,1,&row,ncols,col,v,INSERT_VALUES); CHKERRQ(ierr);
+        }
+    }
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
+
+PetscErrorCode Poisson3DJacobianLocalVarCoeff(DMDALocalInfo *info,
+        PetscScalar ***au, Mat J, Mat Jpre, PoissonCtx *user) {
+    PetscErrorCode  ierr;
+    PetscReal   xyzmin[3], xyzmax[3], hx, hy, hz, dvol, scx, scy, scz, v[7],
+                ****ak;
+    PetscInt    i, j, k, ncols;
+    MatStencil  col[7], row;
+
+    ierr = PoissonGetFaceCoefficients(info->da,user,&ak); CHKERRQ(ierr);
+    ierr = DMGetBoundingBox(info->da,xyzmin,xyzmax); CHKERRQ(ierr);
+    hx = (xyzmax[0] - xyzmin[0]) / (info->mx - 1);
+    hy = (xyzmax[1] - xyzmin[1]) / (info->my - 1);
+    hz = (xyzmax[2] - xyzmin[2]) / (info->mz - 1);
+    dvol = hx * hy * hz;
+    scx = user->cx * dvol / (hx*hx);
+    scy = user->cy * dvol / (hy*hy);
+    scz = user->cz * dvol / (hz*hz);
+    for (k = info->zs; k < info->zs+info->zm; k++) {
+        row.k = k;
+        col[0].k = k;
+        for (j = info->ys; j < info->ys+info->ym; j++) {
+            row.j = j;
+            col[0].j = j;
+            for (i = info->xs; i < info->xs+info->xm; i++) {
+                row.i = i;
+                col[0].i = i;
+                ncols = 1;
+                if (   i==0 || i==info->mx-1
+                    || j==0 || j==info->my-1
+                    || k==0 || k==info->mz-1) {
+                    v[0] = 2.0 * (scx + scy + scz);
+                } else {
+                    v[0] =   scx * (ak[k][j][i][0] + ak[k][j][i-1][0])
+                           + scy * (ak[k][j][i][1] + ak[k][j-1][i][1])
+                           + scz * (ak[k][j][i][2] + ak[k-1][j][i][2]);
+                    if (i-1 > 0) {
+                        col[ncols].k = k;    col[ncols].j = j;    col[ncols].i = i-1;
+                        v[ncols++] = - scx * ak[k][j][i-1][0];
+                    }
+                    if (i+1 < info->mx-1) {
+                        col[ncols].k = k;    col[ncols].j = j;    col[ncols].i = i+1;
+                        v[ncols++] = - scx * ak[k][j][i][0];
+                    }
+                    if (j-1 > 0) {
+                        col[ncols].k = k;    col[ncols].j = j-1;  col[ncols].i = i;
+                        v[ncols++] = - scy * ak[k][j-1][i][1];
+                    }
+                    if (j+1 < info->my-1) {
+                        col[ncols].k = k;    col[ncols].j = j+1;  col[ncols].i = i;
+                        v[ncols++] = - scy * ak[k][j][i][1];
+                    }
+                    if (k-1 > 0) {
+                        col[ncols].k = k-1;  col[ncols].j = j;    col[ncols].i = i;
+                        v[ncols++] = - scz * ak[k-1][j][i][2];
+                    }
+                    if (k+1 < info->mz-1) {
+                        col[ncols].k = k+1;  col[ncols].j = j;    col[ncols].i = i;
+                        v[ncols++] = - scz * ak[k][j][i][2];
+                    }
+                }
+                ierr = MatSetValuesStencil(Jpre,1,&row,ncols,col,v,INSERT_VALUES); CHKERRQ(ierr);
+            }
+        }
+    }
+    ierr = PoissonRestoreFaceCoefficients(info->da,&ak); CHKERRQ(ierr);
+    ierr = MatAssemblyBegin(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    ierr = MatAssemblyEnd(Jpre,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    if (J != Jpre) {
+        ierr = MatAssemblyBegin(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+        ierr = MatAssemblyEnd(J,MAT_FINAL_ASSEMBLY); CHKERRQ(ierr);
+    }
+    return 0;
+}
@@ -45,10 +45,14 @@ typedef struct {
     PetscReal Lx, Ly, Lz;
     // coefficients in  - cx u_xx - cy u_yy - cz u_zz = f
     PetscReal cx, cy, cz;
+    // k(x,y,z) in the variable-coefficient form; NULL if not used
+    PetscReal (*k_coeff)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
     // right-hand-side f(x,y,z)
     PetscReal (*f_rhs)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
     // Dirichlet boundary condition g(x,y,z)
     PetscReal (*g_bdry)(PetscReal x, PetscReal y, PetscReal z, void *ctx);
+    // evaluate g_bdry() only once per grid; see PoissonGetBoundaryCache()
+    PetscBool cache_bdry;
     // additional context; see example usage in ch7/minimal.c
     void   *addctx;
 } PoissonCtx;
@@ -63,6 +67,26 @@ PetscErrorCode Poisson3DFunctionLocal(DMDALocalInfo *info,
     PetscReal ***au, PetscReal ***aF, PoissonCtx *user);
 //ENDDECLARE
 
+/* Same result as Poisson3DFunctionLocal(), but boundary faces are done in a
+separate pass, the interior stencil loop over i has no branches and no calls
+to g_bdry() so that it vectorizes, rows are swept in tiles which keep three
+planes in cache, and the neighbours of boundary points are corrected last. */
+PetscErrorCode Poisson3DFunctionLocalBlocked(DMDALocalInfo *info,
+    PetscReal ***au, PetscReal ***aF, PoissonCtx *user);
+
+/* Fourth-order compact (Mehrstellen) residuals:  3-point in 1D, 9-point in
+2D, and 19-point in 3D, with f averaged over the 5-point (2D) or 7-point (3D)
+star.  The Jacobian in 1D is Poisson1DJacobianLocal(); in 2D and 3D use the
+Mehrstellen Jacobians below.  In 2D and 3D the DMDA must have stencil type
+DMDA_STENCIL_BOX.  For example,
+    ./fish -fsh_dim 3 -fsh_order 4 -da_refine 3 -pc_type mg               */
+PetscErrorCode Poisson1DFunctionLocalMehrstellen(DMDALocalInfo *info,
+    PetscReal *au, PetscReal *aF, PoissonCtx *user);
+PetscErrorCode Poisson2DFunctionLocalMehrstellen(DMDALocalInfo *info,
+    PetscReal **au, PetscReal **aF, PoissonCtx *user);
+PetscErrorCode Poisson3DFunctionLocalMehrstellen(DMDALocalInfo *info,
+    PetscReal ***au, PetscReal ***aF, PoissonCtx *user);
+
 /* This generates a tridiagonal sparse matrix.  If cx=1 then it has 2 on the
 diagonal and -1 or zero in off-diagonal positions.  For example,
     ./fish -fsh_dim 1 -mat_view ::ascii_dense -da_refine N                */
@@ -83,6 +107,75 @@ sparse matrix.  For example,
 PetscErrorCode Poisson3DJacobianLocal(DMDALocalInfo *info, PetscReal ***au,
                                       Mat J, Mat Jpre, PoissonCtx *user);
 
+/* These are the Jacobians of the Mehrstellen residuals; they are 9-point
+and 19-point, and they have constant diagonal.                            */
+PetscErrorCode Poisson2DJacobianLocalMehrstellen(DMDALocalInfo *info,
+    PetscReal **au, Mat J, Mat Jpre, PoissonCtx *user);
+PetscErrorCode Poisson3DJacobianLocalMehrstellen(DMDALocalInfo *info,
+    PetscReal ***au, Mat J, Mat Jpre, PoissonCtx *user);
+
+/* Matrix-free Jacobians.  After PoissonSetMatrixFree(da), DMCreateMatrix()
+on da makes a MATSHELL, and the PoissonXDJacobianLocal() call-backs above
+give it the operations PoissonShellMult() and PoissonShellGetDiagonal()
+instead of assembling.  Because the diagonal is available, Jacobi and
+Chebyshev/Jacobi smoothers work.  When PCMG coarsens da, every level is
+also matrix-free except the coarsest, which is assembled (AIJ) so that
+the default direct coarse solve works.  Not for -pc_mg_galerkin.  For
+example,
+    ./fish -fsh_dim 3 -fsh_matfree -da_refine 5 -pc_type mg               */
+PetscErrorCode PoissonSetMatrixFree(DM da);
+PetscErrorCode PoissonShellMult(Mat A, Vec x, Vec y);
+PetscErrorCode PoissonShellGetDiagonal(Mat A, Vec d);
+
+/* Boundary-value cache.  If user->cache_bdry is PETSC_TRUE then the residual
+functions above, and InitialState() below, evaluate g_bdry() only once per
+DMDA, at the boundary points in the ghosted local range, and thereafter read
+g from a local Vec attached to the DMDA.  Grids made by -snes_grid_sequence
+or PCMG coarsening get their own cache when first used.  This is worthwhile
+when g_bdry() is expensive, as for the catenoid in ch7/minimal.c, and
+especially with -snes_fd_color.  It assumes that g_bdry() and the DMDA
+coordinates do not change after the first residual evaluation.  If
+cache_bdry is PETSC_FALSE then PoissonGetBoundaryCache() returns *ag = NULL
+and the POISSON_GxD() macros call g_bdry().  For example,
+    ./fish -fsh_dim 3 -fsh_cache_bdry -snes_grid_sequence 3                */
+PetscErrorCode PoissonGetBoundaryCache(DM da, PoissonCtx *user,
+                                       Vec *gloc, void *ag);
+PetscErrorCode PoissonRestoreBoundaryCache(DM da, Vec *gloc, void *ag);
+
+#define POISSON_G1D(user,ag,i,x) \
+    ((ag) ? (ag)[i] : (user)->g_bdry(x,0.0,0.0,user))
+#define POISSON_G2D(user,ag,j,i,x,y) \
+    ((ag) ? (ag)[j][i] : (user)->g_bdry(x,y,0.0,user))
+#define POISSON_G3D(user,ag,k,j,i,x,y,z) \
+    ((ag) ? (ag)[k][j][i] : (user)->g_bdry(x,y,z,user))
+
+/* Variable-coefficient residuals and Jacobians for
+    - (cx k u_x)_x - (cy k u_y)_y - (cz k u_z)_z = f
+with k = user->k_coeff(x,y,z,user) > 0.  The values of k at the cell-face
+midpoints are computed once per DMDA and kept in a local Vec, with dof=dim,
+on a companion DMDA; PoissonGetFaceCoefficients() gives its array
+ak[j][i][c] (in 2D) of k on the face between node (i,j) and its neighbour in
+direction c.  On DMDAs made by DMCoarsen(), as in PCMG with rediscretized
+coarse operators, the face values are instead combined from the finer grid:
+harmonic mean along the face normal and weighted average across it.  The
+stencils are 3-point, 5-point, and 7-point and the Jacobians are symmetric.
+For example,
+    ./fish -fsh_dim 3 -fsh_problem manuvar -da_refine 4 -pc_type mg        */
+PetscErrorCode Poisson1DFunctionLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal *au, PetscReal *aF, PoissonCtx *user);
+PetscErrorCode Poisson2DFunctionLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal **au, PetscReal **aF, PoissonCtx *user);
+PetscErrorCode Poisson3DFunctionLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal ***au, PetscReal ***aF, PoissonCtx *user);
+PetscErrorCode Poisson1DJacobianLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal *au, Mat J, Mat Jpre, PoissonCtx *user);
+PetscErrorCode Poisson2DJacobianLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal **au, Mat J, Mat Jpre, PoissonCtx *user);
+PetscErrorCode Poisson3DJacobianLocalVarCoeff(DMDALocalInfo *info,
+    PetscReal ***au, Mat J, Mat Jpre, PoissonCtx *user);
+PetscErrorCode PoissonGetFaceCoefficients(DM da, PoissonCtx *user, void *ak);
+PetscErrorCode PoissonRestoreFaceCoefficients(DM da, void *ak);
+
 /* The following function generates an initial iterate using either
   * zero
   * a random function (white noise; *no* smoothness)
@@ -0,0 +1,22 @@
+#!/bin/bash
+set -e
+
+# compares assembled and matrix-free (-fsh_matfree) Jacobians for a CG+MG
+# solver of the 3D Poisson equation:  same KSP iterations are expected, with
+# much less memory and less time in the finest-level products
+
+# use PETSC_ARCH with --with-debugging=0
+
+MAXLEV=6     # =6 corresponds to 129x129x129 grid
+
+# both use Chebyshev+Jacobi smoothing so the comparison is like-for-like
+for MF in "" "-fsh_matfree"; do
+    CMD="../fish -fsh_dim 3 -ksp_rtol 1.0e-10 -ksp_converged_reason -pc_type mg -mg_levels_pc_type jacobi -da_refine $MAXLEV $MF -log_view -memory_view"
+    echo "COMMAND:  $CMD"
+    rm -rf tmp.txt
+    $CMD &> tmp.txt
+    grep -A 1 "Linear solve" tmp.txt
+    grep "Maximum (over computational time) process memory" tmp.txt
+    grep "^MatMult " tmp.txt
+    grep "Time (sec):" tmp.txt
+done
@@ -0,0 +1,20 @@
+#!/bin/bash
+set -e
+
+# convergence of the second-order (5-point/7-point) and fourth-order
+# Mehrstellen (9-point/19-point, -fsh_order 4) schemes under refinement, for
+# the 2D and 3D manupoly problems; the fourth-order error at a given level
+# should be reached by the second-order scheme only several levels later
+
+# use PETSC_ARCH with --with-debugging=0
+
+for DIM in 2 3; do
+    if [[ $DIM -eq 2 ]]; then MAXLEV=8; else MAXLEV=5; fi
+    for ORDER in 2 4; do
+        for LEV in $(seq 1 $MAXLEV); do
+            CMD="../fish -fsh_dim $DIM -fsh_problem manupoly -fsh_order $ORDER -ksp_rtol 1.0e-12 -pc_type mg -da_refine $LEV"
+            echo "COMMAND:  $CMD"
+            $CMD
+        done
+    done
+done
@@ -8,7 +8,8 @@ static char help[] =
 "solution.  The discretization is structured-grid (DMDA) finite differences.\n"
 "We re-use the Jacobian from the Poisson equation, but it is suitable only\n"
 "for low-amplitude g, or as preconditioning material in -snes_mf_operator.\n"
-"Options -snes_fd_color and -snes_grid_sequence are recommended.\n"
+"Options -snes_fd_color and -snes_grid_sequence are recommended.  Option\n"
+"-ms_cache_bdry avoids re-evaluating g at each residual evaluation.\n"
 "This code is multigrid (GMG) capable.\n\n";
 
 #include <petsc.h>
@@ -78,8 +79,13 @@ int main(int argc, char **argv) {
     user.cx = 1.0;
     user.cy = 1.0;
     user.cz = 1.0;
+    user.cache_bdry = PETSC_FALSE;
+    user.k_coeff = NULL;
     ierr = PetscOptionsBegin(PETSC_COMM_WORLD,"ms_",
                              "minimal surface equation solver options",""); CHKERRQ(ierr);
+    ierr = PetscOptionsBool("-cache_bdry",
+                            "evaluate boundary values g only once per grid",
+                            "minimal.c",user.cache_bdry,&(user.cache_bdry),NULL);CHKERRQ(ierr);
     ierr = PetscOptionsReal("-catenoid_c",
                             "parameter for problem catenoid; c >= 1 required",
                             "minimal.c",mctx.catenoid_c,&(mctx.catenoid_c),NULL); CHKERRQ(ierr);
@@ -215,7 +221,9 @@ PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
     PetscInt   i, j;
     PetscReal  xymin[2], xymax[2], hx, hy, hxhy, hyhx, x, y,
                ue, uw, un, us, une, use, unw, usw,
-               dux, duy, De, Dw, Dn, Ds;
+               dux, duy, De, Dw, Dn, Ds, **ag;
+    Vec        gloc;
+    ierr = PoissonGetBoundaryCache(info->da,user,&gloc,&ag); CHKERRQ(ierr);
     ierr = DMGetBoundingBox(info->da,xymin,xymax); CHKERRQ(ierr);
     hx = (xymax[0] - xymin[0]) / (info->mx - 1);
     hy = (xymax[1] - xymin[1]) / (info->my - 1);
@@ -226,35 +234,35 @@ PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
         for (i = info->xs; i < info->xs + info->xm; i++) {
             x = i * hx;
             if (j==0 || i==0 || i==info->mx-1 || j==info->my-1) {
-                FF[j][i] = au[j][i] - user->g_bdry(x,y,0.0,user);
+                FF[j][i] = au[j][i] - POISSON_G2D(user,ag,j,i,x,y);
             } else {
                 // assign neighbor values with either boundary condition or
                 //     current u at that point (==> symmetric matrix)
-                ue  = (i+1 == info->mx-1) ? user->g_bdry(x+hx,y,0.0,user)
+                ue  = (i+1 == info->mx-1) ? POISSON_G2D(user,ag,j,i+1,x+hx,y)
                                           : au[j][i+1];
-                uw  = (i-1 == 0)          ? user->g_bdry(x-hx,y,0.0,user)
+                uw  = (i-1 == 0)          ? POISSON_G2D(user,ag,j,i-1,x-hx,y)
                                           : au[j][i-1];
-                un  = (j+1 == info->my-1) ? user->g_bdry(x,y+hy,0.0,user)
+                un  = (j+1 == info->my-1) ? POISSON_G2D(user,ag,j+1,i,x,y+hy)
                                           : au[j+1][i];
-                us  = (j-1 == 0)          ? user->g_bdry(x,y-hy,0.0,user)
+                us  = (j-1 == 0)          ? POISSON_G2D(user,ag,j-1,i,x,y-hy)
                                           : au[j-1][i];
                 if (i+1 == info->mx-1 || j+1 == info->my-1) {
-                    une = user->g_bdry(x+hx,y+hy,0.0,user);
+                    une = POISSON_G2D(user,ag,j+1,i+1,x+hx,y+hy);
                 } else {
                     une = au[j+1][i+1];
                 }
                 if (i-1 == 0 || j+1 == info->my-1) {
-                    unw = user->g_bdry(x-hx,y+hy,0.0,user);
+                    unw = POISSON_G2D(user,ag,j+1,i-1,x-hx,y+hy);
                 } else {
                     unw = au[j+1][i-1];
                 }
                 if (i+1 == info->mx-1 || j-1 == 0) {
-                    use = user->g_bdry(x+hx,y-hy,0.0,user);
+                    use = POISSON_G2D(user,ag,j-1,i+1,x+hx,y-hy);
                 } else {
                     use = au[j-1][i+1];
                 }
                 if (i-1 == 0 || j-1 == 0) {
-                    usw = user->g_bdry(x-hx,y-hy,0.0,user);
+                    usw = POISSON_G2D(user,ag,j-1,i-1,x-hx,y-hy);
                 } else {
                     usw = au[j-1][i-1];
                 }
@@ -280,6 +288,7 @@ PetscErrorCode FormFunctionLocal(DMDALocalInfo *info, PetscReal **au,
             }
         }
     }
+    ierr = PoissonRestoreBoundaryCache(info->da,&gloc,&ag); CHKERRQ(ierr);
     return 0;
 }
 
@@ -75,6 +75,8 @@ int main(int argc,char **argv) {
     user.cy = 1.0;
     user.cz = 1.0;
     user.g_bdry = &g_zero;
+    user.cache_bdry = PETSC_FALSE;
+    user.k_coeff = NULL;
     bctx.lambda = 1.0;
     bctx.exact = PETSC_FALSE;
     bctx.residualcount = 0;
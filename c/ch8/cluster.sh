@@ -62,6 +62,12 @@ $GO ../ch5/pattern -da_refine 6 -ptn_phi 0.05 -ptn_kappa 0.063 -ts_max_time 2000
 # coarse grid is 9x9x9 so should work up to several hundred processors
 $GO ../ch6/fish -fsh_dim 3 -da_refine 7 -pc_mg_levels 6 -pc_type mg -snes_type ksponly -ksp_converged_reason -log_view
 
+# FISH residual bandwidth:  compare plain and cache-blocked 3D residual
+# kernels; the GB/s reported for the stencil pass, which uses f = 0, should
+# approach the "make streams" rate above; the full residual also evaluates
+# f, with exp() for the default manuexp problem, so it is reported in points/s
+$GO ../ch6/fish -fsh_dim 3 -da_refine 6 -fsh_bench_residual 50 -fsh_blocked -snes_type ksponly -pc_type mg -ksp_converged_reason
+
 # MINIMAL:  solve 2D minimal surface equation
 # using optimal grid-sequenced Newton GMRES+GMG solver
 # 33x33 base grid with -snes_grid_sequence 6 is 2049x2049 finest grid